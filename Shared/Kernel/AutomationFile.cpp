@@ -0,0 +1,190 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AutomationFile.h"
+
+namespace {
+
+constexpr uint32_t version = 1;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  double sampleRate;
+  uint32_t laneCount;
+  uint32_t reserved;
+};
+
+struct FileLane {
+  uint64_t address;
+  uint64_t offset;
+  uint64_t count;
+};
+
+static_assert(sizeof(FileHeader) == 24 && sizeof(FileLane) == 24 && sizeof(AutomationFile::Point) == 16,
+              "automation file records must have fixed sizes");
+
+} // end namespace
+
+bool
+AutomationFile::write(std::string const& path, double sampleRate, std::vector<Lane> const& lanes)
+{
+  FileHeader header;
+  memcpy(header.magic, "LPFA", 4);
+  header.version = version;
+  header.sampleRate = sampleRate;
+  header.laneCount = uint32_t(lanes.size());
+  header.reserved = 0;
+
+  std::vector<FileLane> table;
+  uint64_t offset = sizeof(FileHeader) + lanes.size() * sizeof(FileLane);
+  for (auto const& lane : lanes) {
+    if (!std::is_sorted(lane.points.begin(), lane.points.end(),
+                        [](Point const& a, Point const& b) { return a.sampleTime < b.sampleTime; })) return false;
+    table.push_back({lane.address, offset, lane.points.size()});
+    offset += lane.points.size() * sizeof(Point);
+  }
+
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !table.empty()) ok = fwrite(table.data(), sizeof(FileLane), table.size(), file) == table.size();
+  for (auto const& lane : lanes) {
+    if (ok && !lane.points.empty()) {
+      ok = fwrite(lane.points.data(), sizeof(Point), lane.points.size(), file) == lane.points.size();
+    }
+  }
+  return fclose(file) == 0 && ok;
+}
+
+bool
+AutomationFile::open(std::string const& path)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(FileHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = size_t(info.st_size);
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) return false;
+
+  memory_ = memory;
+  size_ = size;
+  auto base = static_cast<char const*>(memory);
+
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, "LPFA", 4) != 0 || header.version != version ||
+      sizeof(FileHeader) + uint64_t(header.laneCount) * sizeof(FileLane) > size) {
+    close();
+    return false;
+  }
+
+  // Validate everything now so that reading chunks never has to.
+  size_t total = 0;
+  auto table = reinterpret_cast<FileLane const*>(base + sizeof(FileHeader));
+  for (uint32_t index = 0; index < header.laneCount; ++index) {
+    auto const& lane = table[index];
+    if (lane.offset % alignof(Point) != 0 || lane.offset > size ||
+        lane.count > (size - lane.offset) / sizeof(Point)) {
+      close();
+      return false;
+    }
+
+    auto points = reinterpret_cast<Point const*>(base + lane.offset);
+    for (uint64_t point = 1; point < lane.count; ++point) {
+      if (points[point].sampleTime < points[point - 1].sampleTime) {
+        close();
+        return false;
+      }
+    }
+
+    lanes_.push_back({lane.address, points, points + lane.count});
+    total += lane.count;
+  }
+
+  sampleRate_ = header.sampleRate;
+  events_.reserve(std::min<size_t>(total, 4096));
+  return true;
+}
+
+void
+AutomationFile::close()
+{
+  if (memory_ != nullptr) munmap(memory_, size_);
+  memory_ = nullptr;
+  size_ = 0;
+  sampleRate_ = 0.0;
+  lanes_.clear();
+  events_.clear();
+}
+
+size_t
+AutomationFile::pointCount() const
+{
+  size_t count = 0;
+  for (auto const& lane : lanes_) count += size_t(lane.end - lane.next);
+  return count;
+}
+
+void
+AutomationFile::seek(AUEventSampleTime sampleTime)
+{
+  if (memory_ == nullptr) return;
+  auto table = reinterpret_cast<FileLane const*>(static_cast<char const*>(memory_) + sizeof(FileHeader));
+  for (size_t index = 0; index < lanes_.size(); ++index) {
+    auto& lane = lanes_[index];
+    auto begin = reinterpret_cast<Point const*>(static_cast<char const*>(memory_) + table[index].offset);
+    lane.next = std::lower_bound(begin, lane.end, sampleTime,
+                                 [](Point const& point, AUEventSampleTime when) { return point.sampleTime < when; });
+  }
+}
+
+AURenderEvent const*
+AutomationFile::next(AUEventSampleTime start, AUAudioFrameCount frameCount)
+{
+  events_.clear();
+  auto end = start + AUEventSampleTime(frameCount);
+
+  // Merge the lanes by time. There are only a handful of lanes, so a linear scan for the earliest beats a heap.
+  while (true) {
+    LaneCursor* earliest = nullptr;
+    for (auto& lane : lanes_) {
+      if (lane.next != lane.end && lane.next->sampleTime < end &&
+          (earliest == nullptr || lane.next->sampleTime < earliest->next->sampleTime)) {
+        earliest = &lane;
+      }
+    }
+
+    if (earliest == nullptr) break;
+
+    auto const& point = *earliest->next++;
+    AURenderEvent event;
+    memset(&event, 0, sizeof(event));
+    event.parameter.eventSampleTime = std::max(point.sampleTime, start);
+    event.parameter.eventType = point.rampFrames > 0 ? AURenderEventParameterRamp : AURenderEventParameter;
+    event.parameter.rampDurationSampleFrames = point.rampFrames;
+    event.parameter.parameterAddress = earliest->address;
+    event.parameter.value = point.value;
+    events_.push_back(event);
+  }
+
+  if (events_.empty()) return nullptr;
+  for (size_t index = 0; index + 1 < events_.size(); ++index) events_[index].head.next = &events_[index + 1];
+  events_.back().head.next = nullptr;
+  return &events_.front();
+}
@@ -0,0 +1,113 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <AudioToolbox/AudioToolbox.h>
+
+#include "NonCopyable.hpp"
+
+/**
+ Sample-accurate parameter automation stored in a compact binary file that is memory-mapped for reading. Provides the
+ same `AURenderEvent` lists that a host gives to `processAndRender`, so that offline renders get the same automation as
+ live ones.
+
+ The file holds one lane per parameter. A lane is a sorted array of breakpoints, each of which either jumps to a value
+ or ramps to it over a number of frames. Layout, in native byte order (little-endian on every supported platform):
+
+ - header: "LPFA", version (uint32), sample rate (float64), lane count (uint32), reserved (uint32)
+ - lane table: per lane, parameter address (uint64), file offset of its points (uint64), point count (uint64)
+ - points: per point, sample time (int64), value (float32), ramp frames (uint32)
+
+ Points are fixed-size records used straight from the mapping, so producing the events of a render chunk only merges
+ the lanes' next few points into a reusable event buffer. The file is validated once by `open`.
+ */
+class AutomationFile : NonCopyable {
+public:
+
+  /// One breakpoint of a lane
+  struct Point {
+    /// The sample time of the event
+    int64_t sampleTime;
+    /// The value to jump or ramp to
+    float value;
+    /// The number of frames to ramp over (0 to jump)
+    uint32_t rampFrames;
+  };
+
+  /// The breakpoints of one parameter
+  struct Lane {
+    AUParameterAddress address;
+    std::vector<Point> points;
+  };
+
+  AutomationFile() = default;
+
+  ~AutomationFile() { close(); }
+
+  /**
+   Write lanes to a file. Each lane's points must be in time order.
+
+   @param path the location of the file to write
+   @param sampleRate the sample rate that sample times refer to
+   @param lanes the lanes to write
+   @returns true if written
+   */
+  static bool write(std::string const& path, double sampleRate, std::vector<Lane> const& lanes);
+
+  /**
+   Map a file for reading and position it at sample time 0.
+
+   @param path the location of the file to read
+   @returns false if the file cannot be mapped or is not a valid automation file
+   */
+  bool open(std::string const& path);
+
+  /**
+   Unmap the file.
+   */
+  void close();
+
+  /// @returns the sample rate that sample times refer to
+  double sampleRate() const { return sampleRate_; }
+
+  /// @returns the number of lanes in the file
+  size_t laneCount() const { return lanes_.size(); }
+
+  /// @returns the number of points in all lanes that have not been returned by `next`
+  size_t pointCount() const;
+
+  /**
+   Position the reader so that the next chunk starts at the first point at or after the given sample time.
+
+   @param sampleTime the time to move to
+   */
+  void seek(AUEventSampleTime sampleTime);
+
+  /**
+   Obtain the events of the next render chunk as a linked list in time order, suitable for the
+   `realtimeEventListHead` argument of `processAndRender`. Points that are before `start` and have not been returned
+   yet are included so that nothing is lost. The list stays valid until the next call.
+
+   @param start the sample time of the first frame of the chunk
+   @param frameCount the number of frames in the chunk
+   @returns the first event or nullptr if there are none in the chunk
+   */
+  AURenderEvent const* next(AUEventSampleTime start, AUAudioFrameCount frameCount);
+
+private:
+
+  struct LaneCursor {
+    AUParameterAddress address;
+    Point const* next;
+    Point const* end;
+  };
+
+  void* memory_ = nullptr;
+  size_t size_ = 0;
+  double sampleRate_ = 0.0;
+  std::vector<LaneCursor> lanes_;
+  std::vector<AURenderEvent> events_;
+};
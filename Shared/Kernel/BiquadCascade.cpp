@@ -0,0 +1,150 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+
+#include "BiquadCascade.h"
+#include "SIMDMath.hpp"
+
+using namespace SIMDMath;
+
+namespace {
+
+enum Index { B0 = 0, B1, B2, A1, A2 };
+
+constexpr size_t laneCount = Traits<Native>::width;
+
+/// Move every lane up by one, dropping the last lane and putting `first` into lane 0.
+inline Float4 shiftIn(Float4 v, float first) { return Float4{first, v[0], v[1], v[2]}; }
+#if defined(__AVX__)
+inline Float8 shiftIn(Float8 v, float first) { return Float8{first, v[0], v[1], v[2], v[3], v[4], v[5], v[6]}; }
+#endif
+
+/**
+ Run one group of sections over a block, one section per lane with lane k working on sample n - k.
+
+ @param coefficients the 5 coefficient vectors of the group
+ @param state the 2 state vectors of the group
+ @param in the first sample to process
+ @param out where to store the first result
+ @param stride the distance between consecutive samples
+ @param frameCount the number of samples to process
+ */
+template <typename V>
+void runGroup(float const* coefficients, float* state, float const* in, float* out, long stride, size_t frameCount)
+{
+  constexpr long width = long(Traits<V>::width);
+  using Int = Detail::IntOf<V>;
+
+  V const b0 = load<V>(coefficients + B0 * width);
+  V const b1 = load<V>(coefficients + B1 * width);
+  V const b2 = load<V>(coefficients + B2 * width);
+  V const a1 = load<V>(coefficients + A1 * width);
+  V const a2 = load<V>(coefficients + A2 * width);
+  V s1 = load<V>(state);
+  V s2 = load<V>(state + width);
+  V y = {};
+
+  Int lanes;
+  for (long lane = 0; lane < width; ++lane) lanes[lane] = int32_t(lane);
+
+  long const count = long(frameCount);
+  long const last = count + width - 1;
+  long const fillEnd = std::min(width - 1, last);
+  long const drainStart = std::max(count, fillEnd);
+
+  // One pipeline step. Lane k has sample t - k as input. While the pipeline fills or drains, lanes without a sample
+  // must keep their state; in between every lane is busy.
+  auto step = [&](long t, bool masked) {
+    V x = shiftIn(y, t < count ? in[t * stride] : 0.0f);
+    y = b0 * x + s1;
+    V n1 = b1 * x - a1 * y + s2;
+    V n2 = b2 * x - a2 * y;
+    if (masked) {
+      Int active = (lanes <= int32_t(t)) & (lanes > int32_t(t - count));
+      s1 = Detail::select<V>(active, n1, s1);
+      s2 = Detail::select<V>(active, n2, s2);
+    }
+    else {
+      s1 = n1;
+      s2 = n2;
+    }
+    if (t >= width - 1) out[(t - width + 1) * stride] = y[width - 1];
+  };
+
+  long t = 0;
+  for (; t < fillEnd; ++t) step(t, true);
+  for (; t < drainStart; ++t) step(t, false);
+  for (; t < last; ++t) step(t, true);
+
+  store(state, s1);
+  store(state + width, s2);
+}
+
+} // end namespace
+
+size_t
+BiquadCascade::width()
+{
+  return laneCount;
+}
+
+void
+BiquadCascade::setSections(std::vector<Coefficients> const& sections, size_t numChannels)
+{
+  numSections_ = sections.size();
+  numChannels_ = numChannels;
+  numGroups_ = (numSections_ + laneCount - 1) / laneCount;
+
+  // Unused lanes are identity sections.
+  coefficients_.assign(numGroups_ * 5 * laneCount, 0.0f);
+  for (size_t index = 0; index < numGroups_ * laneCount; ++index) {
+    if (index < numSections_) {
+      setSection(index, sections[index]);
+    }
+    else {
+      coefficients_[(index / laneCount * 5 + B0) * laneCount + index % laneCount] = 1.0f;
+    }
+  }
+
+  states_.assign(numChannels_ * numGroups_ * 2 * laneCount, 0.0f);
+}
+
+void
+BiquadCascade::setSection(size_t index, Coefficients const& coefficients)
+{
+  assert(index < numSections_);
+  float* group = coefficients_.data() + index / laneCount * 5 * laneCount + index % laneCount;
+  group[B0 * laneCount] = coefficients.b0;
+  group[B1 * laneCount] = coefficients.b1;
+  group[B2 * laneCount] = coefficients.b2;
+  group[A1 * laneCount] = coefficients.a1;
+  group[A2 * laneCount] = coefficients.a2;
+}
+
+void
+BiquadCascade::apply(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  for (size_t channel = 0; channel < numChannels_; ++channel) {
+    if (numGroups_ == 0) {
+      if (ins[channel] != outs[channel]) {
+        for (size_t index = 0; index < frameCount; ++index) outs[channel][index * stride] = ins[channel][index * stride];
+      }
+      continue;
+    }
+
+    // Each group reads its input ahead of where it writes, so all groups after the first can work in place.
+    float const* in = ins[channel];
+    for (size_t group = 0; group < numGroups_; ++group) {
+      runGroup<Native>(coefficients_.data() + group * 5 * laneCount,
+                       states_.data() + (channel * numGroups_ + group) * 2 * laneCount,
+                       in, outs[channel], stride, frameCount);
+      in = outs[channel];
+    }
+  }
+}
+
+void
+BiquadCascade::resetState()
+{
+  std::fill(states_.begin(), states_.end(), 0.0f);
+}
@@ -0,0 +1,92 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "BiquadFilter.h"
+
+/**
+ Applies a chain of second-order sections to each channel. The sections of a cascade depend on each other sample by
+ sample, so they cannot be run side by side on the same sample. They can however be skewed in time: while section k
+ works on sample n, section k + 1 works on sample n - 1 using the output that section k produced on the previous
+ step. This class runs as many sections per step as there are lanes in `SIMDMath::Native` (4, or 8 with AVX), so a deep
+ cascade on a mono or stereo signal costs about as much as a single section when there are no channels to spread
+ across the lanes.
+
+ Sections are processed in transposed direct form II. Each group of lanes fills its pipeline at the start of a block
+ and drains it at the end, so there is no added latency and the output matches running the sections one after the
+ other. Cascades with more sections than lanes are split into groups that run one after the other over the block.
+ */
+class BiquadCascade {
+public:
+  using Coefficients = BiquadFilter::Coefficients;
+
+  /// @returns the number of sections that are processed together
+  static size_t width();
+
+  /**
+   Install the sections to apply, in the order they are applied, and clear the filter state. Allocates memory so it
+   must not be done on the render thread.
+
+   @param sections the coefficients of each section
+   @param numChannels number of channels the filter will process
+   */
+  void setSections(std::vector<Coefficients> const& sections, size_t numChannels);
+
+  /**
+   Change the coefficients of one section without touching the filter state. Does not allocate.
+
+   @param index the section to change
+   @param coefficients the new coefficients to use
+   */
+  void setSection(size_t index, Coefficients const& coefficients);
+
+  /**
+   Apply the cascade to a collection of audio samples that are spaced `stride` samples apart in memory. Input and
+   output may be the same buffers for in-place operation.
+
+   @param ins array of pointers to the first sample of each channel to process
+   @param outs array of pointers to where to store the first filtered sample of each channel
+   @param stride the distance between consecutive samples of a channel
+   @param frameCount the number of samples to process in each channel
+   */
+  void apply(float const* const* ins, float* const* outs, long stride, size_t frameCount);
+
+  /**
+   Apply the cascade to a collection of audio samples.
+
+   @param ins the array of samples to process
+   @param outs the storage for the filtered results
+   @param frameCount the number of samples to process in the sequences
+   */
+  void apply(std::vector<float const*> const& ins, std::vector<float*>& outs, size_t frameCount)
+  {
+    assert(numChannels_ == ins.size() && numChannels_ == outs.size());
+    apply(ins.data(), outs.data(), 1, frameCount);
+  }
+
+  /**
+   Clear the delay state of all sections so that the next sample is processed as if only silence had come before.
+   */
+  void resetState();
+
+  /// @returns the number of sections in the cascade
+  size_t numSections() const { return numSections_; }
+
+  /// @returns the number of channels the cascade was configured for
+  size_t numChannels() const { return numChannels_; }
+
+private:
+  size_t numSections_ = 0;
+  size_t numChannels_ = 0;
+  size_t numGroups_ = 0;
+
+  /// Coefficients for each group as 5 vectors of `width()` values (b0, b1, b2, a1, a2). Unused lanes pass samples
+  /// through unchanged.
+  std::vector<float> coefficients_;
+
+  /// Delay state for each channel and group as 2 vectors of `width()` values.
+  std::vector<float> states_;
+};
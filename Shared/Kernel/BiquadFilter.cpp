@@ -1,34 +1,161 @@
 // Copyright © 2020 Brad Howes. All rights reserved.
 
-#include <Accelerate/../Frameworks/vecLib.framework/Headers/vForce.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 
 #include "BiquadFilter.h"
 
+#if LPF_HAVE_ACCELERATE
+#include <Accelerate/../Frameworks/vecLib.framework/Headers/vForce.h>
+#endif
+
+#include "SIMDMath.hpp"
+
 enum Index { B0 = 0, B1, B2, A1, A2 };
 
-void
-BiquadFilter::calculateParams(float frequency, float resonance, float nyquistPeriod, size_t numChannels)
+constexpr float BiquadFilter::lowCutoff;
+constexpr float BiquadFilter::lowCutoffRelease;
+
+// Stop the compiler from fusing multiplies and adds into FMA instructions in the functions below, since whether it can
+// depends on the target CPU and would change their results.
+#if defined(__clang__)
+#define LPF_NO_FP_CONTRACT _Pragma("clang fp contract(off)")
+#define LPF_NO_FP_CONTRACT_FUNCTION
+#elif defined(__GNUC__)
+#define LPF_NO_FP_CONTRACT
+#define LPF_NO_FP_CONTRACT_FUNCTION __attribute__((optimize("fp-contract=off")))
+#else
+#define LPF_NO_FP_CONTRACT
+#define LPF_NO_FP_CONTRACT_FUNCTION
+#endif
+
+namespace {
+
+/// Sine and cosine of an angle in [0, pi] from their Taylor series, which converge to double precision by 30 terms.
+LPF_NO_FP_CONTRACT_FUNCTION void exactSinCos(double x, double& sine, double& cosine)
+{
+  LPF_NO_FP_CONTRACT
+  double x2 = x * x;
+  sine = 1.0;
+  cosine = 1.0;
+  for (int n = 30; n > 0; n -= 2) {
+    sine = 1.0 - sine * x2 / double(n * (n + 1));
+    cosine = 1.0 - cosine * x2 / double(n * (n - 1));
+  }
+  sine *= x;
+}
+
+/// e^x by splitting off a power of two and summing the Taylor series of the remainder (|r| <= ln(2) / 2).
+LPF_NO_FP_CONTRACT_FUNCTION double exactExp(double x)
+{
+  LPF_NO_FP_CONTRACT
+  double n = std::floor(x * 1.4426950408889634 + 0.5);
+  double r = x - n * 0.6931471805599453;
+  double sum = 1.0;
+  for (int k = 24; k > 0; --k) sum = 1.0 + sum * r / double(k);
+  return std::ldexp(sum, int(n));
+}
+
+} // end namespace
+
+BiquadFilter::Coefficients
+BiquadFilter::lowPass(float frequency, float resonance, float nyquistPeriod)
 {
-  if (lastFrequency_ == frequency && lastResonance_ == resonance && numChannels == lastNumChannels_) return;
-  
   const double frequencyRads = M_PI * frequency * nyquistPeriod;
   const double r = ::powf(10.0, 0.05 * -resonance);
   const double k  = 0.5 * r * ::sinf(frequencyRads);
   const double c1 = (1.0 - k) / (1.0 + k);
   const double c2 = (1.0 + c1) * ::cosf(frequencyRads);
   const double c3 = (1.0 + c1 - c2) * 0.25;
-  
+
+  Coefficients coefficients;
+  coefficients.b0 = c3;
+  coefficients.b1 = c3 + c3;
+  coefficients.b2 = c3;
+  coefficients.a1 = -c2;
+  coefficients.a2 = c1;
+  return coefficients;
+}
+
+BiquadFilter::Coefficients
+BiquadFilter::bandPass(float frequency, float q, float nyquistPeriod)
+{
+  const double frequencyRads = M_PI * frequency * nyquistPeriod;
+  const double alpha = std::sin(frequencyRads) / (2.0 * q);
+  const double a0 = 1.0 + alpha;
+
+  Coefficients coefficients;
+  coefficients.b0 = alpha / a0;
+  coefficients.b1 = 0.0;
+  coefficients.b2 = -alpha / a0;
+  coefficients.a1 = -2.0 * std::cos(frequencyRads) / a0;
+  coefficients.a2 = (1.0 - alpha) / a0;
+  return coefficients;
+}
+
+BiquadFilter::Coefficients
+BiquadFilter::notch(float frequency, float q, float nyquistPeriod)
+{
+  const double frequencyRads = M_PI * frequency * nyquistPeriod;
+  const double alpha = std::sin(frequencyRads) / (2.0 * q);
+  const double a0 = 1.0 + alpha;
+
+  Coefficients coefficients;
+  coefficients.b0 = 1.0 / a0;
+  coefficients.b1 = -2.0 * std::cos(frequencyRads) / a0;
+  coefficients.b2 = coefficients.b0;
+  coefficients.a1 = coefficients.b1;
+  coefficients.a2 = (1.0 - alpha) / a0;
+  return coefficients;
+}
+
+BiquadFilter::Coefficients LPF_NO_FP_CONTRACT_FUNCTION
+BiquadFilter::lowPassDeterministic(float frequency, float resonance, float nyquistPeriod)
+{
+  LPF_NO_FP_CONTRACT
+  const double frequencyRads = M_PI * double(frequency) * double(nyquistPeriod);
+  const double r = exactExp(-0.05 * double(resonance) * 2.302585092994046);
+  double sine, cosine;
+  exactSinCos(std::min(std::max(frequencyRads, 0.0), M_PI), sine, cosine);
+  const double k  = 0.5 * r * sine;
+  const double c1 = (1.0 - k) / (1.0 + k);
+  const double c2 = (1.0 + c1) * cosine;
+  const double c3 = (1.0 + c1 - c2) * 0.25;
+
+  Coefficients coefficients;
+  coefficients.b0 = c3;
+  coefficients.b1 = c3 + c3;
+  coefficients.b2 = c3;
+  coefficients.a1 = -c2;
+  coefficients.a2 = c1;
+  return coefficients;
+}
+
+void
+BiquadFilter::calculateParams(float frequency, float resonance, float nyquistPeriod, size_t numChannels)
+{
+  if (lastFrequency_ == frequency && lastResonance_ == resonance && lastNyquistPeriod_ == nyquistPeriod &&
+      numChannels == lastNumChannels_) return;
+
+  coefficients_ = active_ == Engine::deterministic ? lowPassDeterministic(frequency, resonance, nyquistPeriod)
+  : lowPass(frequency, resonance, nyquistPeriod);
+
   F_.clear();
   F_.reserve(5 * numChannels);
   
   for (auto channel = 0; channel < numChannels; ++channel) {
-    F_.push_back(c3);
-    F_.push_back(c3 + c3);
-    F_.push_back(c3);
-    F_.push_back(-c2);
-    F_.push_back(c1);
+    F_.push_back(coefficients_.b0);
+    F_.push_back(coefficients_.b1);
+    F_.push_back(coefficients_.b2);
+    F_.push_back(coefficients_.a1);
+    F_.push_back(coefficients_.a2);
   }
-  
+
+  // A change in channel count restarts the filter (below for Accelerate), so start over with fresh state as well.
+  if (numChannels != lastNumChannels_) states_.assign(numChannels, State());
+
+#if LPF_HAVE_ACCELERATE
   // As long as we have the same number of channels, we can use Accelerate's function to update the filter.
   if (setup_ != nullptr && numChannels == lastNumChannels_) {
     vDSP_biquadm_SetTargetsDouble(setup_, F_.data(), updateRate_, threshold_, 0, 0, 1, numChannels);
@@ -39,45 +166,352 @@ BiquadFilter::calculateParams(float frequency, float resonance, float nyquistPer
     if (setup_ != nullptr) vDSP_biquadm_DestroySetup(setup_);
     setup_ = vDSP_biquadm_CreateSetup(F_.data(), 1, numChannels);
   }
-  
+#endif
+
+  // The coupled form is sized along with everything else so that switching to it later does not allocate.
+  bool coupled = wantsCoupled(frequency, nyquistPeriod);
+  if (coupled || active_ == Engine::coupled || numChannels != lastNumChannels_) {
+    auto topology = coupled_.activeTopology();
+    coupled_.calculateParams(frequency, resonance, nyquistPeriod, numChannels);
+    // Real poles put the coupled form into another structure, which cannot use the old state.
+    if (active_ == Engine::coupled && coupled_.activeTopology() != topology) loadCoupledState();
+  }
+
   lastFrequency_ = frequency;
   lastResonance_ = resonance;
+  lastNyquistPeriod_ = nyquistPeriod;
   lastNumChannels_ = numChannels;
+
+  if (coupled) activate(Engine::coupled);
+  else if (active_ == Engine::coupled) activate(engine_ == Engine::accelerate ? Engine::portable : engine_);
+}
+
+bool
+BiquadFilter::wantsCoupled(float frequency, float nyquistPeriod) const
+{
+  if (engine_ == Engine::coupled) return true;
+  if (engine_ == Engine::deterministic) return false;
+  return frequency * nyquistPeriod < (active_ == Engine::coupled ? lowCutoffRelease : lowCutoff);
+}
+
+void
+BiquadFilter::activate(Engine engine)
+{
+  if (engine == active_) return;
+  auto previous = active_;
+  active_ = engine;
+
+  // Going to a portable engine is seamless since the state is tracked for it. Going the other way, vDSP can only be
+  // cleared, so the portable engine stands in for Accelerate until the next `resetState` unless there is no state to
+  // carry over.
+  if (engine == Engine::accelerate) {
+    bool silent = std::all_of(states_.begin(), states_.end(), [](State const& state) {
+      return state.x1 == 0.0f && state.x2 == 0.0f && state.y1 == 0.0f && state.y2 == 0.0f;
+    });
+    if (silent) resetState();
+    else active_ = Engine::portable;
+  }
+
+  if (lastNumChannels_ == 0) return;
+
+  if (engine == Engine::deterministic || previous == Engine::deterministic) {
+    float frequency = lastFrequency_;
+    lastFrequency_ = -1.0;
+    calculateParams(frequency, lastResonance_, lastNyquistPeriod_, lastNumChannels_);
+  }
+
+  if (engine == Engine::coupled) {
+    coupled_.calculateParams(lastFrequency_, lastResonance_, lastNyquistPeriod_, lastNumChannels_);
+    loadCoupledState();
+  }
+}
+
+void
+BiquadFilter::loadCoupledState()
+{
+  for (size_t channel = 0; channel < lastNumChannels_; ++channel) {
+    auto const& s = states_[channel];
+    coupled_.loadDirectFormState(channel, s.x1, s.x2, s.y1, s.y2);
+  }
+}
+
+void
+BiquadFilter::apply(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  assert(lastNumChannels_ > 0);
+#if LPF_HAVE_ACCELERATE
+  if (active_ == Engine::accelerate) {
+    applyAccelerate(ins, outs, stride, frameCount);
+    return;
+  }
+#endif
+  if (active_ == Engine::coupled) {
+    applyCoupled(ins, outs, stride, frameCount);
+    return;
+  }
+  if (active_ == Engine::deterministic) {
+    for (size_t channel = 0; channel < lastNumChannels_; ++channel) {
+      applyDeterministic(channel, ins[channel], outs[channel], stride, frameCount);
+    }
+    return;
+  }
+  applyPortable(ins, outs, stride, frameCount);
+}
+
+/**
+ Update the history of a state with the last samples of a block.
+
+ @param last pointer to the last sample of the block
+ @param stride distance between consecutive samples
+ @param frameCount number of samples in the block
+ @param h1 the most recent history value to update
+ @param h2 the older history value to update
+ */
+static inline void recordHistory(float const* last, long stride, size_t frameCount, float& h1, float& h2)
+{
+  h2 = frameCount > 1 ? last[-stride] : h1;
+  h1 = last[0];
+}
+
+void
+BiquadFilter::recordInputs(float const* const* ins, long stride, size_t frameCount)
+{
+  auto lastOffset = long(frameCount - 1) * stride;
+  for (size_t channel = 0; channel < lastNumChannels_; ++channel) {
+    auto& s = states_[channel];
+    recordHistory(ins[channel] + lastOffset, stride, frameCount, s.x1, s.x2);
+  }
+}
+
+void
+BiquadFilter::recordOutputs(float const* const* outs, long stride, size_t frameCount)
+{
+  auto lastOffset = long(frameCount - 1) * stride;
+  for (size_t channel = 0; channel < lastNumChannels_; ++channel) {
+    auto& s = states_[channel];
+    recordHistory(outs[channel] + lastOffset, stride, frameCount, s.y1, s.y2);
+  }
+}
+
+void
+BiquadFilter::applyCoupled(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  if (frameCount == 0) return;
+
+  // As with Accelerate, the direct form I history is taken from the samples, inputs first since in-place rendering
+  // will overwrite them.
+  recordInputs(ins, stride, frameCount);
+  coupled_.apply(ins, outs, stride, frameCount);
+  recordOutputs(outs, stride, frameCount);
+}
+
+void
+BiquadFilter::applyPortable(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  for (size_t channel = 0; channel < lastNumChannels_; ++channel) {
+    applyPortable(channel, ins[channel], outs[channel], stride, frameCount);
+  }
+}
+
+void
+BiquadFilter::applyPortable(size_t channel, float const* in, float* out, long stride, size_t frameCount)
+{
+  auto const c = coefficients_;
+  auto s = states_[channel];
+  for (size_t index = 0; index < frameCount; ++index) {
+    float x = *in;
+    float y = c.b0 * x + c.b1 * s.x1 + c.b2 * s.x2 - c.a1 * s.y1 - c.a2 * s.y2;
+    s.x2 = s.x1;
+    s.x1 = x;
+    s.y2 = s.y1;
+    s.y1 = y;
+    *out = y;
+    in += stride;
+    out += stride;
+  }
+  states_[channel] = s;
+}
+
+void LPF_NO_FP_CONTRACT_FUNCTION
+BiquadFilter::applyDeterministic(size_t channel, float const* in, float* out, long stride, size_t frameCount)
+{
+  LPF_NO_FP_CONTRACT
+  // Products of two floats are exact in double, so a fused multiply-add gives the same sum as a multiply and an add.
+  // Denormals are flushed here so that the DAZ and FTZ modes of the thread have nothing to act on.
+  auto const c = coefficients_;
+  auto s = states_[channel];
+  for (size_t index = 0; index < frameCount; ++index) {
+    float x = *in;
+    if (std::fabs(x) < FLT_MIN) x = 0.0f;
+    double sum = double(c.b0) * double(x);
+    sum = sum + double(c.b1) * double(s.x1);
+    sum = sum + double(c.b2) * double(s.x2);
+    sum = sum - double(c.a1) * double(s.y1);
+    sum = sum - double(c.a2) * double(s.y2);
+    float y = std::fabs(sum) < double(FLT_MIN) ? 0.0f : float(sum);
+    s.x2 = s.x1;
+    s.x1 = x;
+    s.y2 = s.y1;
+    s.y1 = y;
+    *out = y;
+    in += stride;
+    out += stride;
+  }
+  states_[channel] = s;
+}
+
+bool
+BiquadFilter::canLink() const
+{
+  // The state of the coupled form is its own and is not compared here. The Accelerate engine records the direct form I
+  // state of every channel, so equal states mean its channels are in step as well.
+  if (lastNumChannels_ == 0 || active_ == Engine::coupled) return false;
+
+  // Bitwise comparison: channels that were fed the same samples from the same state hold exactly the same values.
+  for (size_t channel = 1; channel < lastNumChannels_; ++channel) {
+    if (memcmp(&states_[channel], &states_[0], sizeof(State)) != 0) return false;
+  }
+  return true;
+}
+
+bool
+BiquadFilter::applyLinked(float const* in, float* out, long stride, size_t frameCount)
+{
+  assert(lastNumChannels_ > 0);
+  if (!canLink()) return false;
+
+  // vDSP_biquadm cannot run just one channel of its setup, so the portable engine takes over from the state recorded
+  // for Accelerate, standing in for it until the next `resetState`.
+  if (active_ == Engine::accelerate) active_ = Engine::portable;
+
+  if (active_ == Engine::deterministic) applyDeterministic(0, in, out, stride, frameCount);
+  else applyPortable(0, in, out, stride, frameCount);
+  std::fill(states_.begin() + 1, states_.end(), states_[0]);
+  return true;
+}
+
+#if LPF_HAVE_ACCELERATE
+
+void
+BiquadFilter::applyAccelerate(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  if (frameCount == 0) return;
+
+  // vDSP_biquadm keeps its delay values to itself, but for a direct form I section they are just the last two inputs
+  // and outputs. Record the inputs first since in-place rendering will overwrite them.
+  recordInputs(ins, stride, frameCount);
+
+  vDSP_biquadm(setup_,
+               (float const* __nonnull* __nonnull)ins, vDSP_Stride(stride),
+               (float * __nonnull * __nonnull)outs, vDSP_Stride(stride),
+               vDSP_Length(frameCount));
+
+  recordOutputs(outs, stride, frameCount);
+}
+
+#endif
+
+void
+BiquadFilter::setEngine(Engine engine)
+{
+#if !LPF_HAVE_ACCELERATE
+  if (engine == Engine::accelerate) engine = Engine::portable;
+#endif
+  if (engine == engine_) return;
+  engine_ = engine;
+  activate(lastNumChannels_ > 0 && wantsCoupled(lastFrequency_, lastNyquistPeriod_) ? Engine::coupled : engine);
+}
+
+void
+BiquadFilter::resetState()
+{
+  for (auto& state : states_) state = State();
+  coupled_.resetState();
+#if LPF_HAVE_ACCELERATE
+  if (setup_ != nullptr) vDSP_biquadm_ResetState(setup_);
+#endif
+  // With nothing to carry over, Accelerate can take back over from the portable engine (see `calculateParams`).
+  if (engine_ == Engine::accelerate && active_ == Engine::portable) active_ = Engine::accelerate;
+}
+
+void
+BiquadFilter::setState(size_t channel, State const& state)
+{
+  assert(channel < states_.size());
+  states_[channel] = state;
+  if (active_ == Engine::accelerate) active_ = Engine::portable;
+  else if (active_ == Engine::coupled) coupled_.loadDirectFormState(channel, state.x1, state.x2, state.y1, state.y2);
+}
+
+void
+BiquadFilter::settleToDC(size_t channel, float value)
+{
+  auto const& c = coefficients_;
+  float gain = (c.b0 + c.b1 + c.b2) / (1.0f + c.a1 + c.a2);
+  State state;
+  state.x1 = value;
+  state.x2 = value;
+  state.y1 = gain * value;
+  state.y2 = gain * value;
+  setState(channel, state);
+}
+
+bool
+BiquadFilter::copyStateFrom(BiquadFilter const& other)
+{
+  if (lastNumChannels_ == 0 || lastNumChannels_ != other.lastNumChannels_) return false;
+#if LPF_HAVE_ACCELERATE
+  if (active_ == Engine::accelerate && other.active_ == Engine::accelerate) {
+    vDSP_biquadm_CopyState(setup_, other.setup_);
+    states_ = other.states_;
+    return true;
+  }
+#endif
+  for (size_t channel = 0; channel < lastNumChannels_; ++channel) setState(channel, other.states_[channel]);
+  return true;
 }
 
 /**
  Convert "bad" values (NaNs, very small, and very large values to 1.0. This is not mandatory, but it will remove the
  pesky warnings from CoreGraphics when they appear in the Bezier path. Set CG_NUMERICS_SHOW_BACKTRACE to
- "YES" in the Run scheme to see where they happen.
- 
- - parameter x: value to check
- - returns: filtered value or 1.0
- */
-static inline float filterBadValues(float x) { return ::fabs(x) > 1e-15 && ::fabs(x) < 1e15 && x != 0.0 ? x : 1.0; }
+ "YES" in the Run scheme to see where they happen. Works on squared magnitudes, so the thresholds are squared as well.
 
-static inline float squared(float x) { return x * x; }
+ - parameter x: squared magnitudes to check
+ - returns: filtered values or 1.0
+ */
+static inline SIMDMath::Float4 filterBadValues(SIMDMath::Float4 x) {
+  auto good = (x > 1e-30f) & (x < 1e30f);
+  return SIMDMath::Detail::select(good, x, SIMDMath::splat<SIMDMath::Float4>(1.0f));
+}
 
 void
 BiquadFilter::magnitudes(float const* frequencies, size_t count, float inverseNyquist, float* magnitudes) const
 {
+  using namespace SIMDMath;
+
+  float b0 = F_[B0];
+  float b1 = F_[B1];
+  float b2 = F_[B2];
+  float a1 = F_[A1];
+  float a2 = F_[A2];
   float scale = M_PI * inverseNyquist;
-  while (count-- > 0) {
-    float theta = scale * *frequencies++;
-    float zReal = ::cosf(theta);
-    float zImag = ::sinf(theta);
-    
-    float zReal2 = squared(zReal);
-    float zImag2 = squared(zImag);
-    float numerReal = F_[B0] * (zReal2 - zImag2) + F_[B1] * zReal + F_[B2];
-    float numerImag = 2.0 * F_[B0] * zReal * zImag + F_[B1] * zImag;
-    float numerMag = ::sqrt(squared(numerReal) + squared(numerImag));
-    
-    float denomReal = zReal2 - zImag2 + F_[A1] * zReal + F_[A2];
-    float denomImag = 2.0 * zReal * zImag + F_[A1] * zImag;
-    float denomMag = ::sqrt(squared(denomReal) + squared(denomImag));
-    
-    float value = numerMag / denomMag;
-    
-    *magnitudes++ = 20.0 * ::log10(filterBadValues(value));
-  }
+
+  // Work on 4 frequencies at a time. The response is |H|^2 = |N|^2 / |D|^2 so no square roots are necessary -- just
+  // take 10 * log10 instead of 20 * log10.
+  transform<Float4>(frequencies, magnitudes, count, [=](Float4 frequency) {
+    Float4 zImag, zReal;
+    sincos<Accuracy::precise>(scale * frequency, zImag, zReal);
+
+    Float4 zReal2 = zReal * zReal;
+    Float4 zImag2 = zImag * zImag;
+    Float4 numerReal = b0 * (zReal2 - zImag2) + b1 * zReal + b2;
+    Float4 numerImag = 2.0f * b0 * zReal * zImag + b1 * zImag;
+    Float4 numerMag2 = numerReal * numerReal + numerImag * numerImag;
+
+    Float4 denomReal = zReal2 - zImag2 + a1 * zReal + a2;
+    Float4 denomImag = 2.0f * zReal * zImag + a1 * zImag;
+    Float4 denomMag2 = denomReal * denomReal + denomImag * denomImag;
+
+    return 10.0f * log10<Accuracy::precise>(filterBadValues(numerMag2 / denomMag2));
+  });
 }
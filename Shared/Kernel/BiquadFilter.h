@@ -2,19 +2,121 @@
 
 #pragma once
 
+#if defined(__APPLE__)
 #include <Accelerate/Accelerate.h>
+#define LPF_HAVE_ACCELERATE 1
+#else
+#define LPF_HAVE_ACCELERATE 0
+#endif
+
+#include <cassert>
 #include <cmath>
 #include <vector>
 
+#include "BiquadTopologyFilter.h"
+
 /**
  Handles the configuration and use of a bi-quad filter. Uses Accelerate framework for fast vectorized processing of the
  filter on a set of samples.
+
+ The filter can also run on a portable direct form I implementation whose delay state is held by this class instead of
+ inside Accelerate's opaque `vDSP_biquadm_Setup`. That state can be read, written, copied and reset per channel.
  */
 class BiquadFilter {
 public:
+
+  /**
+   The implementations available for processing samples.
+   */
+  enum class Engine {
+    /// Use Accelerate's vDSP_biquadm. Coefficient changes are smoothed by Accelerate.
+    accelerate,
+    /// Use the portable direct form I implementation in this class.
+    portable,
+    /// Like `portable`, but the output is bit-identical on every CPU and compiler. Coefficients come from a fixed
+    /// sequence of basic operations instead of libm, and each sample is summed in double precision from exact products
+    /// in a fixed order, so FMA contraction cannot change it. Denormals are flushed explicitly, so flush-to-zero
+    /// settings cannot change it either. Since the state is exact, a render split into segments at any points (e.g. by
+    /// worker count) matches an unsplit one when each segment starts from the previous segment's `getState`.
+    deterministic,
+    /// Run the filter in the Gold-Rader coupled form of BiquadTopologyFilter, designed in double precision. It stays
+    /// accurate in float at low cutoffs, where the direct form does not. Used for such cutoffs in place of the other
+    /// engines (see `calculateParams`) but may also be selected outright.
+    coupled
+  };
+
+  /**
+   The delay state of one channel of the filter in direct form I: the last two inputs and the last two outputs. This
+   fully describes where a second-order section is, so a filter that is given this state will produce the same output
+   as the one it was taken from.
+   */
+  struct State {
+    float x1 = 0.0;
+    float x2 = 0.0;
+    float y1 = 0.0;
+    float y2 = 0.0;
+  };
+
+  /// Coefficients of the transfer function (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)
+  struct Coefficients {
+    float b0 = 0.0;
+    float b1 = 0.0;
+    float b2 = 0.0;
+    float a1 = 0.0;
+    float a2 = 0.0;
+  };
+
+  /**
+   Obtain the coefficients of a low-pass filter with the given frequency and resonance values.
+
+   @param frequency the cutoff frequency for the low-pass filter
+   @param resonance the resonance setting for the low-pass filter
+   @param nyquistPeriod equivalent to 1.0 / (0.5 * sampleRate)
+   @returns the filter coefficients
+   */
+  static Coefficients lowPass(float frequency, float resonance, float nyquistPeriod);
+
+  /**
+   Obtain the coefficients of a band-pass filter with unity gain at its center frequency.
+
+   @param frequency the center frequency of the band
+   @param q the ratio of the center frequency to the bandwidth
+   @param nyquistPeriod equivalent to 1.0 / (0.5 * sampleRate)
+   @returns the filter coefficients
+   */
+  static Coefficients bandPass(float frequency, float q, float nyquistPeriod);
+
+  /**
+   Obtain the coefficients of a notch filter that removes its center frequency and passes everything else at unity gain.
+
+   @param frequency the frequency to remove
+   @param q the ratio of the center frequency to the width of the notch at its -3 dB points
+   @param nyquistPeriod equivalent to 1.0 / (0.5 * sampleRate)
+   @returns the filter coefficients
+   */
+  static Coefficients notch(float frequency, float q, float nyquistPeriod);
+
+  /**
+   Obtain the coefficients of a low-pass filter with the given frequency and resonance values without using libm, whose
+   results vary between platforms. Used by the deterministic engine; agrees with `lowPass` to within float rounding.
+
+   @param frequency the cutoff frequency for the low-pass filter
+   @param resonance the resonance setting for the low-pass filter
+   @param nyquistPeriod equivalent to 1.0 / (0.5 * sampleRate)
+   @returns the filter coefficients
+   */
+  static Coefficients lowPassDeterministic(float frequency, float resonance, float nyquistPeriod);
+
   /**
    Calculate the parameters for a low-pass filter with the given frequency and resonance values.
 
+   With poles this close to z = 1 the direct form loses most of its accuracy in float (the error is -40 dB of the
+   signal at 20 Hz and 48 kHz, and -13 dB at 20 Hz and 192 kHz), so cutoffs below `lowCutoff` times the Nyquist
+   frequency are processed with the coupled engine instead, unless the deterministic engine is selected. The switch
+   carries the filter state over. The filter goes back to its engine once the cutoff is above `lowCutoffRelease` times
+   the Nyquist frequency. Accelerate cannot take over a running state, so the portable engine stands in for it until
+   the next `resetState`.
+
    @param frequency the cutoff frequency for the low-pass filter
    @param resonance the resonance setting for the low-pass filter
    @param nyquistPeriod equivalent to 1.0 / (0.5 * sampleRate)
@@ -39,24 +141,155 @@ public:
    @param outs the storage for the filtered results
    @param frameCount the number of samples to process in the sequences
    */
-  void apply(std::vector<float const*> const& ins, std::vector<float*>& outs, size_t frameCount) const
+  void apply(std::vector<float const*> const& ins, std::vector<float*>& outs, size_t frameCount)
   {
     assert(lastNumChannels_ == ins.size() && lastNumChannels_ == outs.size());
-    vDSP_biquadm(setup_,
-                 (float const* __nonnull* __nonnull)ins.data(), vDSP_Stride(1),
-                 (float * __nonnull * __nonnull)outs.data(), vDSP_Stride(1),
-                 vDSP_Length(frameCount));
+    apply(ins.data(), outs.data(), 1, frameCount);
   }
 
+  /**
+   Apply the filter to a collection of audio samples that are spaced `stride` samples apart in memory. With a stride
+   of 1 this works on planar (non-interleaved) buffers; with a stride equal to the channel count and channel pointers
+   that are offset by one sample from each other, it works in place on interleaved buffers.
+
+   @param ins array of pointers to the first sample of each channel to process
+   @param outs array of pointers to where to store the first filtered sample of each channel
+   @param stride the distance between consecutive samples of a channel
+   @param frameCount the number of samples to process in each channel
+   */
+  void apply(float const* const* ins, float* const* outs, long stride, size_t frameCount);
+
+  /**
+   Determine if `applyLinked` can be used right now. This works with every engine but the coupled one, and only while
+   every channel has the same state as the first one -- which remains true for as long as the channels see the same
+   input. It is cheap, so check it before going to the trouble of comparing inputs.
+
+   @returns true if the channels can be linked
+   */
+  bool canLink() const;
+
+  /**
+   Filter samples on behalf of all channels when every channel has the same input (dual-mono material). Only the first
+   channel is filtered and its state is then given to the other channels, so they stay in step with it. The caller is
+   responsible for copying the results to the other channels' outputs.
+
+   This only works when `canLink` is true. Accelerate cannot filter one channel of a multichannel setup, so with the
+   Accelerate engine the portable engine takes over, standing in for it until the next `resetState` as it does in
+   `setEngine`.
+
+   @param in pointer to the first sample to process
+   @param out pointer to where to store the first filtered sample
+   @param stride the distance between consecutive samples
+   @param frameCount the number of samples to process
+   @returns false if nothing was done because the channels cannot be linked
+   */
+  bool applyLinked(float const* in, float* out, long stride, size_t frameCount);
+
+  /**
+   Select the implementation to use for processing. Without Accelerate support, asking for it selects the portable
+   engine. Moving to or from the deterministic engine recalculates the coefficients. Accelerate cannot take over a
+   running state, so if the filter has one the portable engine stands in for Accelerate until the next `resetState`.
+
+   @param engine the implementation to use
+   */
+  void setEngine(Engine engine);
+
+  /// @returns the implementation selected for processing
+  Engine engine() const { return engine_; }
+
+  /// @returns the implementation doing the processing, which differs from `engine` for low cutoffs
+  Engine activeEngine() const { return active_; }
+
+  /// Fraction of the Nyquist frequency below which the cutoff is low enough to need the coupled engine
+  static constexpr float lowCutoff = 0.01;
+
+  /// Fraction of the Nyquist frequency above which the coupled engine is no longer needed. Leaves room so that a
+  /// cutoff hovering at `lowCutoff` does not switch back and forth.
+  static constexpr float lowCutoffRelease = 0.0125;
+
+  /**
+   Clear the filter's delay state so that the next sample is processed as if the filter had only seen
+   silence. The filter coefficients are not touched.
+   */
+  void resetState();
+
+  /**
+   Obtain the delay state of a channel. With the Accelerate and coupled engines the state is taken from the samples at
+   the end of the last `apply` call, which is all that a direct form I section remembers.
+
+   @param channel the channel to query
+   @returns the state of the channel
+   */
+  State getState(size_t channel) const { return states_[channel]; }
+
+  /**
+   Install a new delay state for a channel. Accelerate provides no way to load the delay line of a
+   `vDSP_biquadm_Setup`, so doing this while using the Accelerate engine makes the portable engine stand in for it
+   until the next `resetState`, as `setEngine` does. The selected engine is kept. The coupled engine is given the state
+   that continues from the same history.
+
+   @param channel the channel to update
+   @param state the new state to use
+   */
+  void setState(size_t channel, State const& state);
+
+  /**
+   Initialize the delay state of a channel so that it is in the steady state for a constant input. Starting from this
+   state there is no transient when the first samples are at or near `value`.
+
+   @param channel the channel to update
+   @param value the DC input level to settle at
+   */
+  void settleToDC(size_t channel, float value);
+
+  /**
+   Copy the delay state of another filter into this one. Both filters must have been configured for the same number of
+   channels.
+
+   @param other the filter to copy from
+   @returns true if copied
+   */
+  bool copyStateFrom(BiquadFilter const& other);
+
+  /// @returns the coefficients from the last `calculateParams` call
+  Coefficients const& coefficients() const { return coefficients_; }
+
+  /// @returns the number of channels the filter was last configured for (0 if never configured)
+  size_t numChannels() const { return lastNumChannels_; }
+
 private:
+
+  void applyPortable(float const* const* ins, float* const* outs, long stride, size_t frameCount);
+  void applyPortable(size_t channel, float const* in, float* out, long stride, size_t frameCount);
+  void applyDeterministic(size_t channel, float const* in, float* out, long stride, size_t frameCount);
+  void applyCoupled(float const* const* ins, float* const* outs, long stride, size_t frameCount);
+  void recordInputs(float const* const* ins, long stride, size_t frameCount);
+  void recordOutputs(float const* const* outs, long stride, size_t frameCount);
+  bool wantsCoupled(float frequency, float nyquistPeriod) const;
+  void activate(Engine engine);
+  void loadCoupledState();
+
   std::vector<double> F_;
+  Coefficients coefficients_;
+  std::vector<State> states_;
+  BiquadTopologyFilter coupled_{BiquadTopologyFilter::Topology::coupledForm};
+
+#if LPF_HAVE_ACCELERATE
+  void applyAccelerate(float const* const* ins, float* const* outs, long stride, size_t frameCount);
+
   vDSP_biquadm_Setup setup_ = nullptr;
+  Engine engine_ = Engine::accelerate;
+  Engine active_ = Engine::accelerate;
+#else
+  Engine engine_ = Engine::portable;
+  Engine active_ = Engine::portable;
+#endif
 
   float lastFrequency_ = -1.0;
   float lastResonance_ = 1E10;
+  float lastNyquistPeriod_ = 0.0;
   size_t lastNumChannels_ = 0;
 
   float threshold_ = 0.05;
   float updateRate_ = 0.4;
 };
-
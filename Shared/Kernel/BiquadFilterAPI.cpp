@@ -0,0 +1,175 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <new>
+#include <vector>
+
+#include "BiquadFilter.h"
+#include "BiquadFilterAPI.h"
+
+/**
+ The concrete type behind the opaque LPFBiquad handle. Holds preallocated channel pointer arrays so that interleaved
+ processing does not allocate.
+ */
+struct LPFBiquad {
+  explicit LPFBiquad(size_t numChannels) : numChannels{numChannels}, ins(numChannels), outs(numChannels) {}
+
+  BiquadFilter filter;
+  BiquadFilter::Engine engineBeforeDeterministic = BiquadFilter::Engine::accelerate;
+  size_t const numChannels;
+  float nyquistPeriod = 0.0;
+  std::vector<float const*> ins;
+  std::vector<float*> outs;
+};
+
+static inline bool isConfigured(LPFBiquad const* filter) { return filter->filter.numChannels() == filter->numChannels; }
+
+int32_t LPFBiquadAPIVersion(void) { return LPF_BIQUAD_API_VERSION; }
+
+LPFBiquad* LPFBiquadCreate(size_t numChannels)
+{
+  if (numChannels == 0) return nullptr;
+  try {
+    return new LPFBiquad(numChannels);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void LPFBiquadDestroy(LPFBiquad* filter) { delete filter; }
+
+size_t LPFBiquadNumChannels(LPFBiquad const* filter) { return filter == nullptr ? 0 : filter->numChannels; }
+
+LPFBiquadStatus LPFBiquadConfigure(LPFBiquad* filter, float frequency, float resonance, double sampleRate)
+{
+  if (filter == nullptr || !(sampleRate > 0.0) || !(frequency > 0.0) || !(frequency < 0.5 * sampleRate)) {
+    return LPFBiquadStatusInvalidArgument;
+  }
+
+  filter->nyquistPeriod = 1.0 / (0.5 * sampleRate);
+  try {
+    filter->filter.calculateParams(frequency, resonance, filter->nyquistPeriod, filter->numChannels);
+  }
+  catch (...) {
+    return LPFBiquadStatusInvalidArgument;
+  }
+
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadProcess(LPFBiquad* filter, float const* const* ins, float* const* outs, ptrdiff_t stride,
+                                 size_t frameCount)
+{
+  if (filter == nullptr || ins == nullptr || outs == nullptr || stride == 0) return LPFBiquadStatusInvalidArgument;
+  if (!isConfigured(filter)) return LPFBiquadStatusNotConfigured;
+  if (frameCount == 0) return LPFBiquadStatusOK;
+  filter->filter.apply(ins, outs, stride, frameCount);
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadProcessInterleaved(LPFBiquad* filter, float const* in, float* out, size_t frameCount)
+{
+  if (filter == nullptr || in == nullptr || out == nullptr) return LPFBiquadStatusInvalidArgument;
+  for (size_t channel = 0; channel < filter->numChannels; ++channel) {
+    filter->ins[channel] = in + channel;
+    filter->outs[channel] = out + channel;
+  }
+
+  return LPFBiquadProcess(filter, filter->ins.data(), filter->outs.data(), ptrdiff_t(filter->numChannels),
+                          frameCount);
+}
+
+LPFBiquadStatus LPFBiquadProcessBatch(LPFBiquadJob* jobs, size_t jobCount)
+{
+  if (jobs == nullptr && jobCount > 0) return LPFBiquadStatusInvalidArgument;
+  LPFBiquadStatus result = LPFBiquadStatusOK;
+  for (size_t index = 0; index < jobCount; ++index) {
+    LPFBiquadJob& job{jobs[index]};
+    auto status = LPFBiquadProcess(job.filter, job.ins, job.outs, job.stride, job.frameCount);
+    job.status = status;
+    if (result == LPFBiquadStatusOK) result = status;
+  }
+
+  return result;
+}
+
+LPFBiquadStatus LPFBiquadResetState(LPFBiquad* filter)
+{
+  if (filter == nullptr) return LPFBiquadStatusInvalidArgument;
+  filter->filter.resetState();
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadCopyState(LPFBiquad* destination, LPFBiquad const* source)
+{
+  if (destination == nullptr || source == nullptr) return LPFBiquadStatusInvalidArgument;
+  if (destination->numChannels != source->numChannels) return LPFBiquadStatusChannelMismatch;
+  if (!isConfigured(destination) || !isConfigured(source)) return LPFBiquadStatusNotConfigured;
+  destination->filter.copyStateFrom(source->filter);
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadGetState(LPFBiquad const* filter, size_t channel, float* state)
+{
+  if (filter == nullptr || state == nullptr || channel >= filter->numChannels) return LPFBiquadStatusInvalidArgument;
+  if (!isConfigured(filter)) return LPFBiquadStatusNotConfigured;
+  auto value = filter->filter.getState(channel);
+  state[0] = value.x1;
+  state[1] = value.x2;
+  state[2] = value.y1;
+  state[3] = value.y2;
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadSetState(LPFBiquad* filter, size_t channel, float const* state)
+{
+  if (filter == nullptr || state == nullptr || channel >= filter->numChannels) return LPFBiquadStatusInvalidArgument;
+  if (!isConfigured(filter)) return LPFBiquadStatusNotConfigured;
+  BiquadFilter::State value;
+  value.x1 = state[0];
+  value.x2 = state[1];
+  value.y1 = state[2];
+  value.y2 = state[3];
+  filter->filter.setState(channel, value);
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadSettleToDC(LPFBiquad* filter, size_t channel, float value)
+{
+  if (filter == nullptr || channel >= filter->numChannels) return LPFBiquadStatusInvalidArgument;
+  if (!isConfigured(filter)) return LPFBiquadStatusNotConfigured;
+  filter->filter.settleToDC(channel, value);
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadSetDeterministic(LPFBiquad* filter, int enabled)
+{
+  if (filter == nullptr) return LPFBiquadStatusInvalidArgument;
+  auto& biquad = filter->filter;
+  try {
+    if (enabled && biquad.engine() != BiquadFilter::Engine::deterministic) {
+      filter->engineBeforeDeterministic = biquad.engine();
+      biquad.setEngine(BiquadFilter::Engine::deterministic);
+    }
+    else if (!enabled && biquad.engine() == BiquadFilter::Engine::deterministic) {
+      biquad.setEngine(filter->engineBeforeDeterministic);
+    }
+  }
+  catch (...) {
+    return LPFBiquadStatusInvalidArgument;
+  }
+
+  return LPFBiquadStatusOK;
+}
+
+LPFBiquadStatus LPFBiquadMagnitudes(LPFBiquad const* filter, float const* frequencies, size_t count,
+                                    float* magnitudes)
+{
+  if (filter == nullptr || (count > 0 && (frequencies == nullptr || magnitudes == nullptr))) {
+    return LPFBiquadStatusInvalidArgument;
+  }
+
+  if (!isConfigured(filter)) return LPFBiquadStatusNotConfigured;
+  filter->filter.magnitudes(frequencies, count, filter->nyquistPeriod, magnitudes);
+  return LPFBiquadStatusOK;
+}
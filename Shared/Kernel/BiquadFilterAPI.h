@@ -0,0 +1,204 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ Stable C interface to the BiquadFilter class so that the filter can be used from other runtimes such as Python (via
+ `ctypes` or `cffi`), Rust or Go without going through Objective-C. Audio buffers are always owned by the caller and are
+ filtered where they live: nothing is copied, so NumPy arrays and the like can be processed in place.
+
+ Only plain C types cross the boundary, no function throws, and failures are reported with `LPFBiquadStatus` values.
+ Existing declarations will not change; new functionality will be introduced with new functions and an increment of
+ `LPF_BIQUAD_API_VERSION`.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LPF_BIQUAD_API_VERSION 3
+
+#if defined(__GNUC__)
+#define LPF_BIQUAD_EXPORT __attribute__((visibility("default")))
+#else
+#define LPF_BIQUAD_EXPORT
+#endif
+
+/**
+ Opaque handle to a filter instance.
+ */
+typedef struct LPFBiquad LPFBiquad;
+
+/**
+ Result codes returned by the API functions.
+ */
+typedef enum LPFBiquadStatus {
+  LPFBiquadStatusOK = 0,
+  LPFBiquadStatusInvalidArgument = -1,
+  LPFBiquadStatusNotConfigured = -2,
+  LPFBiquadStatusChannelMismatch = -3
+} LPFBiquadStatus;
+
+/**
+ Description of one unit of work for `LPFBiquadProcessBatch`.
+ */
+typedef struct LPFBiquadJob {
+  LPFBiquad* filter;        ///< the filter to use
+  float const* const* ins;  ///< pointers to the first sample of each channel to filter
+  float* const* outs;       ///< pointers to where to store the first filtered sample of each channel
+  ptrdiff_t stride;         ///< distance in samples between consecutive samples of a channel
+  size_t frameCount;        ///< number of samples to process in each channel
+  int32_t status;           ///< set to the LPFBiquadStatus value for this job after processing
+} LPFBiquadJob;
+
+/**
+ @returns the value of LPF_BIQUAD_API_VERSION that the library was built with
+ */
+LPF_BIQUAD_EXPORT int32_t LPFBiquadAPIVersion(void);
+
+/**
+ Create a new filter instance. The filter must be configured with `LPFBiquadConfigure` before it can process samples.
+
+ @param numChannels the number of channels the filter will process
+ @returns new filter instance or NULL if `numChannels` is 0 or there is no memory
+ */
+LPF_BIQUAD_EXPORT LPFBiquad* LPFBiquadCreate(size_t numChannels);
+
+/**
+ Release a filter instance. Passing NULL is allowed.
+
+ @param filter the instance to release
+ */
+LPF_BIQUAD_EXPORT void LPFBiquadDestroy(LPFBiquad* filter);
+
+/**
+ @param filter the instance to query
+ @returns the number of channels the filter was created with (0 for a NULL filter)
+ */
+LPF_BIQUAD_EXPORT size_t LPFBiquadNumChannels(LPFBiquad const* filter);
+
+/**
+ Set the filter's cutoff and resonance. May allocate the first time it is called, so do not call it for the first time
+ from a real-time thread. Changing only the sample rate recalculates the filter as well.
+
+ Where the filter runs on Accelerate (Apple platforms, unless bit-exact processing is on), a change of settings does
+ not take effect at once: Accelerate moves the filter towards the new settings over the next few hundred samples so
+ that automation does not click. Other engines, and `LPFBiquadMagnitudes`, use the new settings immediately.
+
+ @param filter the instance to configure
+ @param frequency the cutoff frequency in Hz. Must be greater than 0 and less than half the sample rate.
+ @param resonance the resonance in dB
+ @param sampleRate the sample rate of the audio that will be processed
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadConfigure(LPFBiquad* filter, float frequency, float resonance,
+                                                     double sampleRate);
+
+/**
+ Filter samples from caller-owned buffers. With a stride of 1 the buffers are planar; any other stride lets the filter
+ walk over interleaved or otherwise strided data (e.g. a column of a 2D NumPy array). Input and output may be the same
+ buffers for in-place operation.
+
+ @param filter the instance to use
+ @param ins array of `numChannels` pointers to the first sample of each input channel
+ @param outs array of `numChannels` pointers to where to store the first filtered sample of each channel
+ @param stride distance in samples between consecutive samples of a channel. Must not be 0.
+ @param frameCount the number of samples to process in each channel
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadProcess(LPFBiquad* filter, float const* const* ins, float* const* outs,
+                                                   ptrdiff_t stride, size_t frameCount);
+
+/**
+ Filter samples held in a single interleaved buffer (frame-major, `numChannels` samples per frame).
+
+ @param filter the instance to use
+ @param in the interleaved samples to filter
+ @param out the interleaved storage for the results (may be the same as `in`)
+ @param frameCount the number of frames to process
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadProcessInterleaved(LPFBiquad* filter, float const* in, float* out,
+                                                              size_t frameCount);
+
+/**
+ Process a collection of jobs with one call in order to amortize the cost of crossing the FFI boundary when filtering
+ many small buffers or many files. Jobs are run in the order given; all jobs are attempted even if one fails.
+
+ @param jobs the jobs to run. The `status` field of each is updated.
+ @param jobCount the number of jobs
+ @returns LPFBiquadStatusOK if all jobs succeeded, otherwise the status of the first failing job
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadProcessBatch(LPFBiquadJob* jobs, size_t jobCount);
+
+/**
+ Clear the filter's delay state so that the next sample is filtered as if only silence had come before.
+
+ @param filter the instance to reset
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadResetState(LPFBiquad* filter);
+
+/**
+ Copy the delay state of one filter into another. Both must have the same channel count and be configured.
+
+ @param destination the instance to update
+ @param source the instance to copy from
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadCopyState(LPFBiquad* destination, LPFBiquad const* source);
+
+/**
+ Obtain the delay state of one channel as four values in direct form I order: x[n-1], x[n-2], y[n-1], y[n-2]. Added in
+ API version 2.
+
+ @param filter the instance to query
+ @param channel the channel to query
+ @param state storage for the four state values
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadGetState(LPFBiquad const* filter, size_t channel, float* state);
+
+/**
+ Install the delay state of one channel from four values in the order returned by `LPFBiquadGetState`. A filter using
+ Accelerate switches to its portable engine since Accelerate's delay line cannot be loaded. Added in API version 2.
+
+ @param filter the instance to update
+ @param channel the channel to update
+ @param state the four state values to use
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadSetState(LPFBiquad* filter, size_t channel, float const* state);
+
+/**
+ Put one channel into the steady state for a constant input so that processing starts without a transient. Added in API
+ version 2.
+
+ @param filter the instance to update
+ @param channel the channel to update
+ @param value the DC input level to settle at
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadSettleToDC(LPFBiquad* filter, size_t channel, float value);
+
+/**
+ Turn bit-exact processing on or off. When on, the filter's output depends only on its inputs, settings and state, and
+ not on the CPU, compiler, or thread doing the work, so renders can be compared against stored results and a render may
+ be split into segments that hand their state on with `LPFBiquadGetState` and `LPFBiquadSetState`. It costs some speed.
+ Turning it off goes back to the engine the filter had before it was turned on. The delay state is kept. Added in API
+ version 3.
+
+ @param filter the instance to update
+ @param enabled non-zero to turn bit-exact processing on
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadSetDeterministic(LPFBiquad* filter, int enabled);
+
+/**
+ Calculate the frequency response of the filter in dB.
+
+ @param filter the instance to use
+ @param frequencies the frequencies (Hz) to evaluate
+ @param count the number of frequencies
+ @param magnitudes storage for `count` results
+ */
+LPF_BIQUAD_EXPORT LPFBiquadStatus LPFBiquadMagnitudes(LPFBiquad const* filter, float const* frequencies, size_t count,
+                                                      float* magnitudes);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,377 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include "BiquadPlanner.h"
+
+static char const* const wisdomHeader = "# BiquadPlanner wisdom 2";
+static char const* const previousWisdomHeader = "# BiquadPlanner wisdom 1";
+
+/**
+ Parse a count from a wisdom file. Unlike `std::stoul` this does not throw, and it rejects signs, trailing text, zero
+ and values out of range.
+
+ @param text the text to parse
+ @param value set to the parsed count
+ @returns true if the text holds a valid count
+ */
+static bool parseCount(std::string const& text, size_t& value)
+{
+  if (text.empty() || !isdigit(static_cast<unsigned char>(text[0]))) return false;
+  char* end = nullptr;
+  errno = 0;
+  auto parsed = strtoul(text.c_str(), &end, 10);
+  if (errno != 0 || *end != '\0' || parsed == 0 || parsed > std::numeric_limits<uint32_t>::max()) return false;
+  value = size_t(parsed);
+  return true;
+}
+
+/**
+ Parse a cost from a wisdom file. Unlike `std::stod` this does not throw, and it rejects trailing text and values that
+ are negative or not finite.
+
+ @param text the text to parse
+ @param value set to the parsed cost
+ @returns true if the text holds a valid cost
+ */
+static bool parseCost(std::string const& text, double& value)
+{
+  char* end = nullptr;
+  errno = 0;
+  auto parsed = strtod(text.c_str(), &end);
+  if (errno != 0 || end == text.c_str() || *end != '\0' || !std::isfinite(parsed) || parsed < 0.0) return false;
+  value = parsed;
+  return true;
+}
+
+/**
+ The engines that are worth measuring on this platform. BiquadCascade is not among them: it pipelines the sections of
+ a cascade, and a single low-pass section has nothing to pipeline.
+ */
+static std::vector<BiquadFilter::Engine> candidates()
+{
+#if LPF_HAVE_ACCELERATE
+  return {BiquadFilter::Engine::accelerate, BiquadFilter::Engine::portable, BiquadFilter::Engine::coupled};
+#else
+  return {BiquadFilter::Engine::portable, BiquadFilter::Engine::coupled};
+#endif
+}
+
+BiquadPlanner&
+BiquadPlanner::shared()
+{
+  static BiquadPlanner planner;
+  return planner;
+}
+
+void
+BiquadPlanner::setWisdomPath(std::string const& path)
+{
+  load(path);
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = path;
+}
+
+BiquadPlanner::Engine
+BiquadPlanner::plan(size_t numChannels, size_t blockSize)
+{
+  Engine engine;
+  if (lookup(numChannels, blockSize, engine)) return engine;
+
+  // With only one candidate there is nothing to choose, so leave its cost for `predict` to measure if asked.
+  auto engines = candidates();
+  engine = engines.front();
+  double best = 0.0;
+  if (engines.size() > 1) {
+    auto bucket = blockSizeBucket(blockSize);
+    best = measure(engine, numChannels, bucket);
+    for (auto candidate : engines) {
+      if (candidate == engines.front()) continue;
+      double cost = measure(candidate, numChannels, bucket);
+      if (cost < best) {
+        best = cost;
+        engine = candidate;
+      }
+    }
+  }
+
+  remember(numChannels, blockSize, engine, best);
+  saveIfConfigured();
+  return engine;
+}
+
+double
+BiquadPlanner::predict(size_t numChannels, size_t blockSize)
+{
+  auto engine = plan(numChannels, blockSize);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = wisdom_.find(makeKey(numChannels, blockSize));
+    if (found != wisdom_.end() && found->second.nanosecondsPerSample > 0.0) return found->second.nanosecondsPerSample;
+  }
+
+  auto cost = measure(engine, numChannels, blockSizeBucket(blockSize));
+  remember(numChannels, blockSize, engine, cost);
+  saveIfConfigured();
+  return cost;
+}
+
+double
+BiquadPlanner::predict(Engine engine, size_t numChannels, size_t blockSize)
+{
+  Engine planned;
+  if (lookup(numChannels, blockSize, planned) && planned == engine) return predict(numChannels, blockSize);
+
+  auto bucket = blockSizeBucket(blockSize);
+  CostKey key(engine, numChannels, bucket);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = costs_.find(key);
+    if (found != costs_.end()) return found->second;
+  }
+
+  auto cost = measure(engine, numChannels, bucket);
+  std::lock_guard<std::mutex> lock(mutex_);
+  costs_[key] = cost;
+  return cost;
+}
+
+bool
+BiquadPlanner::lookup(size_t numChannels, size_t blockSize, Engine& engine) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = wisdom_.find(makeKey(numChannels, blockSize));
+  if (found == wisdom_.end()) return false;
+  engine = found->second.engine;
+  return true;
+}
+
+void
+BiquadPlanner::remember(size_t numChannels, size_t blockSize, Engine engine, double nanosecondsPerSample)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  wisdom_[makeKey(numChannels, blockSize)] = Wisdom{engine, nanosecondsPerSample};
+}
+
+bool
+BiquadPlanner::load(std::string const& path)
+{
+  std::ifstream file(path);
+  if (!file) return false;
+
+  std::string line;
+  if (!std::getline(file, line) || (line != wisdomHeader && line != previousWisdomHeader)) return false;
+
+  // Version 1 files have no cost column, which leaves the costs to be measured when asked for. The file lives in a
+  // caches directory that anything may write to, so lines that do not parse are skipped rather than trusted.
+  std::map<Key, Wisdom> entries;
+  auto engines = candidates();
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string cpu, channels, block, name, cost;
+    if (!std::getline(fields, cpu, '\t') || !std::getline(fields, channels, '\t') ||
+        !std::getline(fields, block, '\t') || !std::getline(fields, name, '\t')) {
+      continue;
+    }
+
+    std::getline(fields, cost);
+
+    // Ignore engines that this build does not support (e.g. wisdom written by a build with Accelerate)
+    auto found = std::find_if(engines.begin(), engines.end(), [&](Engine engine) { return name == engineName(engine); });
+    if (found == engines.end()) continue;
+
+    size_t numChannels, blockSize;
+    double nanosecondsPerSample = 0.0;
+    if (!parseCount(channels, numChannels) || !parseCount(block, blockSize) ||
+        (!cost.empty() && !parseCost(cost, nanosecondsPerSample))) {
+      continue;
+    }
+
+    entries[Key(cpu, numChannels, blockSize)] = Wisdom{*found, nanosecondsPerSample};
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto const& entry : entries) wisdom_[entry.first] = entry.second;
+  return true;
+}
+
+bool
+BiquadPlanner::save(std::string const& path) const
+{
+  std::ostringstream contents;
+  contents << wisdomHeader << '\n';
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto const& entry : wisdom_) {
+      contents << std::get<0>(entry.first) << '\t' << std::get<1>(entry.first) << '\t' << std::get<2>(entry.first)
+      << '\t' << engineName(entry.second.engine) << '\t' << entry.second.nanosecondsPerSample << '\n';
+    }
+  }
+
+  // Write to a temporary file and rename so that a concurrent reader never sees a partial file.
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    if (!file) return false;
+    file << contents.str();
+    if (!file) return false;
+  }
+
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void
+BiquadPlanner::saveIfConfigured() const
+{
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    path = path_;
+  }
+
+  if (!path.empty()) save(path);
+}
+
+BiquadPlanner::Profile
+BiquadPlanner::profile(Engine engine, size_t numChannels, size_t blockSize, bool withCounters)
+{
+  BiquadFilter filter;
+  filter.calculateParams(1000.0, 6.0, 2.0 / 48000.0, numChannels);
+  filter.setEngine(engine);
+
+  // Fill the inputs with white noise from a small LCG so that the numbers do not depend on libc's generator.
+  std::vector<std::vector<float>> inputs(numChannels, std::vector<float>(blockSize));
+  std::vector<std::vector<float>> outputs(numChannels, std::vector<float>(blockSize));
+  uint32_t seed = 12345;
+  for (auto& input : inputs) {
+    for (auto& sample : input) {
+      seed = seed * 1664525 + 1013904223;
+      sample = float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f;
+    }
+  }
+
+  std::vector<float const*> ins;
+  std::vector<float*> outs;
+  for (size_t channel = 0; channel < numChannels; ++channel) {
+    ins.push_back(inputs[channel].data());
+    outs.push_back(outputs[channel].data());
+  }
+
+  // Process roughly 16K frames per round and keep the best of several rounds to filter out scheduling noise.
+  size_t repetitions = std::max<size_t>(1, 16384 / std::max<size_t>(blockSize, 1));
+  double samples = double(repetitions * blockSize * numChannels);
+  filter.apply(ins, outs, blockSize);
+
+  std::unique_ptr<PerfCounters> counters;
+  if (withCounters) counters.reset(new PerfCounters());
+
+  Profile best;
+  best.nanosecondsPerSample = HUGE_VAL;
+  for (int round = 0; round < 5; ++round) {
+    if (counters) counters->start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t count = 0; count < repetitions; ++count) filter.apply(ins, outs, blockSize);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    PerfCounters::Values values;
+    if (counters) values = counters->stop();
+
+    if (elapsed.count() / samples < best.nanosecondsPerSample) {
+      best.nanosecondsPerSample = elapsed.count() / samples;
+      best.perSample = values.per(samples);
+    }
+  }
+
+  return best;
+}
+
+void
+BiquadPlanner::writeProfiles(std::ostream& os, std::vector<size_t> const& channelCounts,
+                             std::vector<size_t> const& blockSizes)
+{
+  os << "engine\tchannels\tblock\tns/sample";
+  for (int event = 0; event < PerfCounters::eventCount; ++event) {
+    os << '\t' << PerfCounters::name(PerfCounters::Event(event)) << "/sample";
+  }
+  os << "\tIPC\n";
+
+  // The deterministic engine is never chosen by the planner, but profile it to show what its guarantees cost.
+  auto engines = candidates();
+  engines.push_back(Engine::deterministic);
+  for (auto engine : engines) {
+    for (auto numChannels : channelCounts) {
+      for (auto blockSize : blockSizes) {
+        auto result = profile(engine, numChannels, blockSize);
+        os << engineName(engine) << '\t' << numChannels << '\t' << blockSize << '\t' << result.nanosecondsPerSample;
+        for (int event = 0; event < PerfCounters::eventCount; ++event) {
+          os << '\t';
+          if (result.perSample.valid[event]) os << result.perSample.counts[event]; else os << '-';
+        }
+        os << '\t';
+        if (result.perSample.ipc() > 0.0) os << result.perSample.ipc(); else os << '-';
+        os << '\n';
+      }
+    }
+  }
+}
+
+size_t
+BiquadPlanner::blockSizeBucket(size_t blockSize)
+{
+  size_t bucket = 1;
+  while (bucket < blockSize) bucket <<= 1;
+  return bucket;
+}
+
+std::string
+BiquadPlanner::cpuIdentifier()
+{
+  std::string name;
+#if defined(__APPLE__)
+  char buffer[256];
+  size_t size = sizeof(buffer);
+  if (sysctlbyname("machdep.cpu.brand_string", buffer, &size, nullptr, 0) == 0) name.assign(buffer, strnlen(buffer, size));
+#elif defined(__linux__)
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      auto colon = line.find(':');
+      if (colon != std::string::npos) name = line.substr(line.find_first_not_of(' ', colon + 1));
+      break;
+    }
+  }
+#endif
+
+  // Tabs and newlines separate fields in the wisdom file
+  std::replace_if(name.begin(), name.end(), [](char c) { return c == '\t' || c == '\n'; }, ' ');
+  return name.empty() ? "unknown" : name;
+}
+
+char const*
+BiquadPlanner::engineName(Engine engine)
+{
+  switch (engine) {
+    case Engine::accelerate: return "accelerate";
+    case Engine::portable: return "portable";
+    case Engine::deterministic: return "deterministic";
+    case Engine::coupled: return "coupled";
+  }
+  return "unknown";
+}
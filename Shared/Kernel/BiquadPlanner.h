@@ -0,0 +1,196 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "BiquadFilter.h"
+#include "PerfCounters.hpp"
+
+/**
+ Chooses the fastest BiquadFilter engine for a given channel count and block size on the running CPU, in the manner of
+ FFTW's planner. The first time a configuration is seen, each candidate engine is micro-benchmarked on synthetic audio
+ and the winner is remembered along with its cost. Results ("wisdom") can be persisted to a small text file so that
+ later instances -- or later launches -- pick the right engine without measuring anything.
+
+ The recorded costs double as a cost model: `predict` tells a host what a configuration will cost per sample on this
+ machine before anything renders, so that it can spread instances over cores without waiting for overloads.
+
+ Planning allocates and takes time, so it must only be done outside of the render thread (e.g. in `startProcessing`).
+ */
+class BiquadPlanner {
+public:
+  using Engine = BiquadFilter::Engine;
+
+  /**
+   Results of timing one engine configuration.
+   */
+  struct Profile {
+    /// Best observed time per sample in nanoseconds
+    double nanosecondsPerSample = 0.0;
+    /// Hardware counter values per sample from the same round as the best time (not valid if counters are unavailable)
+    PerfCounters::Values perSample;
+  };
+
+  /**
+   Obtain the planner that is shared by all filters in the process.
+   */
+  static BiquadPlanner& shared();
+
+  /**
+   Construct new instance.
+
+   @param cpu the identifier of the CPU that wisdom is recorded for
+   */
+  explicit BiquadPlanner(std::string cpu = cpuIdentifier()) : cpu_{std::move(cpu)} {}
+
+  /**
+   Set the location of the wisdom file. Any wisdom in the file is loaded, and new wisdom will be written to it.
+
+   @param path the location of the file
+   */
+  void setWisdomPath(std::string const& path);
+
+  /**
+   Obtain the fastest engine for the given configuration, measuring the candidates if there is no wisdom for it yet.
+
+   @param numChannels the number of channels that will be processed
+   @param blockSize the maximum number of frames in a render call
+   @returns the engine to use
+   */
+  Engine plan(size_t numChannels, size_t blockSize);
+
+  /**
+   Predict the cost of filtering with the engine that `plan` picks for the given configuration. Uses the cost recorded
+   in wisdom when there is one and otherwise measures it (and records it), so the first prediction for a configuration
+   may take a few milliseconds.
+
+   @param numChannels the number of channels that will be processed
+   @param blockSize the maximum number of frames in a render call
+   @returns the expected time per sample of each channel in nanoseconds
+   */
+  double predict(size_t numChannels, size_t blockSize);
+
+  /**
+   Predict the cost of filtering with a given engine, such as the deterministic one that `plan` never picks. Costs of
+   engines other than the planned one are measured once and kept in memory only, since wisdom holds one engine per
+   configuration.
+
+   @param engine the engine that will do the filtering
+   @param numChannels the number of channels that will be processed
+   @param blockSize the maximum number of frames in a render call
+   @returns the expected time per sample of each channel in nanoseconds
+   */
+  double predict(Engine engine, size_t numChannels, size_t blockSize);
+
+  /**
+   Look for existing wisdom for the given configuration.
+
+   @param numChannels the number of channels that will be processed
+   @param blockSize the maximum number of frames in a render call
+   @param engine set to the engine to use if found
+   @returns true if found
+   */
+  bool lookup(size_t numChannels, size_t blockSize, Engine& engine) const;
+
+  /**
+   Record the engine to use for a configuration.
+
+   @param numChannels the number of channels that will be processed
+   @param blockSize the maximum number of frames in a render call
+   @param engine the engine to use
+   @param nanosecondsPerSample the measured cost of the engine (0 if not known)
+   */
+  void remember(size_t numChannels, size_t blockSize, Engine engine, double nanosecondsPerSample = 0.0);
+
+  /**
+   Merge wisdom from a file into this planner. Wisdom for other CPUs is kept so that writing it back out does not lose
+   it.
+
+   @param path the location of the file to read
+   @returns true if the file was read
+   */
+  bool load(std::string const& path);
+
+  /**
+   Write all wisdom to a file.
+
+   @param path the location of the file to write
+   @returns true if the file was written
+   */
+  bool save(std::string const& path) const;
+
+  /**
+   Time an engine on synthetic audio.
+
+   @param engine the engine to time
+   @param numChannels the number of channels to process
+   @param blockSize the number of frames per render call
+   @returns the best observed time per sample in nanoseconds
+   */
+  static double measure(Engine engine, size_t numChannels, size_t blockSize) {
+    return profile(engine, numChannels, blockSize, false).nanosecondsPerSample;
+  }
+
+  /**
+   Time an engine on synthetic audio, optionally collecting hardware performance counters as well.
+
+   @param engine the engine to time
+   @param numChannels the number of channels to process
+   @param blockSize the number of frames per render call
+   @param withCounters if true, collect `PerfCounters` values
+   @returns the results for the best round
+   */
+  static Profile profile(Engine engine, size_t numChannels, size_t blockSize, bool withCounters = true);
+
+  /**
+   Profile every engine for every combination of channel count and block size, and write the results as a table with
+   one row per configuration. Counters that are unavailable are shown as "-".
+
+   @param os the stream to write to
+   @param channelCounts the channel counts to profile
+   @param blockSizes the block sizes to profile
+   */
+  static void writeProfiles(std::ostream& os, std::vector<size_t> const& channelCounts,
+                            std::vector<size_t> const& blockSizes);
+
+  /**
+   Obtain the block size that wisdom is recorded under. Sizes are rounded up to the next power of 2.
+
+   @param blockSize the maximum number of frames in a render call
+   @returns the rounded size
+   */
+  static size_t blockSizeBucket(size_t blockSize);
+
+  /// @returns an identifier for the CPU model of the running machine
+  static std::string cpuIdentifier();
+
+  /// @returns the name used for an engine in wisdom files
+  static char const* engineName(Engine engine);
+
+private:
+  using Key = std::tuple<std::string, size_t, size_t>;
+  using CostKey = std::tuple<Engine, size_t, size_t>;
+
+  struct Wisdom {
+    Engine engine;
+    double nanosecondsPerSample;
+  };
+
+  Key makeKey(size_t numChannels, size_t blockSize) const {
+    return Key(cpu_, numChannels, blockSizeBucket(blockSize));
+  }
+
+  void saveIfConfigured() const;
+
+  mutable std::mutex mutex_;
+  std::string const cpu_;
+  std::string path_;
+  std::map<Key, Wisdom> wisdom_;
+  std::map<CostKey, double> costs_;
+};
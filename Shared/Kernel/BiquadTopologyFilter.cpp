@@ -0,0 +1,308 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "BiquadTopologyFilter.h"
+#include "SIMDMath.hpp"
+
+using namespace SIMDMath;
+using Topology = BiquadTopologyFilter::Topology;
+
+namespace {
+
+constexpr size_t laneCount = 4;
+constexpr size_t stateCount = 4;
+constexpr size_t multiplierCount = 7;
+
+/**
+ One sample step of each structure for 4 channels at once. `m` holds the multipliers set up by `updateMultipliers`
+ and `s` the state vectors.
+ */
+template <Topology T> struct Step;
+
+template <> struct Step<Topology::directForm1> {
+  static Float4 run(Float4 const* m, Float4* s, Float4 x) {
+    Float4 y = m[0] * x + m[1] * s[0] + m[2] * s[1] - m[3] * s[2] - m[4] * s[3];
+    s[1] = s[0];
+    s[0] = x;
+    s[3] = s[2];
+    s[2] = y;
+    return y;
+  }
+};
+
+template <> struct Step<Topology::transposedDirectForm2> {
+  static Float4 run(Float4 const* m, Float4* s, Float4 x) {
+    Float4 y = m[0] * x + s[0];
+    s[0] = m[1] * x - m[3] * y + s[1];
+    s[1] = m[2] * x - m[4] * y;
+    return y;
+  }
+};
+
+/// Multipliers: b0, sigma, omega, gu, gv. State: u[n-1], v[n-1]
+template <> struct Step<Topology::coupledForm> {
+  static Float4 run(Float4 const* m, Float4* s, Float4 x) {
+    Float4 y = m[0] * x + m[3] * s[0] + m[4] * s[1];
+    Float4 u = m[1] * s[0] - m[2] * s[1] + x;
+    s[1] = m[2] * s[0] + m[1] * s[1];
+    s[0] = u;
+    return y;
+  }
+};
+
+/// Multipliers: k1, c1, k2, c2, and the ladder taps for g0, g1 and g2. State: g0[n-1], g1[n-1]
+template <> struct Step<Topology::normalizedLattice> {
+  static Float4 run(Float4 const* m, Float4* s, Float4 x) {
+    Float4 f1 = m[3] * x - m[2] * s[1];
+    Float4 g2 = m[2] * x + m[3] * s[1];
+    Float4 f0 = m[1] * f1 - m[0] * s[0];
+    Float4 g1 = m[0] * f1 + m[1] * s[0];
+    s[0] = f0;
+    s[1] = g1;
+    return m[4] * f0 + m[5] * g1 + m[6] * g2;
+  }
+};
+
+/**
+ Run a structure over a block for up to 4 channels.
+
+ @param multipliers the multipliers of the structure
+ @param state the state vectors of the channel group
+ @param ins pointers to the first sample of each channel in the group
+ @param outs pointers to where to store the first result of each channel in the group
+ @param numChannels the number of channels in the group (1-4)
+ @param stride the distance between consecutive samples
+ @param frameCount the number of samples to process
+ */
+template <Topology T>
+void run(float const* multipliers, float* state, float const* const* ins, float* const* outs, size_t numChannels,
+         long stride, size_t frameCount)
+{
+  Float4 m[multiplierCount];
+  for (size_t index = 0; index < multiplierCount; ++index) m[index] = splat<Float4>(multipliers[index]);
+  Float4 s[stateCount];
+  for (size_t index = 0; index < stateCount; ++index) s[index] = load<Float4>(state + index * laneCount);
+
+  Float4 x = {};
+  for (size_t frame = 0; frame < frameCount; ++frame) {
+    long offset = long(frame) * stride;
+    for (size_t lane = 0; lane < numChannels; ++lane) x[lane] = ins[lane][offset];
+    Float4 y = Step<T>::run(m, s, x);
+    for (size_t lane = 0; lane < numChannels; ++lane) outs[lane][offset] = y[lane];
+  }
+
+  for (size_t index = 0; index < stateCount; ++index) store(state + index * laneCount, s[index]);
+}
+
+} // end namespace
+
+void
+BiquadTopologyFilter::setTopology(Topology topology)
+{
+  topology_ = topology;
+  updateMultipliers();
+  resetState();
+}
+
+void
+BiquadTopologyFilter::calculateParams(float frequency, float resonance, double nyquistPeriod, size_t numChannels)
+{
+  if (lastFrequency_ == frequency && lastResonance_ == resonance && lastNyquistPeriod_ == nyquistPeriod &&
+      numChannels == numChannels_) return;
+
+  const double frequencyRads = M_PI * frequency * nyquistPeriod;
+  const double r = std::pow(10.0, 0.05 * -resonance);
+  const double k  = 0.5 * r * std::sin(frequencyRads);
+  const double c1 = (1.0 - k) / (1.0 + k);
+  const double c2 = (1.0 + c1) * std::cos(frequencyRads);
+  const double c3 = (1.0 + c1 - c2) * 0.25;
+  setCoefficients(c3, c3 + c3, c3, -c2, c1, numChannels);
+
+  lastFrequency_ = frequency;
+  lastResonance_ = resonance;
+  lastNyquistPeriod_ = nyquistPeriod;
+}
+
+void
+BiquadTopologyFilter::setCoefficients(double b0, double b1, double b2, double a1, double a2, size_t numChannels)
+{
+  b0_ = b0;
+  b1_ = b1;
+  b2_ = b2;
+  a1_ = a1;
+  a2_ = a2;
+
+  // The state of one structure means nothing to another, so start over if the running structure changes.
+  auto previous = active_;
+  updateMultipliers();
+  if (numChannels != numChannels_) {
+    numChannels_ = numChannels;
+    states_.assign((numChannels + laneCount - 1) / laneCount * stateCount * laneCount, 0.0f);
+  }
+  else if (active_ != previous) {
+    resetState();
+  }
+}
+
+void
+BiquadTopologyFilter::updateMultipliers()
+{
+  std::fill(std::begin(multipliers_), std::end(multipliers_), 0.0f);
+
+  // The pole pair is r e^(+/- j theta) with sigma = r cos(theta) and omega = r sin(theta). Without complex poles
+  // there is no rotation for the coupled form to do.
+  double sigma = -0.5 * a1_;
+  double omega2 = a2_ - sigma * sigma;
+
+  // Reflection coefficients of A(z) = 1 + a1 z^-1 + a2 z^-2. Unstable filters have no normalized lattice.
+  double k2 = a2_;
+  double k1 = a1_ / (1.0 + a2_);
+
+  active_ = topology_;
+  if ((topology_ == Topology::coupledForm && !(omega2 > 0.0)) ||
+      (topology_ == Topology::normalizedLattice && !(std::abs(k1) < 1.0 && std::abs(k2) < 1.0))) {
+    active_ = Topology::transposedDirectForm2;
+  }
+
+  switch (active_) {
+    case Topology::directForm1:
+    case Topology::transposedDirectForm2:
+      multipliers_[0] = b0_;
+      multipliers_[1] = b1_;
+      multipliers_[2] = b2_;
+      multipliers_[3] = a1_;
+      multipliers_[4] = a2_;
+      break;
+
+    case Topology::coupledForm: {
+      // y[n] = b0 x[n] + gu u[n-1] + gv v[n-1] where U/X = (1 - sigma z^-1) / A(z) and V/X = omega z^-1 / A(z).
+      // Matching the numerator gives the two taps.
+      double omega = std::sqrt(omega2);
+      double gu = b1_ - b0_ * a1_;
+      double gv = (b2_ - b0_ * a2_ + sigma * gu) / omega;
+      multipliers_[0] = b0_;
+      multipliers_[1] = sigma;
+      multipliers_[2] = omega;
+      multipliers_[3] = gu;
+      multipliers_[4] = gv;
+      break;
+    }
+
+    case Topology::normalizedLattice: {
+      // Ladder taps that rebuild the numerator from the backward signals B0 = 1, B1 = k1 + z^-1 and
+      // B2 = a2 + a1 z^-1 + z^-2. Normalizing scales g0 by c1 c2 and g1 by c2, so their taps are divided by the same.
+      double c1 = std::sqrt(1.0 - k1 * k1);
+      double c2 = std::sqrt(1.0 - k2 * k2);
+      double v2 = b2_;
+      double v1 = b1_ - v2 * a1_;
+      double v0 = b0_ - v1 * k1 - v2 * a2_;
+      multipliers_[0] = k1;
+      multipliers_[1] = c1;
+      multipliers_[2] = k2;
+      multipliers_[3] = c2;
+      multipliers_[4] = v0 / (c1 * c2);
+      multipliers_[5] = v1 / c2;
+      multipliers_[6] = v2;
+      break;
+    }
+  }
+}
+
+void
+BiquadTopologyFilter::apply(float const* const* ins, float* const* outs, long stride, size_t frameCount)
+{
+  for (size_t first = 0; first < numChannels_; first += laneCount) {
+    size_t count = std::min(laneCount, numChannels_ - first);
+    float* state = states_.data() + first * stateCount;
+    switch (active_) {
+      case Topology::directForm1:
+        run<Topology::directForm1>(multipliers_, state, ins + first, outs + first, count, stride, frameCount);
+        break;
+      case Topology::transposedDirectForm2:
+        run<Topology::transposedDirectForm2>(multipliers_, state, ins + first, outs + first, count, stride, frameCount);
+        break;
+      case Topology::coupledForm:
+        run<Topology::coupledForm>(multipliers_, state, ins + first, outs + first, count, stride, frameCount);
+        break;
+      case Topology::normalizedLattice:
+        run<Topology::normalizedLattice>(multipliers_, state, ins + first, outs + first, count, stride, frameCount);
+        break;
+    }
+  }
+}
+
+void
+BiquadTopologyFilter::resetState()
+{
+  std::fill(states_.begin(), states_.end(), 0.0f);
+}
+
+void
+BiquadTopologyFilter::loadDirectFormState(size_t channel, float x1, float x2, float y1, float y2)
+{
+  assert(channel < numChannels_);
+  float* state = states_.data() + (channel / laneCount) * stateCount * laneCount + channel % laneCount;
+  if (active_ == Topology::directForm1) {
+    state[0 * laneCount] = x1;
+    state[1 * laneCount] = x2;
+    state[2 * laneCount] = y1;
+    state[3 * laneCount] = y2;
+    return;
+  }
+
+  // With no more input, the history produces the outputs z0 and z1 below. Find the two state values that produce the
+  // same pair: run the structure on silence from each unit state (one per lane) to get the outputs that each state
+  // value contributes, and solve. Two outputs pin down the state of a second-order section, so all later ones match.
+  double z0 = b1_ * x1 + b2_ * x2 - a1_ * y1 - a2_ * y2;
+  double z1 = -a1_ * z0 + b2_ * x1 - a2_ * y1;
+
+  Float4 m[multiplierCount];
+  for (size_t index = 0; index < multiplierCount; ++index) m[index] = splat<Float4>(multipliers_[index]);
+  Float4 s[stateCount] = {};
+  s[0][0] = 1.0f;
+  s[1][1] = 1.0f;
+  Float4 zero = {};
+  Float4 r0, r1;
+  switch (active_) {
+    case Topology::transposedDirectForm2:
+      r0 = Step<Topology::transposedDirectForm2>::run(m, s, zero);
+      r1 = Step<Topology::transposedDirectForm2>::run(m, s, zero);
+      break;
+    case Topology::coupledForm:
+      r0 = Step<Topology::coupledForm>::run(m, s, zero);
+      r1 = Step<Topology::coupledForm>::run(m, s, zero);
+      break;
+    default:
+      r0 = Step<Topology::normalizedLattice>::run(m, s, zero);
+      r1 = Step<Topology::normalizedLattice>::run(m, s, zero);
+      break;
+  }
+
+  // The section has no state that the output can see if the determinant is 0 (e.g. b1 = b2 = 0), so silence will do.
+  double determinant = double(r0[0]) * r1[1] - double(r0[1]) * r1[0];
+  double first = 0.0, second = 0.0;
+  if (std::abs(determinant) > 1e-30) {
+    first = (z0 * r1[1] - z1 * r0[1]) / determinant;
+    second = (z1 * r0[0] - z0 * r1[0]) / determinant;
+  }
+
+  state[0 * laneCount] = float(first);
+  state[1 * laneCount] = float(second);
+  state[2 * laneCount] = 0.0f;
+  state[3 * laneCount] = 0.0f;
+}
+
+char const*
+BiquadTopologyFilter::topologyName(Topology topology)
+{
+  switch (topology) {
+    case Topology::directForm1: return "direct form I";
+    case Topology::transposedDirectForm2: return "transposed direct form II";
+    case Topology::coupledForm: return "coupled form";
+    case Topology::normalizedLattice: return "normalized lattice";
+  }
+  return "unknown";
+}
@@ -0,0 +1,174 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <thread>
+
+#include "BufferPool.h"
+
+BufferPool&
+BufferPool::shared()
+{
+  static BufferPool pool(std::max<size_t>(4, std::thread::hardware_concurrency()), 8192, 65536);
+  return pool;
+}
+
+BufferPool::BufferPool(size_t reserveCount, size_t reserveSize, size_t retainLimit)
+: retainLimit_{retainLimit}, reserveSize_{reserveSize}, reserveCount_{reserveCount},
+  reserve_{new ReserveBlock[reserveCount]}
+{
+  for (size_t index = 0; index < reserveCount; ++index) {
+    reserve_[index].samples.store(new float[reserveSize](), std::memory_order_relaxed);
+    reserve_[index].size.store(reserveSize, std::memory_order_relaxed);
+  }
+}
+
+BufferPool::~BufferPool()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : free_) delete [] entry.second;
+  for (auto& entry : used_) delete [] entry.first;
+  for (size_t index = 0; index < reserveCount_; ++index) delete [] reserve_[index].samples.load();
+}
+
+float*
+BufferPool::acquire(size_t size)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // The smallest released block that is big enough
+  auto found = free_.lower_bound(size);
+  float* block = nullptr;
+  size_t capacity = size;
+  if (found != free_.end()) {
+    capacity = found->first;
+    block = found->second;
+    retained_ -= capacity;
+    free_.erase(found);
+  }
+  else {
+    block = new float[capacity];
+  }
+
+  used_.emplace(block, capacity);
+  inUse_ += capacity;
+  return block;
+}
+
+void
+BufferPool::release(float* block)
+{
+  if (block == nullptr) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = used_.find(block);
+  assert(found != used_.end());
+  size_t capacity = found->second;
+  used_.erase(found);
+  inUse_ -= capacity;
+  free_.emplace(capacity, block);
+  retained_ += capacity;
+  trim();
+}
+
+float*
+BufferPool::acquireReserve(size_t size)
+{
+  for (size_t index = 0; index < reserveCount_; ++index) {
+    auto& entry = reserve_[index];
+    bool expected = false;
+    if (entry.size.load(std::memory_order_relaxed) < size || entry.taken.load(std::memory_order_relaxed) ||
+        !entry.taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      continue;
+    }
+
+    // The block may have been swapped for a larger one since its size was checked, but never for a smaller one.
+    return entry.samples.load(std::memory_order_relaxed);
+  }
+  return nullptr;
+}
+
+void
+BufferPool::releaseReserve(float* block)
+{
+  for (size_t index = 0; index < reserveCount_; ++index) {
+    if (reserve_[index].samples.load(std::memory_order_relaxed) == block) {
+      reserve_[index].taken.store(false, std::memory_order_release);
+      return;
+    }
+  }
+  assert(false);
+}
+
+void
+BufferPool::reserveFor(size_t size)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  reserveSize_ = std::max(reserveSize_, size);
+  for (size_t index = 0; index < reserveCount_; ++index) {
+    auto& entry = reserve_[index];
+    bool expected = false;
+    if (entry.size.load(std::memory_order_relaxed) >= reserveSize_ ||
+        !entry.taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      continue;
+    }
+
+    float* previous = entry.samples.exchange(new float[reserveSize_](), std::memory_order_relaxed);
+    entry.size.store(reserveSize_, std::memory_order_relaxed);
+    entry.taken.store(false, std::memory_order_release);
+    delete [] previous;
+  }
+}
+
+void
+BufferPool::setRetainLimit(size_t size)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  retainLimit_ = size;
+  trim();
+}
+
+bool
+BufferPool::isReserve(float const* block) const
+{
+  for (size_t index = 0; index < reserveCount_; ++index) {
+    if (reserve_[index].samples.load(std::memory_order_relaxed) == block) return true;
+  }
+  return false;
+}
+
+size_t
+BufferPool::inUse() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return inUse_;
+}
+
+size_t
+BufferPool::retained() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return retained_;
+}
+
+size_t
+BufferPool::reserveAvailable() const
+{
+  size_t count = 0;
+  for (size_t index = 0; index < reserveCount_; ++index) {
+    if (!reserve_[index].taken.load(std::memory_order_relaxed)) ++count;
+  }
+  return count;
+}
+
+void
+BufferPool::trim()
+{
+  // Free the largest blocks first since they do the most for resident memory.
+  while (retained_ > retainLimit_ && !free_.empty()) {
+    auto largest = std::prev(free_.end());
+    retained_ -= largest->first;
+    delete [] largest->second;
+    free_.erase(largest);
+  }
+}
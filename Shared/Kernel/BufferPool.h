@@ -0,0 +1,122 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "NonCopyable.hpp"
+
+/**
+ Process-wide store of sample buffers shared by all kernels, so that an idle kernel can give its buffers back and a
+ waking one can take them again without a trip to the system allocator.
+
+ Ordinary blocks are handed out by `acquire` and taken back by `release`. Both lock and may allocate or free, so they
+ must not be used on the render thread. Released blocks are kept for reuse up to `retainLimit` samples in total, and
+ anything beyond that is freed so that resident memory actually goes down.
+
+ The pool also holds an emergency reserve of preallocated blocks for a render thread that finds itself without storage
+ because audio came back before a background thread could hand over a block. `acquireReserve` and `releaseReserve` are
+ lock-free and never allocate. The reserve blocks grow with `reserveFor` so that they fit every configured buffer.
+ */
+class BufferPool : NonCopyable {
+public:
+
+  /**
+   Obtain the pool that is shared by all kernels in the process. Its reserve holds a block for each CPU that can run a
+   render thread (at least 4), each of 8192 samples (e.g. stereo at 4096 frames) until grown by `reserveFor`.
+   */
+  static BufferPool& shared();
+
+  /**
+   Construct new instance.
+
+   @param reserveCount the number of blocks in the emergency reserve
+   @param reserveSize the number of samples in each reserve block
+   @param retainLimit the number of released samples to keep for reuse
+   */
+  BufferPool(size_t reserveCount, size_t reserveSize, size_t retainLimit);
+
+  ~BufferPool();
+
+  /**
+   Obtain a block of at least `size` samples, reusing a released one if possible. Not for the render thread.
+
+   @param size the number of samples needed
+   @returns the block
+   */
+  float* acquire(size_t size);
+
+  /**
+   Give back a block obtained from `acquire`. Not for the render thread.
+
+   @param block the block to give back (may be null)
+   */
+  void release(float* block);
+
+  /**
+   Take a block from the emergency reserve. Lock-free, so safe on the render thread.
+
+   @param size the number of samples needed
+   @returns the block, or null if the reserve blocks are too small or all taken
+   */
+  float* acquireReserve(size_t size);
+
+  /**
+   Give back a block obtained from `acquireReserve`. Lock-free, so safe on the render thread.
+
+   @param block the block to give back
+   */
+  void releaseReserve(float* block);
+
+  /**
+   Grow the reserve blocks so that each holds at least `size` samples. Blocks that are taken at the time keep their size
+   until the next call. Allocates, so not for the render thread.
+
+   @param size the number of samples a reserve block must hold
+   */
+  void reserveFor(size_t size);
+
+  /**
+   Change the number of released samples kept for reuse, freeing any excess.
+
+   @param size the number of samples to keep
+   */
+  void setRetainLimit(size_t size);
+
+  /// @returns true if the block came from the emergency reserve
+  bool isReserve(float const* block) const;
+
+  /// @returns the number of samples in blocks handed out by `acquire` and not yet released
+  size_t inUse() const;
+
+  /// @returns the number of samples in released blocks kept for reuse
+  size_t retained() const;
+
+  /// @returns the number of reserve blocks that are not taken
+  size_t reserveAvailable() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::map<float*, size_t> used_;
+  std::multimap<size_t, float*> free_;
+  size_t inUse_ = 0;
+  size_t retained_ = 0;
+  size_t retainLimit_;
+
+  /// A block of the reserve. Its size and storage are only changed by whoever has set `taken`.
+  struct ReserveBlock {
+    std::atomic<float*> samples{nullptr};
+    std::atomic<size_t> size{0};
+    std::atomic<bool> taken{false};
+  };
+
+  size_t reserveSize_;
+  size_t reserveCount_;
+  std::unique_ptr<ReserveBlock[]> reserve_;
+
+  void trim();
+};
@@ -0,0 +1,224 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "HostScenario.h"
+
+void
+HostScenario::Costs::record(uint64_t nanoseconds, Render const& render)
+{
+  nanoseconds_.push_back(nanoseconds);
+  frames_.push_back(render.frameCount);
+  events_ += render.eventCount;
+}
+
+HostScenario::Report
+HostScenario::Costs::report(std::string const& name) const
+{
+  Report report;
+  report.name = name;
+  report.renders = nanoseconds_.size();
+  report.events = events_;
+  if (nanoseconds_.empty()) return report;
+
+  uint64_t total = 0;
+  for (size_t index = 0; index < nanoseconds_.size(); ++index) {
+    total += nanoseconds_[index];
+    report.frames += frames_[index];
+    if (frames_[index] > 0) {
+      report.worstNanosecondsPerFrame = std::max(report.worstNanosecondsPerFrame,
+                                                 double(nanoseconds_[index]) / frames_[index]);
+    }
+  }
+
+  auto sorted = nanoseconds_;
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted](double fraction) {
+    return sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))] / 1000.0;
+  };
+
+  report.p50Microseconds = percentile(0.50);
+  report.p90Microseconds = percentile(0.90);
+  report.p99Microseconds = percentile(0.99);
+  report.worstMicroseconds = sorted.back() / 1000.0;
+  report.meanNanosecondsPerFrame = report.frames > 0 ? double(total) / report.frames : 0.0;
+  return report;
+}
+
+std::vector<HostScenario::Options>
+HostScenario::standard()
+{
+  std::vector<Options> scenarios;
+
+  Options steady;
+  steady.name = "steady";
+  scenarios.push_back(steady);
+
+  Options odd;
+  odd.name = "odd frame counts";
+  odd.minFrameCount = 1;
+  odd.maxFrameCount = 1157;
+  scenarios.push_back(odd);
+
+  Options jitter;
+  jitter.name = "jittered timestamps";
+  jitter.timestampJitter = 64;
+  jitter.burstProbability = 0.5;
+  jitter.maxBurstSize = 4;
+  jitter.maxLateness = 64;
+  scenarios.push_back(jitter);
+
+  Options bursts;
+  bursts.name = "parameter bursts";
+  bursts.burstProbability = 0.25;
+  bursts.maxBurstSize = 256;
+  bursts.rampFraction = 0.5;
+  scenarios.push_back(bursts);
+
+  Options midi;
+  midi.name = "MIDI flood";
+  midi.midiEventsPerRender = 256;
+  scenarios.push_back(midi);
+
+  Options formats;
+  formats.name = "format changes";
+  formats.renderCountPerFormat = 50;
+  formats.channelCounts = {1, 2, 6};
+  formats.sampleRates = {44100.0, 48000.0, 96000.0, 192000.0};
+  scenarios.push_back(formats);
+
+  Options inPlace;
+  inPlace.name = "in-place";
+  inPlace.buffers = Buffers::inPlace;
+  scenarios.push_back(inPlace);
+
+  Options everything;
+  everything.name = "everything";
+  everything.minFrameCount = 1;
+  everything.maxFrameCount = 1157;
+  everything.timestampJitter = 64;
+  everything.burstProbability = 0.25;
+  everything.maxBurstSize = 64;
+  everything.rampFraction = 0.5;
+  everything.maxLateness = 64;
+  everything.midiEventsPerRender = 16;
+  everything.renderCountPerFormat = 50;
+  everything.channelCounts = {1, 2, 6};
+  everything.sampleRates = {44100.0, 48000.0, 96000.0, 192000.0};
+  everything.buffers = Buffers::alternate;
+  scenarios.push_back(everything);
+
+  return scenarios;
+}
+
+HostScenario::HostScenario(Options options, uint32_t seed)
+: options_{std::move(options)}, generator_{seed}
+{
+  if (options_.channelCounts.empty()) options_.channelCounts.push_back(2);
+  if (options_.sampleRates.empty()) options_.sampleRates.push_back(44100.0);
+  options_.minFrameCount = std::max(options_.minFrameCount, AUAudioFrameCount(1));
+  options_.maxFrameCount = std::max(options_.maxFrameCount, options_.minFrameCount);
+}
+
+bool
+HostScenario::next(Render& render)
+{
+  if (rendered_ >= options_.renderCount) return false;
+
+  render.restart = rendered_ == 0 || (options_.renderCountPerFormat > 0 &&
+                                      rendered_ % options_.renderCountPerFormat == 0);
+  if (render.restart) {
+    if (rendered_ > 0) ++format_;
+    sampleTime_ = 0;
+  }
+
+  render.channelCount = options_.channelCounts[format_ % options_.channelCounts.size()];
+  render.sampleRate = options_.sampleRates[format_ % options_.sampleRates.size()];
+  render.frameCount = std::uniform_int_distribution<AUAudioFrameCount>(options_.minFrameCount,
+                                                                        options_.maxFrameCount)(generator_);
+
+  // Hosts loop, drop and repeat buffers, so a timestamp need not follow on from the previous render.
+  auto jitter = AUEventSampleTime(options_.timestampJitter);
+  render.sampleTime = sampleTime_;
+  if (jitter > 0) {
+    render.sampleTime = std::max(sampleTime_ + std::uniform_int_distribution<AUEventSampleTime>(-jitter, jitter)
+                                 (generator_), AUEventSampleTime(0));
+  }
+
+  switch (options_.buffers) {
+    case Buffers::separate: render.inPlace = false; break;
+    case Buffers::inPlace: render.inPlace = true; break;
+    case Buffers::alternate: render.inPlace = rendered_ % 2 == 1; break;
+  }
+
+  events_.clear();
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  if (options_.maxBurstSize > 0 && !options_.parameters.empty() && chance(generator_) < options_.burstProbability) {
+    auto size = std::uniform_int_distribution<size_t>(1, options_.maxBurstSize)(generator_);
+    std::uniform_int_distribution<AUEventSampleTime> offset(-AUEventSampleTime(options_.maxLateness),
+                                                            render.frameCount - 1);
+    std::uniform_int_distribution<size_t> which(0, options_.parameters.size() - 1);
+    for (size_t count = 0; count < size; ++count) {
+      auto const& parameter = options_.parameters[which(generator_)];
+      auto& event = addEvent(render.sampleTime + offset(generator_));
+      event.parameter.parameterAddress = parameter.address;
+      event.parameter.value = std::uniform_real_distribution<AUValue>(parameter.minValue, parameter.maxValue)
+      (generator_);
+      if (chance(generator_) < options_.rampFraction) {
+        event.parameter.eventType = AURenderEventParameterRamp;
+        event.parameter.rampDurationSampleFrames = std::uniform_int_distribution<AUAudioFrameCount>(
+          1, render.frameCount)(generator_);
+      } else {
+        event.parameter.eventType = AURenderEventParameter;
+      }
+    }
+  }
+
+  std::uniform_int_distribution<AUEventSampleTime> offset(0, render.frameCount - 1);
+  std::uniform_int_distribution<int> byte(0, 127);
+  for (size_t count = 0; count < options_.midiEventsPerRender; ++count) {
+    auto& event = addEvent(render.sampleTime + offset(generator_));
+    event.MIDI.eventType = AURenderEventMIDI;
+    event.MIDI.length = 3;
+    event.MIDI.data[0] = uint8_t(count % 2 == 0 ? 0x90 : 0x80);
+    event.MIDI.data[1] = uint8_t(byte(generator_));
+    event.MIDI.data[2] = uint8_t(byte(generator_));
+  }
+
+  // Hosts deliver events in time order
+  std::stable_sort(events_.begin(), events_.end(), [](AURenderEvent const& a, AURenderEvent const& b) {
+    return a.head.eventSampleTime < b.head.eventSampleTime;
+  });
+  for (size_t index = 0; index + 1 < events_.size(); ++index) events_[index].head.next = &events_[index + 1];
+
+  render.events = events_.empty() ? nullptr : events_.data();
+  render.eventCount = events_.size();
+
+  sampleTime_ = render.sampleTime + render.frameCount;
+  ++rendered_;
+  return true;
+}
+
+void
+HostScenario::writeReports(std::ostream& os, std::vector<Report> const& reports)
+{
+  os << "scenario\trenders\tframes\tevents\tp50 us\tp90 us\tp99 us\tworst us\tworst ns/frame\tmean ns/frame\n";
+  for (auto const& report : reports) {
+    os << report.name << '\t' << report.renders << '\t' << report.frames << '\t' << report.events << '\t'
+    << report.p50Microseconds << '\t' << report.p90Microseconds << '\t' << report.p99Microseconds << '\t'
+    << report.worstMicroseconds << '\t' << report.worstNanosecondsPerFrame << '\t' << report.meanNanosecondsPerFrame
+    << '\n';
+  }
+}
+
+AURenderEvent&
+HostScenario::addEvent(AUEventSampleTime sampleTime)
+{
+  events_.emplace_back();
+  auto& event = events_.back();
+  memset(&event, 0, sizeof(event));
+  event.head.eventSampleTime = sampleTime;
+  return event;
+}
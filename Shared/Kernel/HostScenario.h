@@ -0,0 +1,168 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <AudioToolbox/AudioToolbox.h>
+
+/**
+ Generates the render calls of a synthetic host for stress-testing and benchmarking `processAndRender`. Real hosts do
+ not render in tidy power-of-two blocks with an event or two: they send odd frame counts, timestamps that jump, bursts
+ of parameter changes (some already late), floods of MIDI, format changes between `startProcessing` calls and
+ sometimes ask for in-place rendering. A scenario describes how much of each to do, and the generator produces a
+ reproducible sequence of renders from it. See HostScenarioRunner.h for driving a kernel with one.
+ */
+class HostScenario {
+public:
+
+  /// How output buffers are given to the kernel
+  enum class Buffers { separate, inPlace, alternate };
+
+  /// A parameter to send events for and the range of values to send
+  struct Parameter {
+    AUParameterAddress address;
+    AUValue minValue;
+    AUValue maxValue;
+  };
+
+  /**
+   Description of host behaviour.
+   */
+  struct Options {
+    std::string name;
+    /// Number of render calls to make
+    size_t renderCount = 1000;
+    /// Range of frames per render (inclusive)
+    AUAudioFrameCount minFrameCount = 512;
+    AUAudioFrameCount maxFrameCount = 512;
+    /// Maximum number of samples that a render's timestamp may be off from the end of the previous one
+    AUAudioFrameCount timestampJitter = 0;
+    /// Chance that a render has a burst of parameter events, and the largest burst
+    double burstProbability = 0.0;
+    size_t maxBurstSize = 0;
+    /// Parameters to change, by default the filter's cutoff and resonance
+    std::vector<Parameter> parameters{{1, 12.0, 20000.0}, {2, -20.0, 40.0}};
+    /// Fraction of parameter events that are ramps
+    double rampFraction = 0.0;
+    /// Maximum number of samples that a parameter event may be before the start of its render
+    AUAudioFrameCount maxLateness = 0;
+    /// Number of MIDI events in every render
+    size_t midiEventsPerRender = 0;
+    /// Number of renders between format changes (0 for none), and the formats to cycle through
+    size_t renderCountPerFormat = 0;
+    std::vector<uint32_t> channelCounts{2};
+    std::vector<double> sampleRates{44100.0};
+    Buffers buffers = Buffers::separate;
+  };
+
+  /**
+   One render call to make.
+   */
+  struct Render {
+    /// If true, stop processing and start again with the channel count and sample rate below before rendering
+    bool restart;
+    uint32_t channelCount;
+    double sampleRate;
+    AUEventSampleTime sampleTime;
+    AUAudioFrameCount frameCount;
+    bool inPlace;
+    /// Events for the render in time order, valid until the next call to `next` (may be null)
+    AURenderEvent* events;
+    size_t eventCount;
+  };
+
+  /**
+   Summary of the costs of the renders of a scenario.
+   */
+  struct Report {
+    std::string name;
+    size_t renders = 0;
+    uint64_t frames = 0;
+    uint64_t events = 0;
+    double p50Microseconds = 0.0;
+    double p90Microseconds = 0.0;
+    double p99Microseconds = 0.0;
+    double worstMicroseconds = 0.0;
+    /// Largest cost per frame of any render, in nanoseconds
+    double worstNanosecondsPerFrame = 0.0;
+    /// Total time over total frames, in nanoseconds
+    double meanNanosecondsPerFrame = 0.0;
+  };
+
+  /**
+   Collects render costs for a report.
+   */
+  class Costs {
+  public:
+
+    /**
+     Record the cost of a render.
+
+     @param nanoseconds the time taken
+     @param render the render that was done
+     */
+    void record(uint64_t nanoseconds, Render const& render);
+
+    /**
+     Summarize the recorded costs.
+
+     @param name the name of the scenario
+     @returns the summary
+     */
+    Report report(std::string const& name) const;
+
+  private:
+    std::vector<uint64_t> nanoseconds_;
+    std::vector<AUAudioFrameCount> frames_;
+    uint64_t events_ = 0;
+  };
+
+  /**
+   Obtain a set of scenarios that each stress one host behaviour, plus one that does everything at once.
+
+   @returns the scenarios
+   */
+  static std::vector<Options> standard();
+
+  /**
+   Construct new instance.
+
+   @param options the host behaviour to generate
+   @param seed the seed for the random choices so that runs can be repeated
+   */
+  explicit HostScenario(Options options, uint32_t seed = 1);
+
+  /// @returns the host behaviour being generated
+  Options const& options() const { return options_; }
+
+  /**
+   Obtain the next render call. The first one always has `restart` set.
+
+   @param render set to the render to make
+   @returns false when the scenario is done
+   */
+  bool next(Render& render);
+
+  /**
+   Print reports as a tab-separated table.
+
+   @param os the stream to write to
+   @param reports the reports to print
+   */
+  static void writeReports(std::ostream& os, std::vector<Report> const& reports);
+
+private:
+
+  AURenderEvent& addEvent(AUEventSampleTime sampleTime);
+
+  Options options_;
+  std::mt19937 generator_;
+  size_t rendered_ = 0;
+  size_t format_ = 0;
+  AUEventSampleTime sampleTime_ = 0;
+  std::vector<AURenderEvent> events_;
+};
@@ -0,0 +1,81 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <chrono>
+#import <cstddef>
+#import <cstring>
+#import <vector>
+#import <AVFoundation/AVFoundation.h>
+
+#import "HostScenario.h"
+
+/**
+ Drive a kernel derived from KernelEventProcessor with the render calls of a synthetic host scenario, timing each
+ `processAndRender` call. Input is white noise supplied by the pull block, as an upstream node would.
+
+ @param kernel the kernel to render with
+ @param scenario the host behaviour to follow
+ @returns the costs of the renders
+ */
+template <typename Kernel>
+HostScenario::Report runHostScenario(Kernel& kernel, HostScenario& scenario)
+{
+  auto maxFrameCount = scenario.options().maxFrameCount;
+  std::vector<std::vector<float>> samples;
+  std::vector<char> outputStorage;
+  AudioBufferList* output = nullptr;
+  HostScenario::Costs costs;
+
+  __block uint32_t noise = 1;
+  AURenderPullInputBlock pullInput = ^AUAudioUnitStatus(AudioUnitRenderActionFlags* actionFlags,
+                                                        AudioTimeStamp const* timestamp,
+                                                        AUAudioFrameCount frameCount, NSInteger inputBusNumber,
+                                                        AudioBufferList* input) {
+    for (UInt32 channel = 0; channel < input->mNumberBuffers; ++channel) {
+      auto ptr = static_cast<float*>(input->mBuffers[channel].mData);
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        noise = noise * 1664525u + 1013904223u;
+        ptr[frame] = float(int32_t(noise)) / 2147483648.0f;
+      }
+    }
+    return noErr;
+  };
+
+  HostScenario::Render render;
+  bool started = false;
+  while (scenario.next(render)) {
+    if (render.restart) {
+      if (started) kernel.stopProcessing();
+      AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:render.sampleRate
+                                                                             channels:render.channelCount];
+      kernel.startProcessing(format, maxFrameCount);
+      started = true;
+
+      samples.assign(render.channelCount, std::vector<float>(maxFrameCount));
+      outputStorage.assign(offsetof(AudioBufferList, mBuffers) + sizeof(AudioBuffer) * render.channelCount, 0);
+      output = reinterpret_cast<AudioBufferList*>(outputStorage.data());
+      output->mNumberBuffers = render.channelCount;
+    }
+
+    // A null data pointer asks the kernel to render in place into the input buffers.
+    for (UInt32 channel = 0; channel < render.channelCount; ++channel) {
+      output->mBuffers[channel].mNumberChannels = 1;
+      output->mBuffers[channel].mDataByteSize = UInt32(render.frameCount * sizeof(float));
+      output->mBuffers[channel].mData = render.inPlace ? nullptr : samples[channel].data();
+    }
+
+    AudioTimeStamp timestamp;
+    memset(&timestamp, 0, sizeof(timestamp));
+    timestamp.mSampleTime = Float64(render.sampleTime);
+    timestamp.mFlags = kAudioTimeStampSampleTimeValid;
+
+    auto start = std::chrono::steady_clock::now();
+    kernel.processAndRender(&timestamp, render.frameCount, 0, output, render.events, pullInput);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    costs.record(uint64_t(elapsed.count()), render);
+  }
+
+  if (started) kernel.stopProcessing();
+  return costs.report(scenario.options().name);
+}
@@ -0,0 +1,203 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cmath>
+
+#include "BiquadFilter.h"
+#include "HumRemover.h"
+
+namespace {
+
+/// Width of the tracker's band-pass filter once the mains frequency is known, and before that when it must cover both
+constexpr float lockedTrackerQ = 4.0f;
+constexpr float searchTrackerQ = 1.5f;
+
+/// Number of hum periods to measure before using the measurement
+constexpr size_t minimumPeriods = 8;
+
+/// How far the fundamental may drift from the nominal mains frequency
+constexpr float maximumDrift = 0.05f;
+
+/// How much of the difference between a measurement and the estimate to take at each update
+constexpr float smoothing = 0.25f;
+
+/// Hum quieter than this (about -100 dBFS RMS after the tracker's filter) is not tracked
+constexpr double minimumEnergy = 1e-10;
+
+/// Number of harmonics, starting with the fundamental, that are too low for a float direct form notch
+constexpr size_t lowNotchCount = 2;
+
+BiquadFilter::Coefficients identity()
+{
+  BiquadFilter::Coefficients coefficients;
+  coefficients.b0 = 1.0f;
+  return coefficients;
+}
+
+} // end namespace
+
+void
+HumRemover::configure(size_t numChannels, double sampleRate, Mains mains, size_t harmonicCount, float q)
+{
+  numChannels_ = numChannels;
+  sampleRate_ = sampleRate;
+  mains_ = mains;
+  q_ = q;
+
+  // Keep the harmonics that stay clear of the Nyquist frequency at the highest fundamental that can be tracked.
+  float highest = (mains == Mains::fifty ? 50.0f : 60.0f) * (1.0f + maximumDrift);
+  size_t usable = size_t(0.45 * sampleRate / highest);
+  size_t count = std::min(harmonicCount, usable);
+  lowNotches_.assign(std::min(count, lowNotchCount), BiquadTopologyFilter(BiquadTopologyFilter::Topology::coupledForm));
+  for (auto& notch : lowNotches_) notch.setCoefficients(1.0, 0.0, 0.0, 0.0, 0.0, numChannels);
+  notches_.setSections(std::vector<BiquadFilter::Coefficients>(count - lowNotches_.size(), identity()), numChannels);
+  ins_.resize(numChannels);
+  outs_.resize(numChannels);
+  resetState();
+}
+
+void
+HumRemover::process(float const* const* ins, float* const* outs, size_t frameCount)
+{
+  size_t offset = 0;
+  while (offset < frameCount) {
+    size_t count = std::min(untilUpdate_, frameCount - offset);
+
+    // Measure before filtering since the output may overwrite the input.
+    track(ins, offset, count);
+    for (size_t channel = 0; channel < numChannels_; ++channel) {
+      ins_[channel] = ins[channel] + offset;
+      outs_[channel] = outs[channel] + offset;
+    }
+
+    // After the first notch the work is done in place on the output.
+    float const* const* from = ins_.data();
+    for (auto& notch : lowNotches_) {
+      notch.apply(from, outs_.data(), 1, count);
+      from = outs_.data();
+    }
+    notches_.apply(from, outs_.data(), 1, count);
+
+    offset += count;
+    untilUpdate_ -= count;
+    if (untilUpdate_ == 0) {
+      update();
+      untilUpdate_ = controlInterval;
+    }
+  }
+}
+
+void
+HumRemover::resetState()
+{
+  for (auto& notch : lowNotches_) notch.resetState();
+  notches_.resetState();
+  nominal_ = mains_ == Mains::fifty ? 50.0f : mains_ == Mains::sixty ? 60.0f : 0.0f;
+  fundamental_ = nominal_;
+  if (locked()) tuneTracker(fundamental_, lockedTrackerQ);
+  else tuneTracker(55.0f, searchTrackerQ);
+  tuneNotches();
+
+  s1_ = 0.0;
+  s2_ = 0.0;
+  previous_ = 0.0;
+  crossed_ = false;
+  periodSum_ = 0.0;
+  periodCount_ = 0;
+  energy_ = 0.0;
+  energyCount_ = 0;
+  untilUpdate_ = controlInterval;
+}
+
+void
+HumRemover::track(float const* const* ins, size_t offset, size_t frameCount)
+{
+  double const scale = 1.0 / numChannels_;
+  double const start = double(controlInterval - untilUpdate_);
+  for (size_t index = 0; index < frameCount; ++index) {
+    double sum = 0.0;
+    for (size_t channel = 0; channel < numChannels_; ++channel) sum += ins[channel][offset + index];
+
+    double x = b0_ * sum * scale;
+    double y = x + s1_;
+    s1_ = s2_ - a1_ * y;
+    s2_ = -x - a2_ * y;
+    energy_ += y * y;
+
+    // Rising zero crossing, placed between the two samples by linear interpolation
+    if (previous_ < 0.0 && y >= 0.0) {
+      double time = start + index - 1.0 + previous_ / (previous_ - y);
+      if (crossed_) {
+        periodSum_ += time - lastCrossing_;
+        ++periodCount_;
+      }
+      lastCrossing_ = time;
+      crossed_ = true;
+    }
+    previous_ = y;
+  }
+  energyCount_ += frameCount;
+}
+
+void
+HumRemover::update()
+{
+  lastCrossing_ -= double(controlInterval);
+  if (periodCount_ < minimumPeriods) return;
+
+  bool audible = energy_ / energyCount_ > minimumEnergy;
+  double measured = sampleRate_ * periodCount_ / periodSum_;
+  periodSum_ = 0.0;
+  periodCount_ = 0;
+  energy_ = 0.0;
+  energyCount_ = 0;
+  if (!audible) return;
+
+  if (!locked()) {
+    if (measured < 50.0 * (1.0 - maximumDrift) || measured > 60.0 * (1.0 + maximumDrift)) return;
+    nominal_ = measured < 55.0 ? 50.0f : 60.0f;
+    fundamental_ = float(measured);
+  }
+  else {
+    if (std::fabs(measured - nominal_) > maximumDrift * nominal_) return;
+    fundamental_ += smoothing * (float(measured) - fundamental_);
+  }
+
+  tuneTracker(fundamental_, lockedTrackerQ);
+  if (std::fabs(fundamental_ - tuned_) > 0.001f) tuneNotches();
+}
+
+void
+HumRemover::tuneTracker(float frequency, float q)
+{
+  auto coefficients = BiquadFilter::bandPass(frequency, q, float(2.0 / sampleRate_));
+  b0_ = coefficients.b0;
+  a1_ = coefficients.a1;
+  a2_ = coefficients.a2;
+}
+
+void
+HumRemover::tuneNotches()
+{
+  // Until the mains frequency is known the notches pass everything.
+  float nyquistPeriod = float(2.0 / sampleRate_);
+  for (size_t index = 0; index < lowNotches_.size(); ++index) {
+    if (!locked()) {
+      lowNotches_[index].setCoefficients(1.0, 0.0, 0.0, 0.0, 0.0, numChannels_);
+      continue;
+    }
+
+    // Same design as BiquadFilter::notch, kept in double precision for the coupled form
+    const double frequencyRads = 2.0 * M_PI * fundamental_ * (index + 1) / sampleRate_;
+    const double alpha = std::sin(frequencyRads) / (2.0 * q_);
+    const double a0 = 1.0 + alpha;
+    const double b1 = -2.0 * std::cos(frequencyRads) / a0;
+    lowNotches_[index].setCoefficients(1.0 / a0, b1, 1.0 / a0, b1, (1.0 - alpha) / a0, numChannels_);
+  }
+
+  for (size_t index = 0; index < notches_.numSections(); ++index) {
+    float frequency = fundamental_ * (index + lowNotches_.size() + 1);
+    notches_.setSection(index, locked() ? BiquadFilter::notch(frequency, q_, nyquistPeriod) : identity());
+  }
+  tuned_ = fundamental_;
+}
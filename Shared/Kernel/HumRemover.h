@@ -0,0 +1,126 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "BiquadCascade.h"
+#include "BiquadTopologyFilter.h"
+
+/**
+ Removes mains hum -- a 50 or 60 Hz fundamental and its harmonics -- while following drift in its frequency. A cheap
+ tracker measures the fundamental from the zero crossings of the input after a band-pass filter centered on the current
+ estimate, and high-Q notches from BiquadFilter::notch sit on each harmonic. The notches above the second harmonic run
+ as one BiquadCascade, whose SIMD lanes each take a notch, so removing 8 harmonics costs about as much as three or four
+ biquads.
+
+ The tracker works on the average of all channels and updates the estimate and the notch coefficients every
+ `controlInterval` samples. Updates happen at fixed positions in the stream, so processing in blocks of any size gives
+ the same output.
+
+ Rounding the coefficients of a direct form notch near 50 or 100 Hz to float moves its zeros by a few hundredths of a
+ Hz, which limits it to about 30 dB. The fundamental and second harmonic are therefore notched by BiquadTopologyFilter
+ in the coupled form, designed in double precision, which reaches about 70 dB.
+ */
+class HumRemover {
+public:
+
+  /// The mains frequency to expect
+  enum class Mains {
+    /// Decide between 50 and 60 Hz from the input
+    automatic,
+    fifty,
+    sixty
+  };
+
+  /// Number of samples between updates of the estimate and the notches
+  static constexpr size_t controlInterval = 1024;
+
+  /**
+   Configure the notches and the tracker, and clear all state. Allocates memory so it must not be done on the render
+   thread.
+
+   @param numChannels the number of channels to process
+   @param sampleRate the sample rate in Hz
+   @param mains the mains frequency to expect
+   @param harmonicCount the number of harmonics to remove, including the fundamental. Harmonics too close to the
+   Nyquist frequency are left alone.
+   @param q the quality factor of the notches; higher values remove less of what is next to the hum
+   */
+  void configure(size_t numChannels, double sampleRate, Mains mains = Mains::automatic, size_t harmonicCount = 8,
+                 float q = 30.0f);
+
+  /**
+   Remove hum from a collection of audio samples. Input and output may be the same buffers. Does not allocate.
+
+   @param ins array of pointers to the first sample of each channel to process
+   @param outs array of pointers to where to store the first filtered sample of each channel
+   @param frameCount the number of samples to process in each channel
+   */
+  void process(float const* const* ins, float* const* outs, size_t frameCount);
+
+  /**
+   Remove hum from a collection of audio samples.
+
+   @param ins the array of samples to process
+   @param outs the storage for the filtered results
+   @param frameCount the number of samples to process in the sequences
+   */
+  void process(std::vector<float const*> const& ins, std::vector<float*>& outs, size_t frameCount)
+  {
+    assert(numChannels_ == ins.size() && numChannels_ == outs.size());
+    process(ins.data(), outs.data(), frameCount);
+  }
+
+  /**
+   Clear the filter and tracker state and go back to the nominal mains frequency.
+   */
+  void resetState();
+
+  /// @returns the current estimate of the hum fundamental in Hz, or 0 if the mains frequency is not yet known
+  float fundamental() const { return fundamental_; }
+
+  /// @returns true once the mains frequency is known, which for `Mains::automatic` takes a few control intervals
+  bool locked() const { return nominal_ != 0.0f; }
+
+  /// @returns the number of notches in use
+  size_t numNotches() const { return lowNotches_.size() + notches_.numSections(); }
+
+private:
+  void track(float const* const* ins, size_t offset, size_t frameCount);
+  void update();
+  void tuneTracker(float frequency, float q);
+  void tuneNotches();
+
+  Mains mains_ = Mains::automatic;
+  size_t numChannels_ = 0;
+  double sampleRate_ = 44100.0;
+  float q_ = 30.0f;
+  float nominal_ = 0.0f;
+  float fundamental_ = 0.0f;
+  float tuned_ = 0.0f;
+
+  std::vector<BiquadTopologyFilter> lowNotches_;
+  BiquadCascade notches_;
+  std::vector<float const*> ins_;
+  std::vector<float*> outs_;
+
+  // Band-pass filter of the tracker, in transposed direct form II with b1 = 0 and b2 = -b0
+  double b0_ = 0.0;
+  double a1_ = 0.0;
+  double a2_ = 0.0;
+  double s1_ = 0.0;
+  double s2_ = 0.0;
+
+  // Zero-crossing measurement. Times are in samples since the start of the current control interval.
+  double previous_ = 0.0;
+  double lastCrossing_ = 0.0;
+  bool crossed_ = false;
+  double periodSum_ = 0.0;
+  size_t periodCount_ = 0;
+  double energy_ = 0.0;
+  size_t energyCount_ = 0;
+  size_t untilUpdate_ = controlInterval;
+};
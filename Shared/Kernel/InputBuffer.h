@@ -6,8 +6,14 @@
 #import <AudioUnit/AudioUnit.h>
 #import <AVFoundation/AVFoundation.h>
 
+#import <cstddef>
+#import <vector>
+
+#import "ReclaimableBuffer.h"
+
 /**
- Maintains a buffer of PCM samples which is used to save samples from an upstream node.
+ Maintains a buffer of PCM samples which is used to save samples from an upstream node. The samples live in a
+ ReclaimableBuffer, so an idle instance can give them back to the shared BufferPool and get them again when needed.
  */
 struct InputBuffer {
   
@@ -16,12 +22,19 @@ struct InputBuffer {
    
    @param format the format of the samples
    @param maxFrames the maximum number of frames to be found in the upstream output
+   @param idleFrames the number of idle frames in a row after which the samples are given back (0 to keep them)
    */
-  void allocateBuffers(AVAudioFormat* format, AUAudioFrameCount maxFrames)
+  void allocateBuffers(AVAudioFormat* format, AUAudioFrameCount maxFrames, AUAudioFrameCount idleFrames = 0)
   {
     maxFramesToRender_ = maxFrames;
-    buffer_ = [[AVAudioPCMBuffer alloc] initWithPCMFormat: format frameCapacity: maxFrames];
-    mutableAudioBufferList_ = buffer_.mutableAudioBufferList;
+    AVAudioChannelCount channelCount = format.channelCount;
+    bufferListStorage_.assign(offsetof(AudioBufferList, mBuffers) + sizeof(AudioBuffer) * channelCount, 0);
+    mutableAudioBufferList_ = reinterpret_cast<AudioBufferList*>(bufferListStorage_.data());
+    mutableAudioBufferList_->mNumberBuffers = channelCount;
+    for (UInt32 i = 0; i < channelCount; ++i) {
+      mutableAudioBufferList_->mBuffers[i].mNumberChannels = 1;
+    }
+    samples_.configure(size_t(maxFrames) * channelCount, idleFrames);
   }
   
   /**
@@ -29,24 +42,38 @@ struct InputBuffer {
    */
   void releaseBuffers()
   {
-    buffer_ = nullptr;
+    samples_.configure(0, 0);
+    bufferListStorage_.clear();
     mutableAudioBufferList_ = nullptr;
   }
   
   /**
-   Obtain samples from an upstream node. Output is stored in internal buffer.
+   Obtain samples from an upstream node. Output is stored in internal buffer. If the samples were given back and no
+   storage could be had without allocating, the output buffers are used instead (see `starved`). A host that renders
+   in place provides none, and then nothing is pulled and kAudioUnitErr_CannotDoInCurrentContext is returned, since the
+   buffers of the upstream node must not be filtered in place. Must be followed by `finishRender`.
    
    @param actionFlags render flags from the host
    @param timestamp the current transport time of the samples
    @param frameCount the number of frames to process
    @param inputBusNumber the bus to pull from
    @param pullInputBlock the function to call to do the pulling
+   @param output the buffers that will hold the rendered samples
    */
   AUAudioUnitStatus pullInput(AudioUnitRenderActionFlags* actionFlags, AudioTimeStamp const* timestamp,
                               AVAudioFrameCount frameCount, NSInteger inputBusNumber,
-                              AURenderPullInputBlock pullInputBlock)
+                              AURenderPullInputBlock pullInputBlock, AudioBufferList const* output)
   {
     if (pullInputBlock == nullptr) return kAudioUnitErr_NoConnection;
+    float* samples = samples_.beginRender();
+    starved_ = samples == nullptr;
+    for (UInt32 i = 0; i < mutableAudioBufferList_->mNumberBuffers; ++i) {
+      void* data = nullptr;
+      if (samples != nullptr) data = samples + size_t(i) * maxFramesToRender_;
+      else if (i < output->mNumberBuffers) data = output->mBuffers[i].mData;
+      if (data == nullptr) return kAudioUnitErr_CannotDoInCurrentContext;
+      mutableAudioBufferList_->mBuffers[i].mData = data;
+    }
     prepareInputBufferList(frameCount);
     return pullInputBlock(actionFlags, timestamp, frameCount, inputBusNumber, mutableAudioBufferList_);
   }
@@ -63,12 +90,38 @@ struct InputBuffer {
       mutableAudioBufferList_->mBuffers[i].mDataByteSize = byteSize;
     }
   }
+
+  /**
+   Finish a render begun by `pullInput`. Does not allocate.
+
+   @param frameCount the number of frames rendered
+   @param idle true if nothing was heard, which counts towards giving back the samples
+   */
+  void finishRender(AVAudioFrameCount frameCount, bool idle) { samples_.endRender(frameCount, idle); }
+
+  /**
+   Get the samples back ahead of need. Not for the render thread.
+   */
+  void prime() { samples_.prime(); }
+
+  /// @returns true if the samples are given back when idle
+  bool reclaims() const { return samples_.idleFrames() > 0; }
+
+  /// @returns true if the last pull found no storage of its own and the BufferPool reserve empty
+  bool starved() const { return starved_; }
+
+  /// @returns the number of bytes of sample storage held
+  uint64_t residentBytes() const
+  {
+    return samples_.holding() == ReclaimableBuffer::Holding::own ? samples_.size() * sizeof(float) : 0;
+  }
   
   AudioBufferList* mutableAudioBufferList() const { return mutableAudioBufferList_; }
   
 private:
-  os_log_t logger_ = os_log_create("LPF", "BufferedInputBus");
   AUAudioFrameCount maxFramesToRender_ = 0;
-  AVAudioPCMBuffer* buffer_ = nullptr;
+  std::vector<uint8_t> bufferListStorage_;
   AudioBufferList* mutableAudioBufferList_ = nullptr;
+  ReclaimableBuffer samples_;
+  bool starved_ = false;
 };
@@ -4,10 +4,13 @@
 #pragma once
 
 #import <algorithm>
+#import <chrono>
 #import <vector>
 #import <AudioToolbox/AudioToolbox.h>
 
 #include "InputBuffer.h"
+#include "KernelTelemetry.h"
+#include "RenderEventList.h"
 
 /**
  Base template class for DSP kernels that provides common functionality. It properly interleaves render events with
@@ -16,7 +19,11 @@
  
  - doParameterEvent
  - doMIDIEvent
- - doRenderFrames
+ - doRendering
+ - canLinkChannels -- report if `doLinkedRendering` could be used right now. Checked before comparing the inputs, so
+   that kernels that cannot link do not pay for the comparison.
+ - doLinkedRendering -- render only the first channel when all channels have the same input, returning false if the
+   kernel cannot do so right now. The result is copied to the other channels.
  
  */
 template <typename T> class KernelEventProcessor {
@@ -30,11 +37,26 @@ public:
   KernelEventProcessor(os_log_t log) : log_{log} {}
   
   /**
-   Set the bypass mode.
+   Set the bypass mode. Turning bypass off gets back any buffers given up while bypassed before the next render needs
+   them, so this must not be done on the render thread.
    
    @param bypass if true disable filter processing and just copy samples from input to output
    */
-  void setBypass(bool bypass) { bypassed_ = bypass; }
+  void setBypass(bool bypass)
+  {
+    bypassed_ = bypass;
+    if (!bypass) inputBuffer_.prime();
+  }
+
+  /**
+   Set how long the kernel must be bypassed or hear only silence before its input buffers are given back to the shared
+   BufferPool. They are taken back without allocating on the render thread when sound returns (see ReclaimableBuffer).
+   While the host renders in place they are kept, since there are then no output buffers to fall back on. The default
+   is 10 seconds. Takes effect at the next `startProcessing`.
+
+   @param seconds the idle time after which buffers are given back, or 0 to always keep them
+   */
+  void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
   
   /**
    Get current bypass mode
@@ -48,7 +70,10 @@ public:
    @param maxFramesToRender the maximum number of frames to expect on input
    */
   void startProcessing(AVAudioFormat* format, AUAudioFrameCount maxFramesToRender) {
-    inputBuffer_.allocateBuffers(format, maxFramesToRender);
+    events_.allocate();
+    inputBuffer_.allocateBuffers(format, maxFramesToRender, AUAudioFrameCount(idleTimeout_ * format.sampleRate));
+    telemetry_.setSampleRate(format.sampleRate);
+    telemetry_.setMemoryFootprint(uint64_t(maxFramesToRender) * format.channelCount * sizeof(float));
   }
   
   /**
@@ -71,15 +96,21 @@ public:
                                      AudioBufferList* output, AURenderEvent* realtimeEventListHead,
                                      AURenderPullInputBlock pullInputBlock)
   {
+    auto start = std::chrono::steady_clock::now();
+    auto inPlace = output->mBuffers[0].mData == nullptr;
     AudioUnitRenderActionFlags actionFlags = 0;
-    auto status = inputBuffer_.pullInput(&actionFlags, timestamp, frameCount, inputBusNumber, pullInputBlock);
+    auto status = inputBuffer_.pullInput(&actionFlags, timestamp, frameCount, inputBusNumber, pullInputBlock, output);
+    if (inputBuffer_.starved()) telemetry_.recordReserveExhausted();
     if (status != noErr) {
+      inputBuffer_.finishRender(frameCount, false);
       os_log_with_type(log_, OS_LOG_TYPE_ERROR, "failed pullInput - %d", status);
       return status;
     }
+
+    // Check before rendering, which may overwrite the input
+    bool idle = inputBuffer_.reclaims() && !inPlace && (isBypassed() || silentInput(frameCount));
     
     // If performing in-place operation, set output to use input buffers
-    auto inPlace = output->mBuffers[0].mData == nullptr;
     if (inPlace) {
       AudioBufferList* input = inputBuffer_.mutableAudioBufferList();
       for (auto i = 0; i < output->mNumberBuffers; ++i) {
@@ -88,38 +119,55 @@ public:
     }
     
     setBuffers(inputBuffer_.mutableAudioBufferList(), output);
+    eventCount_ = 0;
     render(timestamp, frameCount, realtimeEventListHead);
     clearBuffers();
-    
+    inputBuffer_.finishRender(frameCount, idle);
+    telemetry_.setMemoryFootprint(inputBuffer_.residentBytes());
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    telemetry_.recordRender(uint64_t(elapsed.count()), frameCount, eventCount_);
     return noErr;
   }
   
 protected:
   os_log_t log_;
+  KernelTelemetry telemetry_;
   
 private:
   
+  /**
+   Render the frames, applying each event before the first frame at or after its time. The events go through
+   RenderEventList first, so whatever the host sends, the render is split only where events actually change something
+   and parameter changes are applied in time order. Events that do not fit in the list are applied after the last
+   frame, in the order the host sent them, except for parameter changes that would undo a later one in the list. They
+   are counted in telemetry.
+   */
   void render(AudioTimeStamp const* timestamp, AUAudioFrameCount frameCount, AURenderEvent const* events)
   {
-    auto zero = AUEventSampleTime(0);
     auto now = AUEventSampleTime(timestamp->mSampleTime);
-    auto framesRemaining = frameCount;
-    
-    while (framesRemaining > 0) {
-      if (events == nullptr) {
-        renderFrames(framesRemaining, frameCount - framesRemaining);
-        return;
-      }
-      
-      auto framesThisSegment = AUAudioFrameCount(std::max(events->head.eventSampleTime - now, zero));
-      if (framesThisSegment > 0) {
-        renderFrames(framesThisSegment, frameCount - framesRemaining);
-        framesRemaining -= framesThisSegment;
-        now += AUEventSampleTime(framesThisSegment);
+    events_.assign(events, now, frameCount);
+
+    size_t next = 0;
+    AUAudioFrameCount processed = 0;
+    while (processed < frameCount) {
+      while (next < events_.size() && events_[next].time <= now + AUEventSampleTime(processed)) {
+        renderEvent(events_[next++].event);
       }
-      
-      events = renderEventsUntil(now, events);
+
+      auto until = next < events_.size() ? AUAudioFrameCount(events_[next].time - now) : frameCount;
+      renderFrames(until - processed, processed);
+      processed = until;
     }
+
+    while (next < events_.size()) renderEvent(events_[next++].event);
+
+    uint32_t overflowCount = 0;
+    for (auto event = events_.overflow(); event != nullptr; event = event->head.next) {
+      ++overflowCount;
+      if (!events_.overridden(event)) renderEvent(event);
+    }
+    if (overflowCount > 0) telemetry_.recordEventOverflow(overflowCount);
   }
   
   void setBuffers(AudioBufferList const* inputs, AudioBufferList* outputs)
@@ -143,25 +191,22 @@ private:
     outs_.clear();
   }
   
-  AURenderEvent const* renderEventsUntil(AUEventSampleTime now, AURenderEvent const* event)
+  void renderEvent(AURenderEvent const* event)
   {
-    while (event != nullptr && event->head.eventSampleTime <= now) {
-      switch (event->head.eventType) {
-        case AURenderEventParameter:
-        case AURenderEventParameterRamp:
-          injected()->doParameterEvent(event->parameter);
-          break;
-          
-        case AURenderEventMIDI:
-          injected()->doMIDIEvent(event->MIDI);
-          break;
-          
-        default:
-          break;
-      }
-      event = event->head.next;
+    ++eventCount_;
+    switch (event->head.eventType) {
+      case AURenderEventParameter:
+      case AURenderEventParameterRamp:
+        injected()->doParameterEvent(event->parameter);
+        break;
+        
+      case AURenderEventMIDI:
+        injected()->doMIDIEvent(event->MIDI);
+        break;
+        
+      default:
+        break;
     }
-    return event;
   }
   
   void renderFrames(AUAudioFrameCount frameCount, AUAudioFrameCount processedFrameCount)
@@ -185,12 +230,55 @@ private:
       outputs_->mBuffers[channel].mDataByteSize = sizeof(float) * (processedFrameCount + frameCount);
     }
     
+    // Dual-mono material has the same samples in every channel. If the kernel can, filter one channel and copy it.
+    if (ins_.size() > 1 && injected()->canLinkChannels() && identicalInputs(frameCount) &&
+        injected()->doLinkedRendering(ins_, outs_, frameCount)) {
+      for (size_t channel = 1; channel < outs_.size(); ++channel) {
+        if (outs_[channel] != outs_[0]) memcpy(outs_[channel], outs_[0], frameCount * sizeof(float));
+      }
+      return;
+    }
+
     injected()->doRendering(ins_, outs_, frameCount);
   }
+
+  /**
+   Determine if all input channels hold the same samples. This is a byte comparison which the C library does with
+   vector instructions, and for true stereo material it usually stops within the first few samples.
+
+   @param frameCount the number of samples to compare
+   @returns true if all channels are identical
+   */
+  bool identicalInputs(AUAudioFrameCount frameCount) const
+  {
+    for (size_t channel = 1; channel < ins_.size(); ++channel) {
+      if (ins_[channel] != ins_[0] && memcmp(ins_[channel], ins_[0], frameCount * sizeof(float)) != 0) return false;
+    }
+    return true;
+  }
   
+  /**
+   Determine if all input channels hold nothing but silence.
+
+   @param frameCount the number of samples to check
+   @returns true if every sample is zero
+   */
+  bool silentInput(AUAudioFrameCount frameCount) const
+  {
+    AudioBufferList const* input = inputBuffer_.mutableAudioBufferList();
+    for (size_t channel = 0; channel < input->mNumberBuffers; ++channel) {
+      auto samples = static_cast<float const*>(input->mBuffers[channel].mData);
+      for (AUAudioFrameCount index = 0; index < frameCount; ++index) {
+        if (samples[index] != 0.0f) return false;
+      }
+    }
+    return true;
+  }
+
   T* injected() { return static_cast<T*>(this); }
   
   InputBuffer inputBuffer_;
+  RenderEventList events_;
   
   AudioBufferList const* inputs_ = nullptr;
   AudioBufferList* outputs_ = nullptr;
@@ -199,4 +287,6 @@ private:
   std::vector<float*> outs_;
   
   bool bypassed_ = false;
+  double idleTimeout_ = 10.0;
+  uint32_t eventCount_ = 0;
 };
@@ -0,0 +1,409 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "KernelTelemetry.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "telemetry requires lock-free atomics");
+
+/**
+ Statistics of one kernel. Lives in shared memory, so it only holds lock-free atomics and plain characters.
+ */
+struct KernelTelemetry::Slot {
+  /// 0 when free, 1 while being claimed, 2 when publishing
+  std::atomic<uint32_t> state;
+  char name[48];
+  /// Engine name packed into words, so that the render thread can change it with relaxed stores
+  std::atomic<uint64_t> engine[2];
+  std::atomic<uint64_t> sampleRate;
+  std::atomic<uint64_t> renders;
+  std::atomic<uint64_t> frames;
+  std::atomic<uint64_t> deadlineMisses;
+  std::atomic<uint64_t> events;
+  std::atomic<uint64_t> lastEventsPerBlock;
+  std::atomic<uint64_t> maxEventsPerBlock;
+  std::atomic<uint64_t> nanResets;
+  std::atomic<uint64_t> reserveExhausted;
+  std::atomic<uint64_t> overflowEvents;
+  std::atomic<uint64_t> memoryBytes;
+  std::atomic<uint64_t> lastNanoseconds;
+  std::atomic<uint64_t> maxNanoseconds;
+  std::atomic<uint64_t> histogram[histogramSize];
+};
+
+/**
+ Layout of the shared memory segment of a process.
+ */
+struct KernelTelemetry::Segment {
+  static constexpr uint32_t magicValue = 0x4C504654; // "LPFT"
+  static constexpr uint32_t versionValue = 5;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slotCount;
+  uint32_t slotSize;
+  /// Number of attached kernels that found no free slot
+  std::atomic<uint32_t> dropped;
+  Slot slots[KernelTelemetry::slotCount];
+};
+
+namespace {
+
+enum SlotState : uint32_t { slotFree = 0, slotClaimed = 1, slotPublishing = 2 };
+
+/**
+ The segments created by this process, by name. They are never unmapped since kernels may publish until the very end,
+ but the shared ones are removed from the system when the process exits.
+ */
+class Segments {
+public:
+  using Segment = KernelTelemetry::Segment;
+
+  static Segments& shared()
+  {
+    static Segments segments;
+    return segments;
+  }
+
+  ~Segments()
+  {
+    for (auto const& name : shared_) shm_unlink(name.c_str());
+  }
+
+  /// @returns the segment of the given name if this process created it
+  Segment* find(std::string const& name)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = segments_.find(name);
+    return found == segments_.end() ? nullptr : found->second;
+  }
+
+  /// @returns the segment of the given name, creating it on first use
+  Segment* open(std::string const& name)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = segments_.find(name);
+    if (found != segments_.end()) return found->second;
+
+    // Start from a new segment, left over from no one, whose pages are zero and only take memory once written to.
+    Segment* segment = nullptr;
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd >= 0) {
+      if (ftruncate(fd, sizeof(Segment)) == 0) {
+        void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory != MAP_FAILED) segment = static_cast<Segment*>(memory);
+      }
+      close(fd);
+      if (segment == nullptr) shm_unlink(name.c_str());
+      else shared_.push_back(name);
+    }
+
+    // No shared memory available -- publish within the process only.
+    if (segment == nullptr) segment = static_cast<Segment*>(calloc(1, sizeof(Segment)));
+
+    segment->slotCount = KernelTelemetry::slotCount;
+    segment->slotSize = sizeof(KernelTelemetry::Slot);
+    segment->version = Segment::versionValue;
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = Segment::magicValue;
+    segments_[name] = segment;
+    return segment;
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<std::string, Segment*> segments_;
+  std::vector<std::string> shared_;
+};
+
+/// Single-writer update: a plain load and store, which unlike a read-modify-write is wait-free on every architecture.
+inline void add(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void raise(std::atomic<uint64_t>& counter, uint64_t value)
+{
+  if (value > counter.load(std::memory_order_relaxed)) counter.store(value, std::memory_order_relaxed);
+}
+
+inline uint64_t get(std::atomic<uint64_t> const& counter) { return counter.load(std::memory_order_relaxed); }
+
+double toDouble(uint64_t bits) { double value; memcpy(&value, &bits, sizeof(value)); return value; }
+uint64_t toBits(double value) { uint64_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; }
+
+double percentile(uint64_t const* histogram, uint64_t total, double fraction)
+{
+  if (total == 0) return 0.0;
+  auto target = uint64_t(std::ceil(fraction * total));
+  uint64_t seen = 0;
+  for (size_t index = 0; index < KernelTelemetry::histogramSize; ++index) {
+    seen += histogram[index];
+    if (seen >= target) return KernelTelemetry::bucketLimit(index);
+  }
+  return KernelTelemetry::bucketLimit(KernelTelemetry::histogramSize - 1);
+}
+
+void readSegment(KernelTelemetry::Segment const* segment, std::vector<KernelTelemetry::Snapshot>& snapshots)
+{
+  snapshots.clear();
+  for (auto const& slot : segment->slots) {
+    if (slot.state.load(std::memory_order_acquire) != slotPublishing) continue;
+    KernelTelemetry::Snapshot snapshot;
+    snapshot.name.assign(slot.name, strnlen(slot.name, sizeof(slot.name)));
+    uint64_t engine[2] = {get(slot.engine[0]), get(slot.engine[1])};
+    auto engineChars = reinterpret_cast<char const*>(engine);
+    snapshot.engine.assign(engineChars, strnlen(engineChars, sizeof(engine)));
+    snapshot.sampleRate = toDouble(get(slot.sampleRate));
+    snapshot.renders = get(slot.renders);
+    snapshot.frames = get(slot.frames);
+    snapshot.deadlineMisses = get(slot.deadlineMisses);
+    snapshot.events = get(slot.events);
+    snapshot.lastEventsPerBlock = get(slot.lastEventsPerBlock);
+    snapshot.maxEventsPerBlock = get(slot.maxEventsPerBlock);
+    snapshot.nanResets = get(slot.nanResets);
+    snapshot.reserveExhausted = get(slot.reserveExhausted);
+    snapshot.overflowEvents = get(slot.overflowEvents);
+    snapshot.memoryBytes = get(slot.memoryBytes);
+    snapshot.lastMicroseconds = get(slot.lastNanoseconds) / 1000.0;
+    snapshot.maxMicroseconds = get(slot.maxNanoseconds) / 1000.0;
+
+    uint64_t histogram[KernelTelemetry::histogramSize];
+    uint64_t total = 0;
+    for (size_t index = 0; index < KernelTelemetry::histogramSize; ++index) {
+      histogram[index] = get(slot.histogram[index]);
+      total += histogram[index];
+    }
+
+    // Bucket limits can overshoot the longest duration actually seen
+    snapshot.p50Microseconds = std::min(percentile(histogram, total, 0.50) / 1000.0, snapshot.maxMicroseconds);
+    snapshot.p90Microseconds = std::min(percentile(histogram, total, 0.90) / 1000.0, snapshot.maxMicroseconds);
+    snapshot.p99Microseconds = std::min(percentile(histogram, total, 0.99) / 1000.0, snapshot.maxMicroseconds);
+    snapshots.push_back(snapshot);
+  }
+}
+
+} // end namespace
+
+bool
+KernelTelemetry::attach(std::string const& name, std::string const& segmentName)
+{
+  detach();
+  auto segment = Segments::shared().open(segmentName);
+  for (auto& slot : segment->slots) {
+    uint32_t expected = slotFree;
+    if (!slot.state.compare_exchange_strong(expected, slotClaimed, std::memory_order_acquire)) continue;
+
+    snprintf(slot.name, sizeof(slot.name), "%s", name.c_str());
+    for (auto counter : {&slot.engine[0], &slot.engine[1], &slot.sampleRate, &slot.renders, &slot.frames, &slot.deadlineMisses, &slot.events,
+                         &slot.lastEventsPerBlock, &slot.maxEventsPerBlock, &slot.nanResets, &slot.reserveExhausted,
+                         &slot.overflowEvents, &slot.memoryBytes, &slot.lastNanoseconds, &slot.maxNanoseconds}) {
+      counter->store(0, std::memory_order_relaxed);
+    }
+    for (auto& counter : slot.histogram) counter.store(0, std::memory_order_relaxed);
+
+    slot.state.store(slotPublishing, std::memory_order_release);
+    slot_ = &slot;
+    return true;
+  }
+
+  segment->dropped.fetch_add(1, std::memory_order_relaxed);
+  droppedFrom_ = segment;
+  return false;
+}
+
+void
+KernelTelemetry::detach()
+{
+  if (droppedFrom_ != nullptr) {
+    droppedFrom_->dropped.fetch_sub(1, std::memory_order_relaxed);
+    droppedFrom_ = nullptr;
+  }
+
+  if (slot_ == nullptr) return;
+  slot_->state.store(slotFree, std::memory_order_release);
+  slot_ = nullptr;
+}
+
+void
+KernelTelemetry::setSampleRate(double sampleRate)
+{
+  if (slot_ == nullptr) return;
+  slot_->sampleRate.store(toBits(sampleRate), std::memory_order_relaxed);
+}
+
+void
+KernelTelemetry::setEngine(char const* name)
+{
+  if (slot_ == nullptr) return;
+  uint64_t engine[2] = {};
+  auto engineChars = reinterpret_cast<char*>(engine);
+  for (size_t index = 0; index < sizeof(engine) - 1 && name[index] != '\0'; ++index) engineChars[index] = name[index];
+  slot_->engine[0].store(engine[0], std::memory_order_relaxed);
+  slot_->engine[1].store(engine[1], std::memory_order_relaxed);
+}
+
+void
+KernelTelemetry::setMemoryFootprint(uint64_t bytes)
+{
+  if (slot_ == nullptr) return;
+  slot_->memoryBytes.store(bytes, std::memory_order_relaxed);
+}
+
+void
+KernelTelemetry::recordRender(uint64_t nanoseconds, uint32_t frameCount, uint32_t eventCount)
+{
+  if (slot_ == nullptr) return;
+  auto& slot = *slot_;
+  add(slot.renders, 1);
+  add(slot.frames, frameCount);
+  add(slot.events, eventCount);
+  slot.lastEventsPerBlock.store(eventCount, std::memory_order_relaxed);
+  raise(slot.maxEventsPerBlock, eventCount);
+  slot.lastNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+  raise(slot.maxNanoseconds, nanoseconds);
+  add(slot.histogram[bucket(nanoseconds)], 1);
+
+  // The callback has to finish within the time it takes to play the frames it renders.
+  double sampleRate = toDouble(slot.sampleRate.load(std::memory_order_relaxed));
+  if (sampleRate > 0.0 && nanoseconds > frameCount * 1.0e9 / sampleRate) add(slot.deadlineMisses, 1);
+}
+
+void
+KernelTelemetry::recordNaNReset()
+{
+  if (slot_ == nullptr) return;
+  add(slot_->nanResets, 1);
+}
+
+void
+KernelTelemetry::recordReserveExhausted()
+{
+  if (slot_ == nullptr) return;
+  add(slot_->reserveExhausted, 1);
+}
+
+void
+KernelTelemetry::recordEventOverflow(uint32_t count)
+{
+  if (slot_ == nullptr) return;
+  add(slot_->overflowEvents, count);
+}
+
+std::string
+KernelTelemetry::segmentName(pid_t pid)
+{
+  return "/lpf-telemetry-" + std::to_string(pid);
+}
+
+bool
+KernelTelemetry::read(std::string const& segmentName, std::vector<Snapshot>& snapshots, uint64_t* dropped)
+{
+  auto own = Segments::shared().find(segmentName);
+  if (own != nullptr) {
+    readSegment(own, snapshots);
+    if (dropped != nullptr) *dropped = own->dropped.load(std::memory_order_relaxed);
+    return true;
+  }
+
+  int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+
+  struct stat info;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(Segment)) {
+    memory = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) return false;
+
+  auto segment = static_cast<Segment const*>(memory);
+  bool valid = segment->magic == Segment::magicValue && segment->version == Segment::versionValue &&
+  segment->slotCount == slotCount && segment->slotSize == sizeof(Slot);
+  if (valid) {
+    readSegment(segment, snapshots);
+    if (dropped != nullptr) *dropped = segment->dropped.load(std::memory_order_relaxed);
+  }
+  munmap(memory, sizeof(Segment));
+  return valid;
+}
+
+std::string
+KernelTelemetry::exposition(pid_t pid, std::vector<Snapshot> const& snapshots, uint64_t dropped)
+{
+  struct Metric {
+    char const* name;
+    char const* type;
+    char const* help;
+    double (*value)(Snapshot const&);
+  };
+
+  static Metric const metrics[] = {
+    {"lpf_renders_total", "counter", "Render callbacks", [](Snapshot const& s) { return double(s.renders); }},
+    {"lpf_frames_total", "counter", "Frames rendered", [](Snapshot const& s) { return double(s.frames); }},
+    {"lpf_deadline_misses_total", "counter", "Render callbacks that took longer than their frames play for",
+      [](Snapshot const& s) { return double(s.deadlineMisses); }},
+    {"lpf_events_total", "counter", "Render events handled", [](Snapshot const& s) { return double(s.events); }},
+    {"lpf_events_overflow_total", "counter", "Render events that did not fit in the event list",
+      [](Snapshot const& s) { return double(s.overflowEvents); }},
+    {"lpf_events_per_block_max", "gauge", "Most render events in one callback",
+      [](Snapshot const& s) { return double(s.maxEventsPerBlock); }},
+    {"lpf_nan_resets_total", "counter", "Filter resets after a NaN or infinity",
+      [](Snapshot const& s) { return double(s.nanResets); }},
+    {"lpf_reserve_exhausted_total", "counter", "Renders that found no sample storage and an empty reserve",
+      [](Snapshot const& s) { return double(s.reserveExhausted); }},
+    {"lpf_memory_bytes", "gauge", "Memory used for rendering", [](Snapshot const& s) { return double(s.memoryBytes); }},
+    {"lpf_render_p50_microseconds", "gauge", "Median render callback duration",
+      [](Snapshot const& s) { return s.p50Microseconds; }},
+    {"lpf_render_p90_microseconds", "gauge", "90th percentile render callback duration",
+      [](Snapshot const& s) { return s.p90Microseconds; }},
+    {"lpf_render_p99_microseconds", "gauge", "99th percentile render callback duration",
+      [](Snapshot const& s) { return s.p99Microseconds; }},
+    {"lpf_render_max_microseconds", "gauge", "Longest render callback duration",
+      [](Snapshot const& s) { return s.maxMicroseconds; }},
+  };
+
+  std::ostringstream os;
+  for (auto const& metric : metrics) {
+    os << "# HELP " << metric.name << ' ' << metric.help << '\n';
+    os << "# TYPE " << metric.name << ' ' << metric.type << '\n';
+    for (auto const& snapshot : snapshots) {
+      os << metric.name << "{pid=\"" << pid << "\",kernel=\"" << snapshot.name << "\",engine=\"" << snapshot.engine
+      << "\"} " << metric.value(snapshot) << '\n';
+    }
+  }
+
+  os << "# HELP lpf_dropped_kernels Kernels not shown because the telemetry segment had no free slot\n";
+  os << "# TYPE lpf_dropped_kernels gauge\n";
+  os << "lpf_dropped_kernels{pid=\"" << pid << "\"} " << dropped << '\n';
+  return os.str();
+}
+
+size_t
+KernelTelemetry::bucket(uint64_t nanoseconds)
+{
+  if (nanoseconds < 4) return size_t(nanoseconds);
+  int exponent = 63 - __builtin_clzll(nanoseconds);
+  size_t index = 4 * size_t(exponent - 1) + size_t((nanoseconds >> (exponent - 2)) & 3);
+  return index < histogramSize ? index : histogramSize - 1;
+}
+
+double
+KernelTelemetry::bucketLimit(size_t index)
+{
+  if (index < 4) return double(index);
+  int exponent = int(index / 4) + 1;
+  return std::ldexp(double(4 + index % 4 + 1), exponent - 2) - 1.0;
+}
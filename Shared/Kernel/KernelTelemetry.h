@@ -0,0 +1,201 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+#include "NonCopyable.hpp"
+
+/**
+ Health statistics of a rendering kernel, published for other processes to read so that a render farm or live rig can
+ be watched without attaching a debugger (see Tools/lpftop.cpp).
+
+ Each process has one shared memory segment named by `segmentName` that holds a slot per kernel instance. A kernel
+ claims a slot with `attach` and releases it when destroyed. The segment has room for the hundreds of instances a large
+ session loads; slots that are never claimed are never touched, so they take no memory. Kernels that find no free slot
+ are counted, and the count is published with the statistics. The render thread is the only writer of a slot and only
+ does relaxed loads and stores of lock-free atomics, so publishing is wait-free. Readers may see the counters of one
+ render mixed with those of the next, which does not matter for monitoring.
+
+ If the segment cannot be created (e.g. in a sandboxed app extension) the slots live in private memory instead, and the
+ statistics are only visible within the process.
+ */
+class KernelTelemetry : NonCopyable {
+public:
+
+  /// Number of buckets in the render duration histogram: 4 per octave of nanoseconds
+  static constexpr size_t histogramSize = 128;
+
+  /// Maximum number of kernels that can publish in one segment
+  static constexpr size_t slotCount = 512;
+
+  /**
+   Statistics of one kernel as seen by a reader.
+   */
+  struct Snapshot {
+    std::string name;
+    std::string engine;
+    uint64_t renders = 0;
+    uint64_t frames = 0;
+    uint64_t deadlineMisses = 0;
+    uint64_t events = 0;
+    uint64_t lastEventsPerBlock = 0;
+    uint64_t maxEventsPerBlock = 0;
+    uint64_t nanResets = 0;
+    uint64_t reserveExhausted = 0;
+    uint64_t overflowEvents = 0;
+    uint64_t memoryBytes = 0;
+    double sampleRate = 0.0;
+    double lastMicroseconds = 0.0;
+    double maxMicroseconds = 0.0;
+    double p50Microseconds = 0.0;
+    double p90Microseconds = 0.0;
+    double p99Microseconds = 0.0;
+  };
+
+  KernelTelemetry() = default;
+
+  ~KernelTelemetry() { detach(); }
+
+  /**
+   Claim a slot in the process's segment. Allocates, so it must not be done on the render thread. Without a free slot
+   the statistics are not published, the record methods do nothing, and the kernel is counted as dropped until it
+   detaches.
+
+   @param name the name to publish the statistics under
+   @returns true if a slot was obtained
+   */
+  bool attach(std::string const& name) { return attach(name, segmentName(getpid())); }
+
+  /**
+   Claim a slot in a segment of the given name, which is created on first use and removed when the process exits.
+
+   @param name the name to publish the statistics under
+   @param segment the name of the shared memory segment
+   @returns true if a slot was obtained
+   */
+  bool attach(std::string const& name, std::string const& segment);
+
+  /**
+   Release the slot so that another kernel can use it, or stop counting the kernel as dropped.
+   */
+  void detach();
+
+  /**
+   Set the sample rate used to determine the time budget of a render.
+
+   @param sampleRate the sample rate of the audio being rendered
+   */
+  void setSampleRate(double sampleRate);
+
+  /**
+   Record the engine doing the filtering. Wait-free, so the render thread can publish changes of engine as they happen.
+
+   @param name the engine's name (up to 15 characters are published)
+   */
+  void setEngine(char const* name);
+
+  /**
+   Record the amount of memory used for rendering.
+
+   @param bytes number of bytes allocated
+   */
+  void setMemoryFootprint(uint64_t bytes);
+
+  /**
+   Record the outcome of a render callback. Wait-free.
+
+   @param nanoseconds the time spent in the callback
+   @param frameCount the number of frames rendered
+   @param eventCount the number of render events handled
+   */
+  void recordRender(uint64_t nanoseconds, uint32_t frameCount, uint32_t eventCount);
+
+  /**
+   Record that the filter had to be reset after a NaN or infinity showed up in its state. Wait-free.
+   */
+  void recordNaNReset();
+
+  /**
+   Record that a render found no sample storage of its own and the BufferPool reserve empty. Wait-free.
+   */
+  void recordReserveExhausted();
+
+  /**
+   Record render events that did not fit in the kernel's RenderEventList. Wait-free.
+
+   @param count the number of events
+   */
+  void recordEventOverflow(uint32_t count);
+
+  /// @returns true if the telemetry has a slot
+  bool attached() const { return slot_ != nullptr; }
+
+  /**
+   @param pid the process to name
+   @returns the name of the shared memory segment of a process
+   */
+  static std::string segmentName(pid_t pid);
+
+  /**
+   Read the statistics of all kernels in a process.
+
+   @param pid the process to read (may be the calling process)
+   @param snapshots set to the statistics of each kernel
+   @param dropped if not null, set to the number of kernels that found no free slot
+   @returns false if the process has no readable segment
+   */
+  static bool read(pid_t pid, std::vector<Snapshot>& snapshots, uint64_t* dropped = nullptr)
+  {
+    return read(segmentName(pid), snapshots, dropped);
+  }
+
+  /**
+   Read the statistics of all kernels in a segment.
+
+   @param segment the name of the shared memory segment
+   @param snapshots set to the statistics of each kernel
+   @param dropped if not null, set to the number of kernels that found no free slot
+   @returns false if there is no readable segment of that name
+   */
+  static bool read(std::string const& segment, std::vector<Snapshot>& snapshots, uint64_t* dropped = nullptr);
+
+  /**
+   Format statistics in the Prometheus text exposition format.
+
+   @param pid the process the statistics came from
+   @param snapshots the statistics to format
+   @param dropped the number of kernels that found no free slot
+   @returns the text
+   */
+  static std::string exposition(pid_t pid, std::vector<Snapshot> const& snapshots, uint64_t dropped = 0);
+
+  /**
+   Obtain the histogram bucket of a render duration.
+
+   @param nanoseconds the duration
+   @returns the bucket index
+   */
+  static size_t bucket(uint64_t nanoseconds);
+
+  /**
+   Obtain the largest duration that falls in a bucket.
+
+   @param index the bucket index
+   @returns the duration in nanoseconds
+   */
+  static double bucketLimit(size_t index);
+
+  /// Shared memory layouts, defined in the implementation
+  struct Slot;
+  struct Segment;
+
+private:
+  Slot* slot_ = nullptr;
+  Segment* droppedFrom_ = nullptr;
+};
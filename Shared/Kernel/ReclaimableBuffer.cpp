@@ -0,0 +1,187 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "ReclaimableBuffer.h"
+
+namespace {
+
+/**
+ The background thread that runs `maintain` on every registered buffer. It starts with the first registration and is
+ stopped when the process exits. Buffers are maintained with the lock held, so once `remove` returns the buffer is no
+ longer being touched.
+ */
+class Maintenance {
+public:
+  static Maintenance& shared()
+  {
+    static Maintenance maintenance;
+    return maintenance;
+  }
+
+  ~Maintenance()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+  }
+
+  void add(ReclaimableBuffer* buffer)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(buffer);
+    if (!thread_.joinable()) thread_ = std::thread([this] { run(); });
+  }
+
+  void remove(ReclaimableBuffer* buffer)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buffer), buffers_.end());
+  }
+
+  void wake() { wake_.notify_one(); }
+
+  void setInterval(std::chrono::milliseconds interval)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      interval_ = interval;
+    }
+    wake_.notify_one();
+  }
+
+private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      for (auto buffer : buffers_) buffer->maintain();
+      wake_.wait_for(lock, interval_);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<ReclaimableBuffer*> buffers_;
+  std::thread thread_;
+  std::chrono::milliseconds interval_{100};
+  bool stopping_ = false;
+};
+
+} // end namespace
+
+void
+ReclaimableBuffer::setMaintenanceInterval(std::chrono::milliseconds interval)
+{
+  Maintenance::shared().setInterval(interval);
+}
+
+void
+ReclaimableBuffer::configure(size_t size, size_t idleFrames)
+{
+  if (registered_) {
+    Maintenance::shared().remove(this);
+    registered_ = false;
+  }
+
+  if (storage_ != nullptr) {
+    if (reserve_) pool_.releaseReserve(storage_);
+    else pool_.release(storage_);
+  }
+  pool_.release(ready_.exchange(nullptr));
+  pool_.release(retired_.exchange(nullptr));
+  wanted_.store(false);
+  primed_.store(false);
+
+  size_ = size;
+  idleFrames_ = idleFrames;
+  storage_ = size > 0 ? pool_.acquire(size) : nullptr;
+  reserve_ = false;
+  idleCount_ = 0;
+  holding_.store(storage_ != nullptr ? Holding::own : Holding::none);
+
+  if (size > 0 && idleFrames > 0) {
+    pool_.reserveFor(size);
+    Maintenance::shared().add(this);
+    registered_ = true;
+  }
+}
+
+float*
+ReclaimableBuffer::beginRender()
+{
+  if (primed_.exchange(false, std::memory_order_relaxed)) idleCount_ = 0;
+
+  float* ready = ready_.exchange(nullptr, std::memory_order_acquire);
+  if (ready != nullptr) {
+    if (storage_ == nullptr || reserve_) {
+      if (reserve_) pool_.releaseReserve(storage_);
+      storage_ = ready;
+      reserve_ = false;
+    }
+    else {
+      // Primed while still holding storage. Hand the block back, or try again next time if the retired slot is full.
+      float* expected = nullptr;
+      if (!retired_.compare_exchange_strong(expected, ready, std::memory_order_release)) {
+        ready_.store(ready, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  if (storage_ == nullptr && size_ > 0) {
+    storage_ = pool_.acquireReserve(size_);
+    reserve_ = storage_ != nullptr;
+  }
+
+  return storage_;
+}
+
+void
+ReclaimableBuffer::endRender(size_t frameCount, bool idle)
+{
+  idleCount_ = idle ? std::min(idleCount_ + frameCount, idleFrames_) : 0;
+  bool asleep = idleFrames_ > 0 && idleCount_ == idleFrames_;
+
+  if (asleep) {
+    if (reserve_) {
+      pool_.releaseReserve(storage_);
+      storage_ = nullptr;
+      reserve_ = false;
+    }
+    else if (storage_ != nullptr) {
+      float* expected = nullptr;
+      if (retired_.compare_exchange_strong(expected, storage_, std::memory_order_release)) storage_ = nullptr;
+    }
+  }
+  else if (storage_ == nullptr || reserve_) {
+    wanted_.store(true, std::memory_order_relaxed);
+  }
+
+  holding_.store(storage_ == nullptr ? Holding::none : reserve_ ? Holding::reserve : Holding::own,
+                 std::memory_order_relaxed);
+}
+
+void
+ReclaimableBuffer::prime()
+{
+  if (size_ == 0 || holding() == Holding::own) return;
+  primed_.store(true, std::memory_order_relaxed);
+  wanted_.store(true, std::memory_order_relaxed);
+  if (registered_) Maintenance::shared().wake();
+}
+
+void
+ReclaimableBuffer::maintain()
+{
+  std::lock_guard<std::mutex> lock(maintainMutex_);
+  pool_.release(retired_.exchange(nullptr, std::memory_order_acquire));
+  if (wanted_.exchange(false, std::memory_order_relaxed) && ready_.load(std::memory_order_relaxed) == nullptr) {
+    ready_.store(pool_.acquire(size_), std::memory_order_release);
+  }
+}
@@ -0,0 +1,116 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "BufferPool.h"
+#include "NonCopyable.hpp"
+
+/**
+ Sample storage for a render thread that gives itself back to a BufferPool after a stretch of idle renders and gets
+ storage again when it is needed, without the render thread ever locking or allocating.
+
+ The render thread owns the storage and is the only one to change it. It brackets each render with `beginRender` and
+ `endRender`. Once `endRender` has seen `idleFrames` idle frames in a row it retires the storage through an atomic
+ slot, and when renders stop being idle it raises a request. A background maintenance thread shared by all instances
+ runs `maintain` periodically. That frees retired storage into the pool and answers requests with a block from the
+ pool, which the render thread installs at the start of its next render.
+
+ Until the block arrives a render borrows one from the pool's emergency reserve, whose blocks `configure` grows to fit.
+ An asleep instance borrows one only for the length of each render, so that it can keep watching its input. If the
+ reserve is empty as well `beginRender` returns null, and the caller must make do without, e.g. by using its output
+ buffers.
+ */
+class ReclaimableBuffer : NonCopyable {
+public:
+
+  /// What the render thread is holding after a render
+  enum class Holding {
+    none,
+    own,
+    reserve
+  };
+
+  /**
+   Set how often the maintenance thread looks for work. The default is every 100 ms.
+
+   @param interval the time between maintenance passes
+   */
+  static void setMaintenanceInterval(std::chrono::milliseconds interval);
+
+  /**
+   Construct new instance. Holds nothing until `configure` is called.
+
+   @param pool the pool to take storage from
+   */
+  explicit ReclaimableBuffer(BufferPool& pool = BufferPool::shared()) : pool_{pool} {}
+
+  ~ReclaimableBuffer() { configure(0, 0); }
+
+  /**
+   Give back all storage and then take `size` samples of new storage, making sure the pool's reserve blocks can hold
+   as much. Must not be done while rendering.
+
+   @param size the number of samples to hold (0 to hold nothing)
+   @param idleFrames the number of idle frames in a row after which the storage is given back (0 to keep it)
+   */
+  void configure(size_t size, size_t idleFrames);
+
+  /**
+   Obtain the storage to use for a render. Render thread only; lock-free and does not allocate.
+
+   @returns the storage for `size` samples, or null if there is none
+   */
+  float* beginRender();
+
+  /**
+   Finish a render. Render thread only; lock-free and does not allocate.
+
+   @param frameCount the number of frames rendered
+   @param idle true if nothing was heard in the render, e.g. because the input was silent or the kernel bypassed
+   */
+  void endRender(size_t frameCount, bool idle);
+
+  /**
+   Ask for storage ahead of need, e.g. when bypass is turned off. Safe on any thread except the render thread, which
+   would block waking the maintenance thread.
+   */
+  void prime();
+
+  /**
+   Free retired storage and answer requests. Done periodically by the maintenance thread, but any other thread apart
+   from the render thread may call it too.
+   */
+  void maintain();
+
+  /// @returns what the render thread held after its last render
+  Holding holding() const { return holding_.load(std::memory_order_relaxed); }
+
+  /// @returns the number of samples held
+  size_t size() const { return size_; }
+
+  /// @returns the number of idle frames in a row after which the storage is given back (0 if never)
+  size_t idleFrames() const { return idleFrames_; }
+
+private:
+  BufferPool& pool_;
+  size_t size_ = 0;
+  size_t idleFrames_ = 0;
+  bool registered_ = false;
+  std::mutex maintainMutex_;
+
+  // Render thread state
+  float* storage_ = nullptr;
+  bool reserve_ = false;
+  size_t idleCount_ = 0;
+
+  std::atomic<float*> ready_{nullptr};
+  std::atomic<float*> retired_{nullptr};
+  std::atomic<bool> wanted_{false};
+  std::atomic<bool> primed_{false};
+  std::atomic<Holding> holding_{Holding::none};
+};
@@ -0,0 +1,71 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+
+#include "RenderEventList.h"
+
+void
+RenderEventList::assign(AURenderEvent const* events, AUEventSampleTime start, AUAudioFrameCount frameCount)
+{
+  auto const end = start + AUEventSampleTime(frameCount);
+  start_ = start;
+  end_ = end;
+  size_ = 0;
+  clamped_ = 0;
+  superseded_ = 0;
+
+  // Copy and clamp. Insertion sort keeps equal times in the host's order and costs one comparison per event when the
+  // host sends them sorted, as it should.
+  auto event = events;
+  for (; event != nullptr && size_ < entries_.size(); event = event->head.next) {
+    auto time = event->head.eventSampleTime;
+    if (time < start || time > end) {
+      time = time < start ? start : end;
+      ++clamped_;
+    }
+
+    size_t index = size_;
+    while (index > 0 && entries_[index - 1].time > time) {
+      entries_[index] = entries_[index - 1];
+      --index;
+    }
+    entries_[index] = {time, event};
+    ++size_;
+  }
+  overflow_ = event;
+
+  // Drop parameter changes overridden by a later one to the same address at the same time
+  size_t kept = 0;
+  for (size_t index = 0; index < size_; ++index) {
+    auto const& entry = entries_[index];
+    bool overridden = false;
+    if (isParameterChange(entry.event)) {
+      for (size_t later = index + 1; later < size_ && entries_[later].time == entry.time; ++later) {
+        auto other = entries_[later].event;
+        if (isParameterChange(other) && other->parameter.parameterAddress == entry.event->parameter.parameterAddress) {
+          overridden = true;
+          break;
+        }
+      }
+    }
+
+    if (overridden) ++superseded_;
+    else entries_[kept++] = entry;
+  }
+  size_ = kept;
+}
+
+bool
+RenderEventList::overridden(AURenderEvent const* event) const
+{
+  if (!isParameterChange(event)) return false;
+
+  // The entries are sorted by time, so the ones that come after the event are at the end. At the same time the event
+  // comes later in the host's order and wins.
+  auto time = std::min(std::max(event->head.eventSampleTime, start_), end_);
+  for (size_t index = size_; index > 0 && entries_[index - 1].time > time; --index) {
+    auto other = entries_[index - 1].event;
+    if (isParameterChange(other) && other->parameter.parameterAddress == event->parameter.parameterAddress) return true;
+  }
+  return false;
+}
@@ -0,0 +1,90 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <AudioToolbox/AudioToolbox.h>
+
+/**
+ Sanitized copy of the render events of one render call. Hosts are supposed to send events sorted by sample time and
+ within the render, but misbehaving ones send them out of order, late, past the end of the render or several times
+ over. Rendering straight from such a list splits the render into needless (even empty) segments and applies parameter
+ changes in the wrong order.
+
+ `assign` copies the list into a fixed-capacity array, moves late events to the start of the render and early ones to
+ its end, sorts them by time keeping the host's order for equal times, and drops parameter changes that a later change
+ to the same address at the same time overrides. It neither locks nor allocates, so it is safe on the render thread.
+
+ Events beyond the capacity are not copied. They are left in `overflow` for the caller to deal with, and `overridden`
+ tells which of them would undo a later change in the list.
+ */
+class RenderEventList {
+public:
+
+  /// Default number of events kept per render
+  static constexpr size_t defaultCapacity = 256;
+
+  /**
+   An event and the sample time at which to apply it.
+   */
+  struct Entry {
+    AUEventSampleTime time;
+    AURenderEvent const* event;
+  };
+
+  /**
+   Allocate room for events. Must not be done on the render thread.
+
+   @param capacity the number of events to keep per render
+   */
+  void allocate(size_t capacity = defaultCapacity) { entries_.resize(capacity); }
+
+  /**
+   Replace the contents with the sanitized events of a render. Does not allocate.
+
+   @param events the first event sent by the host (may be null)
+   @param start the sample time of the first frame of the render
+   @param frameCount the number of frames in the render
+   */
+  void assign(AURenderEvent const* events, AUEventSampleTime start, AUAudioFrameCount frameCount);
+
+  /// @returns the number of events to apply
+  size_t size() const { return size_; }
+
+  /// @returns the entry at the given index, in order of time
+  Entry const& operator[](size_t index) const { return entries_[index]; }
+
+  /// @returns the first event that did not fit, or null if all did
+  AURenderEvent const* overflow() const { return overflow_; }
+
+  /**
+   Determine if an event that did not fit would undo a change in the list, i.e. it is a parameter change and the list
+   holds a change to the same address at a later time. Applying it after the render would leave the wrong value.
+   Looks only at the entries after the event's time, so it is cheap for the late events that usually overflow.
+
+   @param event an event from the `overflow` chain
+   @returns true if the event should not be applied
+   */
+  bool overridden(AURenderEvent const* event) const;
+
+  /// @returns the number of events moved to the start or end of the render by the last `assign`
+  size_t clamped() const { return clamped_; }
+
+  /// @returns the number of parameter changes dropped by the last `assign` because a later one overrode them
+  size_t superseded() const { return superseded_; }
+
+private:
+  static bool isParameterChange(AURenderEvent const* event)
+  {
+    return event->head.eventType == AURenderEventParameter || event->head.eventType == AURenderEventParameterRamp;
+  }
+
+  std::vector<Entry> entries_;
+  size_t size_ = 0;
+  size_t clamped_ = 0;
+  size_t superseded_ = 0;
+  AUEventSampleTime start_ = 0;
+  AUEventSampleTime end_ = 0;
+  AURenderEvent const* overflow_ = nullptr;
+};
@@ -0,0 +1,184 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "SampleRateConverter.h"
+#include "SIMDMath.hpp"
+
+using namespace SIMDMath;
+
+namespace {
+
+constexpr size_t laneCount = Traits<Native>::width;
+
+/// Number of input samples per channel that are converted at a time
+constexpr size_t chunkSize = 1024;
+
+/// Largest up or down factor accepted, which bounds the size of the prototype filter
+constexpr size_t maxFactor = 1024;
+
+/// Stopband attenuation of the prototype in dB
+constexpr double attenuation = 80.0;
+
+size_t gcd(size_t a, size_t b)
+{
+  while (b != 0) {
+    auto t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/// Modified Bessel function of the first kind, order 0, from its power series.
+double besselI0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  double half = 0.5 * x;
+  for (int k = 1; term > 1e-12 * sum; ++k) {
+    term *= (half / k) * (half / k);
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ Calculate the dot product of filter taps and samples a vector at a time.
+
+ @param taps the filter coefficients
+ @param samples the samples to multiply, oldest first
+ @param count the number of taps, a multiple of the vector width
+ @returns the sum of the products
+ */
+inline float dot(float const* taps, float const* samples, size_t count)
+{
+  Native sum = {};
+  for (size_t index = 0; index < count; index += laneCount) {
+    sum += load<Native>(taps + index) * load<Native>(samples + index);
+  }
+
+  float total = 0.0f;
+  for (size_t lane = 0; lane < laneCount; ++lane) total += sum[lane];
+  return total;
+}
+
+} // end namespace
+
+bool
+SampleRateConverter::configure(double inputRate, double outputRate, size_t numChannels, size_t length)
+{
+  if (!(inputRate >= 1.0 && outputRate >= 1.0) || inputRate != std::floor(inputRate) ||
+      outputRate != std::floor(outputRate) || numChannels == 0 || length == 0) return false;
+
+  auto input = size_t(inputRate);
+  auto output = size_t(outputRate);
+  auto divisor = gcd(input, output);
+  if (output / divisor > maxFactor || input / divisor > maxFactor) return false;
+
+  up_ = output / divisor;
+  down_ = input / divisor;
+  numChannels_ = numChannels;
+  designPhases(length);
+  history_.assign(numChannels_ * (taps_ - 1 + chunkSize), 0.0f);
+  resetState();
+  return true;
+}
+
+void
+SampleRateConverter::designPhases(size_t length)
+{
+  // The prototype runs at L times the input rate. It spans `length` samples of the lower rate, and its stopband starts
+  // at the lower Nyquist frequency so that nothing images or aliases into the output.
+  size_t widest = std::max(up_, down_);
+  taps_ = (length * widest + up_ - 1) / up_;
+  taps_ = (taps_ + laneCount - 1) / laneCount * laneCount;
+  size_t size = taps_ * up_;
+
+  double band = 0.5 / widest;
+  double beta = 0.1102 * (attenuation - 8.7);
+  double transition = (attenuation - 8.0) / (2.285 * 2.0 * M_PI * (size - 1));
+  double cutoff = band - 0.5 * transition;
+  double center = 0.5 * (size - 1);
+  double scale = besselI0(beta);
+
+  std::vector<double> prototype(size);
+  for (size_t index = 0; index < size; ++index) {
+    double t = index - center;
+    double ratio = t / (center + 0.5);
+    double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / scale;
+    double x = 2.0 * M_PI * cutoff * t;
+    prototype[index] = (x == 0.0 ? 1.0 : std::sin(x) / x) * window;
+  }
+
+  // Phase p holds taps p, p + L, p + 2L, ... reversed so that they line up with the samples oldest first. Each phase is
+  // normalized to unity gain at DC so that a constant input gives a constant output.
+  phases_.assign(size, 0.0f);
+  for (size_t phase = 0; phase < up_; ++phase) {
+    double sum = 0.0;
+    for (size_t tap = 0; tap < taps_; ++tap) sum += prototype[phase + tap * up_];
+    for (size_t tap = 0; tap < taps_; ++tap) {
+      phases_[phase * taps_ + taps_ - 1 - tap] = float(prototype[phase + tap * up_] / sum);
+    }
+  }
+}
+
+size_t
+SampleRateConverter::outputFrameCount(size_t inputFrameCount) const
+{
+  size_t position = index_ * up_ + phase_;
+  size_t end = inputFrameCount * up_;
+  return position < end ? (end - position + down_ - 1) / down_ : 0;
+}
+
+size_t
+SampleRateConverter::process(float const* const* ins, float* const* outs, size_t inputFrameCount)
+{
+  assert(numChannels_ > 0);
+  size_t const kept = taps_ - 1;
+  size_t const span = kept + chunkSize;
+  size_t produced = 0;
+
+  for (size_t offset = 0; offset < inputFrameCount; offset += chunkSize) {
+    size_t count = std::min(chunkSize, inputFrameCount - offset);
+    for (size_t channel = 0; channel < numChannels_; ++channel) {
+      memcpy(history_.data() + channel * span + kept, ins[channel] + offset, count * sizeof(float));
+    }
+
+    // Sample i of the chunk is at `kept + i` in the history, so the window that ends with it starts at i.
+    size_t index = index_;
+    size_t phase = phase_;
+    size_t outputs = 0;
+    while (index < count) {
+      float const* taps = phases_.data() + phase * taps_;
+      for (size_t channel = 0; channel < numChannels_; ++channel) {
+        outs[channel][produced + outputs] = dot(taps, history_.data() + channel * span + index, taps_);
+      }
+      ++outputs;
+      phase += down_;
+      index += phase / up_;
+      phase %= up_;
+    }
+
+    for (size_t channel = 0; channel < numChannels_; ++channel) {
+      float* history = history_.data() + channel * span;
+      memmove(history, history + count, kept * sizeof(float));
+    }
+
+    index_ = index - count;
+    phase_ = phase;
+    produced += outputs;
+  }
+
+  return produced;
+}
+
+void
+SampleRateConverter::resetState()
+{
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  index_ = 0;
+  phase_ = 0;
+}
@@ -0,0 +1,111 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/**
+ Streaming polyphase sample-rate converter for rational ratios such as 44.1 kHz <-> 48 kHz (160/147) or 2x and 4x up
+ and down sampling. The rates are reduced to an up factor L and a down factor M, and a low-pass prototype filter that
+ runs at L times the input rate removes both the images of upsampling and what would alias when decimating. Only the
+ outputs that are kept are calculated: each one is the dot product of the latest input samples with one of the L
+ phases of the prototype, done a `SIMDMath::Native` vector of taps at a time.
+
+ The prototype is a Kaiser-windowed sinc. A biquad such as BiquadFilter::lowPass cannot be used here since a recursive
+ filter must calculate every sample at the high rate, which is what the polyphase split avoids; its phase distortion
+ would also differ between the L phases.
+
+ Input may arrive in blocks of any size. The converter keeps the last input samples of each channel and its position
+ between the input samples, so converting a signal in pieces gives exactly the same output as converting it at once.
+ */
+class SampleRateConverter {
+public:
+
+  /**
+   Configure the converter and clear its state. Allocates memory so it must not be done on the render thread.
+
+   @param inputRate the sample rate of the input in Hz
+   @param outputRate the sample rate of the output in Hz
+   @param numChannels the number of channels to convert
+   @param length the length of the prototype filter in samples of the lower of the two rates. Longer filters have a
+   narrower transition band, so more of the band below the lower Nyquist frequency passes, and cost proportionally more.
+   With the default, frequencies up to about 85% of the lower Nyquist frequency pass within 0.01 dB, and everything
+   above the lower Nyquist frequency is at least 80 dB down.
+   @returns false if the rates are not positive whole numbers whose reduced ratio has factors no larger than 1024
+   */
+  bool configure(double inputRate, double outputRate, size_t numChannels, size_t length = 64);
+
+  /**
+   Obtain the number of output samples that the next `process` call will produce for a given number of input samples.
+
+   @param inputFrameCount the number of input samples per channel
+   @returns the number of output samples per channel
+   */
+  size_t outputFrameCount(size_t inputFrameCount) const;
+
+  /**
+   Convert a block of samples from each channel. Does not allocate.
+
+   @param ins array of pointers to the first input sample of each channel
+   @param outs array of pointers to where to store the first output sample of each channel, each with room for
+   `outputFrameCount(inputFrameCount)` samples
+   @param inputFrameCount the number of input samples per channel
+   @returns the number of output samples stored per channel
+   */
+  size_t process(float const* const* ins, float* const* outs, size_t inputFrameCount);
+
+  /**
+   Convert a block of samples from each channel.
+
+   @param ins the array of input samples to convert
+   @param outs the storage for the results
+   @param inputFrameCount the number of input samples per channel
+   @returns the number of output samples stored per channel
+   */
+  size_t process(std::vector<float const*> const& ins, std::vector<float*>& outs, size_t inputFrameCount)
+  {
+    assert(numChannels_ == ins.size() && numChannels_ == outs.size());
+    return process(ins.data(), outs.data(), inputFrameCount);
+  }
+
+  /**
+   Forget past input so that the next sample is converted as if only silence had come before.
+   */
+  void resetState();
+
+  /// @returns the interpolation factor L of the reduced ratio
+  size_t upFactor() const { return up_; }
+
+  /// @returns the decimation factor M of the reduced ratio
+  size_t downFactor() const { return down_; }
+
+  /// @returns the number of taps in each phase of the prototype filter, a multiple of the SIMD width
+  size_t tapsPerPhase() const { return taps_; }
+
+  /// @returns the number of channels the converter was configured for
+  size_t numChannels() const { return numChannels_; }
+
+  /// @returns the delay of the converter in input samples: an input at time t appears in the output at t + latency
+  double latency() const { return (double(taps_ * up_) - 1.0) / (2.0 * up_); }
+
+private:
+  void designPhases(size_t length);
+
+  size_t up_ = 1;
+  size_t down_ = 1;
+  size_t taps_ = 0;
+  size_t numChannels_ = 0;
+
+  /// Position of the next output between the input samples, in steps of 1/L. `index_` counts input samples from the
+  /// start of the next block (the most recent kept sample is -1).
+  size_t index_ = 0;
+  size_t phase_ = 0;
+
+  /// The L phases of the prototype, each holding `taps_` coefficients in the order of the samples they multiply
+  std::vector<float> phases_;
+
+  /// Per channel, `taps_ - 1` samples of past input followed by room for `chunkSize` new ones
+  std::vector<float> history_;
+};
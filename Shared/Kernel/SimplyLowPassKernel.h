@@ -4,8 +4,10 @@
 #pragma once
 
 #import <AVFoundation/AVFoundation.h>
+#import <atomic>
 
 #import "BiquadFilter.h"
+#import "BiquadPlanner.h"
 #import "SimplyLowPassKernelAdapter.h"
 #import "KernelEventProcessor.h"
 
@@ -14,23 +16,44 @@ public:
   using super = KernelEventProcessor<SimplyLowPassKernel>;
   friend super;
   
+  /**
+   Construct new instance. Hosts create many instances when loading a session, so this does no DSP setup: the filter
+   is only configured in `startProcessing` once the format is known.
+
+   @param name the name to log and publish telemetry under
+   */
   SimplyLowPassKernel(std::string const& name)
-  : super(os_log_create(name.c_str(), "SimplyLowPassKernel")), cutoff_{float(400.0)}, resonance_{20.0}
-  {
-    setSampleRate(44100.0);
-    filter_.calculateParams(cutoff_, resonance_, nyquistPeriod_, 2);
-  }
+  : super(sharedLog(name)), name_{name}, cutoff_{float(400.0)}, resonance_{20.0}
+  {}
   
   /**
-   Update kernel and buffers to support the given format and channel count
+   Update kernel and buffers to support the given format and channel count, pick the fastest filter engine for them
+   (unless deterministic rendering is on), and configure the filter so that the first render does not have to.
    */
   void startProcessing(AVAudioFormat* format, AUAudioFrameCount maxFramesToRender)
   {
+    // Attach first: the base class publishes the sample rate, which sets the deadline that renders are judged by.
+    if (!telemetry_.attached()) telemetry_.attach(name_);
     super::startProcessing(format, maxFramesToRender);
     setSampleRate(format.sampleRate);
+    filter_.setEngine(deterministic_ ? BiquadFilter::Engine::deterministic
+                      : BiquadPlanner::shared().plan(format.channelCount, maxFramesToRender));
+    filter_.calculateParams(cutoff_, resonance_, nyquistPeriod_, format.channelCount);
+    channelCount_ = format.channelCount;
+    maxFramesToRender_ = maxFramesToRender;
+    publishedEngine_.store(filter_.activeEngine(), std::memory_order_relaxed);
+    telemetry_.setEngine(BiquadPlanner::engineName(filter_.activeEngine()));
   }
   
   void stopProcessing() { super::stopProcessing(); }
+
+  /**
+   Render with output that is bit-identical on every machine and however a render is divided, at some cost in speed
+   (see BiquadPlanner::writeProfiles). Takes effect at the next `startProcessing`.
+
+   @param state true to render deterministically
+   */
+  void setDeterministic(bool state) { deterministic_ = state; }
   
   void setParameterValue(AUParameterAddress address, AUValue value)
   {
@@ -62,6 +85,19 @@ public:
     }
   }
   
+  /**
+   Predict the cost of rendering with the configuration from the last `startProcessing` call and the engine doing the
+   filtering as of the last render, using the costs measured on this machine by BiquadPlanner. May measure, so it must
+   not be called on the render thread.
+
+   @returns expected time per sample of each channel in nanoseconds, or 0 if processing has not started
+   */
+  double predictedNanosecondsPerSample() const {
+    if (channelCount_ == 0) return 0.0;
+    return BiquadPlanner::shared().predict(publishedEngine_.load(std::memory_order_relaxed), channelCount_,
+                                           maxFramesToRender_);
+  }
+
   float nyquistPeriod() const { return nyquistPeriod_; }
   float cutoff() const { return cutoff_; }
   float resonance() const { return resonance_; }
@@ -73,21 +109,80 @@ private:
   void doRendering(const std::vector<float const*>& ins, std::vector<float*>& outs, AUAudioFrameCount frameCount) {
     filter_.calculateParams(cutoff_, resonance_, nyquistPeriod_, ins.size());
     filter_.apply(ins, outs, frameCount);
+    checkFilterState(ins.size());
+    publishEngine();
+  }
+
+  bool canLinkChannels() const { return filter_.canLink(); }
+
+  bool doLinkedRendering(const std::vector<float const*>& ins, std::vector<float*>& outs,
+                         AUAudioFrameCount frameCount) {
+    filter_.calculateParams(cutoff_, resonance_, nyquistPeriod_, ins.size());
+    if (!filter_.applyLinked(ins[0], outs[0], 1, frameCount)) return false;
+    checkFilterState(1);
+    publishEngine();
+    return true;
+  }
+
+  /**
+   Publish the engine doing the filtering when it changes. It differs from the selected one for low cutoffs and while
+   the portable engine stands in for Accelerate.
+   */
+  void publishEngine() {
+    auto engine = filter_.activeEngine();
+    if (engine == publishedEngine_.load(std::memory_order_relaxed)) return;
+    publishedEngine_.store(engine, std::memory_order_relaxed);
+    telemetry_.setEngine(BiquadPlanner::engineName(engine));
+  }
+
+  /**
+   A NaN or infinity that reaches the filter's feedback path stays there forever, silencing the output. Detect this
+   and start the filter over.
+
+   @param numChannels the number of channels to check
+   */
+  void checkFilterState(size_t numChannels) {
+    for (size_t channel = 0; channel < numChannels; ++channel) {
+      auto state = filter_.getState(channel);
+      if (!std::isfinite(state.y1) || !std::isfinite(state.y2)) {
+        os_log_with_type(log_, OS_LOG_TYPE_ERROR, "resetting filter after non-finite output");
+        filter_.resetState();
+        telemetry_.recordNaNReset();
+        return;
+      }
+    }
   }
   
   void doMIDIEvent(AUMIDIEvent const& midiEvent) {}
   
+  /**
+   All kernels in a process share one log, named after the first kernel created, instead of each making its own.
+
+   @param name the subsystem name to use for the log
+   @returns the log to use
+   */
+  static os_log_t sharedLog(std::string const& name) {
+    static os_log_t log = os_log_create(name.c_str(), "SimplyLowPassKernel");
+    return log;
+  }
+
   void setSampleRate(float value) {
     sampleRate_ = value;
     nyquistFrequency_ = 0.5 * sampleRate_;
     nyquistPeriod_ = 1.0 / nyquistFrequency_;
   }
   
+  std::string name_;
   BiquadFilter filter_;
+  /// The engine doing the filtering as of the last render, for other threads to see
+  std::atomic<BiquadFilter::Engine> publishedEngine_{BiquadFilter::Engine::accelerate};
+  size_t channelCount_ = 0;
+  AUAudioFrameCount maxFramesToRender_ = 0;
+  bool deterministic_ = false;
   
-  float sampleRate_;
-  float nyquistFrequency_;
-  float nyquistPeriod_;
+  float sampleRate_ = 44100.0;
+  float nyquistFrequency_ = 0.5 * 44100.0;
+  float nyquistPeriod_ = 1.0 / (0.5 * 44100.0);
   
   float cutoff_;
   float resonance_;
@@ -74,6 +74,30 @@ pullInputBlock:(nonnull AURenderPullInputBlock)pullInputBlock;
  */
 - (void)magnitudes:(nonnull const float*)frequencies count:(NSInteger)count output:(nonnull float*)output;
 
+/**
+ Predict the CPU cost of rendering with the current format and maximum frame count, as measured on this machine. Hosts
+ can use this to place instances on cores before rendering starts. Do not call from the render thread.
+
+ @returns expected nanoseconds per sample of each channel, or 0 if processing has not started
+ */
+- (double)predictedNanosecondsPerSample;
+
+/**
+ Render bit-identical output on every machine, for offline renders that must be reproducible. Slower than the default.
+ Takes effect when rendering next starts.
+
+ @param state true to render deterministically
+ */
+- (void)setDeterministic:(BOOL)state;
+
+/**
+ Set how long the kernel must be bypassed or silent before it gives its input buffers back to a pool shared by all
+ instances, which saves memory in large sessions. Takes effect when rendering next starts.
+
+ @param seconds the idle time after which buffers are given back, or 0 to always keep them
+ */
+- (void)setIdleTimeout:(double)seconds;
+
 /**
  Set the bypass state.
  
@@ -2,6 +2,7 @@
 // Original: See LICENSE folder for this sample’s licensing information.
 
 #import "BiquadFilter.h"
+#import "BiquadPlanner.h"
 #import "SimplyLowPassKernel.h"
 #import "SimplyLowPassKernelAdapter.h"
 
@@ -11,6 +12,14 @@
 
 - (instancetype)init:(NSString*)appExtensionName {
   if (self = [super init]) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+      NSURL* caches = [NSFileManager.defaultManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask]
+      .firstObject;
+      if (caches != nil) {
+        BiquadPlanner::shared().setWisdomPath([caches URLByAppendingPathComponent:@"BiquadWisdom.txt"].path.UTF8String);
+      }
+    });
     self->kernel_ = new SimplyLowPassKernel(std::string(appExtensionName.UTF8String));
   }
   return self;
@@ -45,6 +54,18 @@
   return kernel_->processAndRender(timestamp, frameCount, inputBus, output, realtimeEventListHead, pullInputBlock);
 }
 
+- (double)predictedNanosecondsPerSample {
+  return kernel_->predictedNanosecondsPerSample();
+}
+
+- (void)setDeterministic:(BOOL)state {
+  kernel_->setDeterministic(state);
+}
+
+- (void)setIdleTimeout:(double)seconds {
+  kernel_->setIdleTimeout(seconds);
+}
+
 - (void)setBypass:(BOOL)state {
   kernel_->setBypass(state);
 }
@@ -0,0 +1,143 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#include <algorithm>
+#include <cmath>
+
+#include "BiquadFilter.h"
+#include "SIMDMath.hpp"
+#include "Vocoder.h"
+
+using namespace SIMDMath;
+
+namespace {
+
+enum Coefficient { B0 = 0, A1, A2, CoefficientCount };
+enum State { ModulatorS1 = 0, ModulatorS2, CarrierS1, CarrierS2, Envelope, StateCount };
+
+constexpr size_t laneCount = Traits<Native>::width;
+
+/// Number of samples whose mixed band outputs are held in vectors before being summed across lanes
+constexpr size_t chunkSize = 64;
+
+/// @returns the coefficient of a one-pole smoother that gets 63% of the way to its target in `seconds`
+float smoothing(float seconds, double sampleRate)
+{
+  return seconds > 0.0f ? float(1.0 - std::exp(-1.0 / (seconds * sampleRate))) : 1.0f;
+}
+
+} // end namespace
+
+size_t
+Vocoder::width()
+{
+  return laneCount;
+}
+
+void
+Vocoder::configure(size_t numChannels, size_t bandCount, float lowFrequency, float highFrequency, double sampleRate)
+{
+  numChannels_ = numChannels;
+  numBands_ = bandCount;
+  numGroups_ = (numBands_ + laneCount - 1) / laneCount;
+  sampleRate_ = sampleRate;
+
+  // Neighboring bands cross at their -3 dB points when the bandwidth in octaves equals the spacing between centers.
+  double ratio = numBands_ > 1 ? std::pow(double(highFrequency) / lowFrequency, 1.0 / (numBands_ - 1)) : 2.0;
+  float q = float(std::sqrt(ratio) / (ratio - 1.0));
+  float nyquistPeriod = float(2.0 / sampleRate);
+
+  frequencies_.resize(numBands_);
+  coefficients_.assign(numGroups_ * CoefficientCount * laneCount, 0.0f);
+  for (size_t band = 0; band < numBands_; ++band) {
+    frequencies_[band] = float(lowFrequency * std::pow(ratio, double(band)));
+    auto coefficients = BiquadFilter::bandPass(frequencies_[band], q, nyquistPeriod);
+    float* group = coefficients_.data() + band / laneCount * CoefficientCount * laneCount + band % laneCount;
+    group[B0 * laneCount] = coefficients.b0;
+    group[A1 * laneCount] = coefficients.a1;
+    group[A2 * laneCount] = coefficients.a2;
+  }
+
+  states_.assign(numChannels_ * numGroups_ * StateCount * laneCount, 0.0f);
+}
+
+void
+Vocoder::setEnvelopeTimes(float attack, float release)
+{
+  attack_ = attack;
+  release_ = release;
+}
+
+void
+Vocoder::process(float const* const* modulators, float const* const* carriers, float* const* outs,
+                 size_t frameCount)
+{
+  Native const attack = splat<Native>(smoothing(attack_, sampleRate_));
+  Native const release = splat<Native>(smoothing(release_, sampleRate_));
+
+  for (size_t channel = 0; channel < numChannels_; ++channel) {
+    float const* modulator = modulators[channel];
+    float const* carrier = carriers[channel];
+    float* out = outs[channel];
+    float* channelState = states_.data() + channel * numGroups_ * StateCount * laneCount;
+
+    for (size_t offset = 0; offset < frameCount; offset += chunkSize) {
+      size_t const count = std::min(chunkSize, frameCount - offset);
+      Native mix[chunkSize] = {};
+
+      for (size_t group = 0; group < numGroups_; ++group) {
+        float const* coefficients = coefficients_.data() + group * CoefficientCount * laneCount;
+        float* state = channelState + group * StateCount * laneCount;
+        Native const b0 = load<Native>(coefficients + B0 * laneCount);
+        Native const a1 = load<Native>(coefficients + A1 * laneCount);
+        Native const a2 = load<Native>(coefficients + A2 * laneCount);
+        Native m1 = load<Native>(state + ModulatorS1 * laneCount);
+        Native m2 = load<Native>(state + ModulatorS2 * laneCount);
+        Native c1 = load<Native>(state + CarrierS1 * laneCount);
+        Native c2 = load<Native>(state + CarrierS2 * laneCount);
+        Native envelope = load<Native>(state + Envelope * laneCount);
+
+        for (size_t index = 0; index < count; ++index) {
+          // Transposed direct form II with b1 = 0 and b2 = -b0
+          Native x = b0 * modulator[offset + index];
+          Native y = x + m1;
+          m1 = m2 - a1 * y;
+          m2 = -x - a2 * y;
+
+          Native level = Detail::abs(y);
+          envelope += Detail::select<Native>(level > envelope, attack, release) * (level - envelope);
+
+          x = b0 * carrier[offset + index];
+          y = x + c1;
+          c1 = c2 - a1 * y;
+          c2 = -x - a2 * y;
+          mix[index] += y * envelope;
+        }
+
+        store(state + ModulatorS1 * laneCount, m1);
+        store(state + ModulatorS2 * laneCount, m2);
+        store(state + CarrierS1 * laneCount, c1);
+        store(state + CarrierS2 * laneCount, c2);
+        store(state + Envelope * laneCount, envelope);
+      }
+
+      for (size_t index = 0; index < count; ++index) {
+        float sum = 0.0f;
+        for (size_t lane = 0; lane < laneCount; ++lane) sum += mix[index][lane];
+        out[offset + index] = sum;
+      }
+    }
+  }
+}
+
+void
+Vocoder::resetState()
+{
+  std::fill(states_.begin(), states_.end(), 0.0f);
+}
+
+float
+Vocoder::envelope(size_t channel, size_t band) const
+{
+  assert(channel < numChannels_ && band < numBands_);
+  return states_[((channel * numGroups_ + band / laneCount) * StateCount + Envelope) * laneCount + band % laneCount];
+}
@@ -0,0 +1,110 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/**
+ Channel vocoder. A bank of band-pass filters splits the modulator (usually a voice) into bands whose levels are
+ tracked by envelope followers, and a matching bank splits the carrier (usually a synth). The output is the sum of the
+ carrier bands, each scaled by the level of the same band of the modulator.
+
+ The bands come from BiquadFilter::bandPass and are processed as structure of arrays: each `SIMDMath::Native` vector
+ holds the state of as many bands (4, or 8 with AVX), so one pass over a block runs a whole bank of 16 or 32 bands at a
+ few vectors per sample. The modulator and carrier banks run in the same pass and the band outputs are mixed without
+ ever being stored.
+ */
+class Vocoder {
+public:
+
+  /// @returns the number of bands that are processed together
+  static size_t width();
+
+  /**
+   Configure the filter banks and clear all state. Band centers are spaced evenly on a log scale from `lowFrequency`
+   to `highFrequency`, and each band is as wide as the spacing. Allocates memory so it must not be done on the render
+   thread.
+
+   @param numChannels the number of channels to process; each has its own modulator and carrier
+   @param bandCount the number of bands in each bank
+   @param lowFrequency the center of the lowest band in Hz
+   @param highFrequency the center of the highest band in Hz
+   @param sampleRate the sample rate in Hz
+   */
+  void configure(size_t numChannels, size_t bandCount, float lowFrequency, float highFrequency, double sampleRate);
+
+  /**
+   Set how quickly the band levels follow the modulator. The defaults are 5 ms and 50 ms. Does not allocate.
+
+   @param attack time in seconds for a band level to rise most of the way (63%) to a louder modulator
+   @param release time in seconds for a band level to fall most of the way to a quieter modulator
+   */
+  void setEnvelopeTimes(float attack, float release);
+
+  /**
+   Process a block of samples. Outputs may be the same buffers as either input.
+
+   @param modulators array of pointers to the first modulator sample of each channel
+   @param carriers array of pointers to the first carrier sample of each channel
+   @param outs array of pointers to where to store the first output sample of each channel
+   @param frameCount the number of samples to process in each channel
+   */
+  void process(float const* const* modulators, float const* const* carriers, float* const* outs, size_t frameCount);
+
+  /**
+   Process a block of samples.
+
+   @param modulators the modulator samples of each channel
+   @param carriers the carrier samples of each channel
+   @param outs the storage for the results
+   @param frameCount the number of samples to process in each channel
+   */
+  void process(std::vector<float const*> const& modulators, std::vector<float const*> const& carriers,
+               std::vector<float*>& outs, size_t frameCount)
+  {
+    assert(numChannels_ == modulators.size() && numChannels_ == carriers.size() && numChannels_ == outs.size());
+    process(modulators.data(), carriers.data(), outs.data(), frameCount);
+  }
+
+  /**
+   Clear the filter and envelope state so that processing starts over from silence.
+   */
+  void resetState();
+
+  /**
+   Obtain the current level of a modulator band.
+
+   @param channel the channel to query
+   @param band the band to query, 0 being the lowest
+   @returns the envelope follower value of the band
+   */
+  float envelope(size_t channel, size_t band) const;
+
+  /// @returns the center frequency of a band in Hz
+  float bandFrequency(size_t band) const { return frequencies_[band]; }
+
+  /// @returns the number of bands in each bank
+  size_t numBands() const { return numBands_; }
+
+  /// @returns the number of channels the vocoder was configured for
+  size_t numChannels() const { return numChannels_; }
+
+private:
+  size_t numChannels_ = 0;
+  size_t numBands_ = 0;
+  size_t numGroups_ = 0;
+  double sampleRate_ = 44100.0;
+  float attack_ = 0.005f;
+  float release_ = 0.05f;
+
+  std::vector<float> frequencies_;
+
+  /// Band-pass coefficients for each group as 3 vectors of `width()` values (b0, a1, a2); b1 is 0 and b2 is -b0.
+  /// Unused lanes have all coefficients 0 and stay silent.
+  std::vector<float> coefficients_;
+
+  /// State for each channel and group as 5 vectors: modulator s1 and s2, carrier s1 and s2, and envelope.
+  std::vector<float> states_;
+};
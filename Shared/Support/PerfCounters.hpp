@@ -0,0 +1,160 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "NonCopyable.hpp"
+
+/**
+ Hardware performance counters for the calling thread, read through `perf_event_open` on Linux. Wall-clock times say
+ that something is slow; these say why -- few instructions per cycle with many cache misses points at memory, many
+ instructions at compute, and floating-point assists at denormals.
+
+ Each counter is opened on its own so that a counter the CPU or kernel does not offer (or a sandbox that forbids
+ them all) only removes that counter. Counts are scaled when the kernel had to multiplex counters. On other platforms
+ nothing is available and `stop` returns invalid values.
+
+ Floating-point assists have no generic perf event. Set the environment variable `LPF_PERF_FP_ASSIST_EVENT` to the raw
+ event code for the host CPU (for example `0x1eca`, FP_ASSIST.ANY on Intel Skylake) to count them.
+ */
+class PerfCounters : NonCopyable {
+public:
+
+  /// The counters that are collected
+  enum Event { cycles = 0, instructions, l1dMisses, llcMisses, branchMisses, fpAssists, eventCount };
+
+  /**
+   Counter values from one measurement. Invalid entries hold 0.
+   */
+  struct Values {
+    double counts[eventCount] = {};
+    bool valid[eventCount] = {};
+
+    /// @returns instructions per cycle, or 0 if not known
+    double ipc() const {
+      return valid[cycles] && valid[instructions] && counts[cycles] > 0.0 ? counts[instructions] / counts[cycles] : 0.0;
+    }
+
+    /**
+     Obtain the values divided by a work count, such as the number of samples processed.
+
+     @param divisor the amount to divide by
+     @returns scaled values
+     */
+    Values per(double divisor) const {
+      Values result = *this;
+      for (auto& count : result.counts) count /= divisor;
+      return result;
+    }
+  };
+
+  /**
+   Open the counters for the calling thread. They only count between `start` and `stop`.
+   */
+  PerfCounters() {
+    for (auto& fd : fds_) fd = -1;
+#if defined(__linux__)
+    open(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open(l1dMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    open(llcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    open(branchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    auto fpAssistEvent = getenv("LPF_PERF_FP_ASSIST_EVENT");
+    if (fpAssistEvent != nullptr) open(fpAssists, PERF_TYPE_RAW, strtoull(fpAssistEvent, nullptr, 0));
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (auto fd : fds_) if (fd >= 0) close(fd);
+#endif
+  }
+
+  /// @returns true if at least one counter is available
+  bool available() const {
+    for (auto fd : fds_) if (fd >= 0) return true;
+    return false;
+  }
+
+  /// @returns true if the given counter is available
+  bool available(Event event) const { return fds_[event] >= 0; }
+
+  /**
+   Zero and enable the counters.
+   */
+  void start() {
+#if defined(__linux__)
+    for (auto fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /**
+   Disable the counters and obtain their values since `start`.
+
+   @returns counter values
+   */
+  Values stop() {
+    Values values;
+#if defined(__linux__)
+    for (auto fd : fds_) if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (int event = 0; event < eventCount; ++event) {
+      if (fds_[event] < 0) continue;
+      // value, time enabled, time running
+      uint64_t data[3] = {};
+      if (read(fds_[event], data, sizeof(data)) != ssize_t(sizeof(data)) || data[2] == 0) continue;
+      values.counts[event] = double(data[0]) * double(data[1]) / double(data[2]);
+      values.valid[event] = true;
+    }
+#endif
+    return values;
+  }
+
+  /// @returns short name of a counter
+  static char const* name(Event event) {
+    switch (event) {
+      case cycles: return "cycles";
+      case instructions: return "instructions";
+      case l1dMisses: return "L1D misses";
+      case llcMisses: return "LLC misses";
+      case branchMisses: return "branch misses";
+      case fpAssists: return "FP assists";
+      case eventCount: break;
+    }
+    return "unknown";
+  }
+
+private:
+
+#if defined(__linux__)
+  void open(Event event, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[event] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+  int fds_[eventCount];
+};
@@ -0,0 +1,357 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ Header-only collection of polynomial approximations for the transcendental functions used in DSP code. Everything is
+ written against the GCC/Clang vector extensions so the same source compiles down to SSE, AVX or NEON instructions
+ depending on the target architecture without any per-element calls into libm or vForce.
+
+ Each function takes an `Accuracy` template parameter that selects the degree of the polynomials that are evaluated:
+
+ - `fast` -- roughly 11 bits of precision. Good enough for meters and control-rate modulation.
+ - `balanced` -- roughly 18 bits of precision. Good enough for visual output such as response curves.
+ - `precise` -- within a couple of ULPs of the libm result for typical arguments.
+
+ The vector functions work on `Float4` and `Float8` values. `Native` is the widest vector type that the target supports
+ in registers (`Float8` with AVX, otherwise `Float4`). The array functions at the end of the file process buffers of
+ arbitrary length using the `Native` type, padding the final partial vector as needed.
+ */
+namespace SIMDMath {
+
+enum class Accuracy { fast, balanced, precise };
+
+using Float4 = float __attribute__((vector_size(16)));
+using Int4 = int32_t __attribute__((vector_size(16)));
+using Float8 = float __attribute__((vector_size(32)));
+using Int8 = int32_t __attribute__((vector_size(32)));
+
+#if defined(__AVX__)
+using Native = Float8;
+#else
+using Native = Float4;
+#endif
+
+/**
+ Properties of the supported vector types.
+ */
+template <typename V> struct Traits;
+
+template <> struct Traits<Float4> {
+  using Int = Int4;
+  static constexpr size_t width = 4;
+};
+
+template <> struct Traits<Float8> {
+  using Int = Int8;
+  static constexpr size_t width = 8;
+};
+
+/**
+ Obtain a vector with all lanes set to the same value.
+
+ @param value the value to use
+ @returns new vector
+ */
+template <typename V> inline V splat(float value) { V v = {}; return v + value; }
+
+/**
+ Load a vector from possibly unaligned memory.
+ */
+template <typename V> inline V load(float const* ptr) {
+  V v;
+  __builtin_memcpy(&v, ptr, sizeof(V));
+  return v;
+}
+
+/**
+ Store a vector into possibly unaligned memory.
+ */
+template <typename V> inline void store(float* ptr, V v) { __builtin_memcpy(ptr, &v, sizeof(V)); }
+
+namespace Detail {
+
+template <typename V> using IntOf = typename Traits<V>::Int;
+
+template <typename V> inline IntOf<V> bits(V v) { return (IntOf<V>)v; }
+template <typename V> inline V floats(IntOf<V> v) { return (V)v; }
+
+/// Choose lanes from `a` where `mask` is set, and from `b` where it is clear.
+template <typename V> inline V select(IntOf<V> mask, V a, V b) {
+  return floats<V>((bits(a) & mask) | (bits(b) & ~mask));
+}
+
+template <typename V> inline V abs(V x) { return floats<V>(bits(x) & 0x7FFFFFFF); }
+template <typename V> inline V min(V a, V b) { return select<V>(a < b, a, b); }
+template <typename V> inline V max(V a, V b) { return select<V>(a > b, a, b); }
+
+/// Round to the nearest integer (ties to even). Valid for |x| < 2^22 which covers every use below.
+template <typename V> inline V round(V x) {
+  V const magic = splat<V>(12582912.0f); // 1.5 * 2^23
+  V y = x + magic;
+  return y - magic;
+}
+
+/// Evaluate a polynomial with Horner's method. Coefficients are in increasing order of degree.
+template <typename V> inline V horner(V, float c) { return splat<V>(c); }
+template <typename V, typename... Cs> inline V horner(V x, float c, Cs... cs) { return c + x * horner(x, cs...); }
+
+/**
+ Polynomials for each accuracy tier, obtained by minimax fitting over the reduced ranges:
+
+ - sin(r) = r + r^3 * sin(r^2) on [-pi/4, pi/4]
+ - cos(r) = 1 - r^2/2 + r^4 * cos(r^2) on [-pi/4, pi/4]
+ - 2^f = 1 + f * exp2(f) on [-0.5, 0.5]
+ - log2((1+t)/(1-t)) = t * log2(t^2) on [-0.1716, 0.1716]
+ */
+template <Accuracy A> struct Polynomials;
+
+template <> struct Polynomials<Accuracy::fast> {
+  template <typename V> static V sin(V z) { return horner(z, -1.6242790993e-01f); }
+  template <typename V> static V cos(V z) { return horner(z, 4.0899302984e-02f); }
+  template <typename V> static V exp2(V f) {
+    return horner(f, 6.9328293267e-01f, 2.4221096790e-01f, 5.5008903050e-02f);
+  }
+  template <typename V> static V log2(V t2) { return horner(t2, 2.8852285742e+00f, 9.8353431441e-01f); }
+};
+
+template <> struct Polynomials<Accuracy::balanced> {
+  template <typename V> static V sin(V z) { return horner(z, -1.6663390384e-01f, 8.1632820484e-03f); }
+  template <typename V> static V cos(V z) { return horner(z, 4.1661071261e-02f, -1.3648713563e-03f); }
+  template <typename V> static V exp2(V f) {
+    return horner(f, 6.9312419276e-01f, 2.4024098683e-01f, 5.5906428246e-02f, 9.5828506809e-03f);
+  }
+  template <typename V> static V log2(V t2) {
+    return horner(t2, 2.8853912893e+00f, 9.6147081579e-01f, 5.9897371343e-01f);
+  }
+};
+
+template <> struct Polynomials<Accuracy::precise> {
+  template <typename V> static V sin(V z) {
+    return horner(z, -1.6666654610e-01f, 8.3321607677e-03f, -1.9515283850e-04f);
+  }
+  template <typename V> static V cos(V z) {
+    return horner(z, 4.1666645683e-02f, -1.3887316244e-03f, 2.4433156043e-05f);
+  }
+  template <typename V> static V exp2(V f) {
+    return horner(f, 6.9314720286e-01f, 2.4022647914e-01f, 5.5503324697e-02f, 9.6184373575e-03f, 1.3398874851e-03f,
+                  1.5353362983e-04f);
+  }
+  template <typename V> static V log2(V t2) {
+    return horner(t2, 2.8853900728e+00f, 9.6180075929e-01f, 5.7658453625e-01f, 4.3425604136e-01f);
+  }
+};
+
+} // namespace Detail
+
+/**
+ Calculate the sine and cosine of the given values at the same time. Range reduction is done by multiples of pi/2
+ using a three-part Cody-Waite split of pi/2, so accuracy holds for arguments up to several thousand radians.
+
+ @param x the values to work on (radians)
+ @param sinOut storage for the sine values
+ @param cosOut storage for the cosine values
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline void sincos(V x, V& sinOut, V& cosOut) {
+  using namespace Detail;
+  using P = Polynomials<A>;
+  V q = round(x * 0.63661977236758134f); // 2/pi
+  V r = x - q * 1.5703125f;
+  r = r - q * 4.837512969970703125e-4f;
+  r = r - q * 7.54978995489188216e-8f;
+  V z = r * r;
+  V s = r + r * z * P::sin(z);
+  V c = 1.0f - 0.5f * z + z * z * P::cos(z);
+
+  auto quadrant = __builtin_convertvector(q, IntOf<V>);
+  auto swap = (quadrant & 1) != 0;
+  V sv = select<V>(swap, c, s);
+  V cv = select<V>(swap, s, c);
+  sinOut = floats<V>(bits(sv) ^ ((quadrant & 2) << 30));
+  cosOut = floats<V>(bits(cv) ^ (((quadrant + 1) & 2) << 30));
+}
+
+/**
+ Calculate the sine of the given values.
+
+ @param x the values to work on (radians)
+ @returns sine values
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V sin(V x) {
+  V s, c;
+  sincos<A>(x, s, c);
+  return s;
+}
+
+/**
+ Calculate the cosine of the given values.
+
+ @param x the values to work on (radians)
+ @returns cosine values
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V cos(V x) {
+  V s, c;
+  sincos<A>(x, s, c);
+  return c;
+}
+
+/**
+ Calculate 2 raised to the given values. Results saturate to 0 and +infinity outside of the representable range.
+
+ @param x the exponents to use
+ @returns 2^x
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V exp2(V x) {
+  using namespace Detail;
+  x = max(min(x, splat<V>(128.0f)), splat<V>(-150.0f));
+  V n = round(x);
+  V f = x - n;
+  V p = 1.0f + f * Polynomials<A>::exp2(f);
+  auto e = __builtin_convertvector(n, IntOf<V>);
+  // Split the scaling into two steps so that 2^128 turns into infinity and 2^-150 into zero without overflowing the
+  // exponent field.
+  auto e1 = e >> 1;
+  auto e2 = e - e1;
+  return p * floats<V>((e1 + 127) << 23) * floats<V>((e2 + 127) << 23);
+}
+
+/**
+ Calculate the base-2 logarithm of the given values. Zero and negative values return -infinity and NaN respectively;
+ denormal inputs are treated as zero.
+
+ @param x the values to work on
+ @returns log2(x)
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V log2(V x) {
+  using namespace Detail;
+  auto xb = bits(x);
+  // Split into mantissa in [sqrt(0.5), sqrt(2)) and an integral exponent.
+  auto adjusted = xb - 0x3F3504F3;
+  auto e = adjusted >> 23;
+  V m = floats<V>((adjusted & 0x007FFFFF) + 0x3F3504F3);
+  V t = (m - 1.0f) / (m + 1.0f);
+  V result = __builtin_convertvector(e, V) + t * Polynomials<A>::log2(t * t);
+  result = select<V>(xb < 0x00800000, splat<V>(-INFINITY), result);
+  result = select<V>(x < 0.0f, splat<V>(NAN), result);
+  return select<V>((xb >= 0x7F800000) | (x != x), x, result);
+}
+
+/**
+ Calculate the base-10 logarithm of the given values.
+
+ @param x the values to work on
+ @returns log10(x)
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V log10(V x) { return log2<A>(x) * 0.30102999566398120f; }
+
+/**
+ Calculate x raised to the power y. Only defined for non-negative x; a zero base yields zero for positive exponents.
+
+ @param x the base values
+ @param y the exponent values
+ @returns x^y
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V pow(V x, V y) {
+  using namespace Detail;
+  V r = exp2<A>(y * log2<A>(x));
+  r = select<V>((x == 0.0f) & (y > 0.0f), splat<V>(0.0f), r);
+  return select<V>(y == 0.0f, splat<V>(1.0f), r);
+}
+
+/**
+ Calculate the hyperbolic tangent of the given values. Derives the value from `exp2`, with an odd polynomial near zero
+ to avoid the cancellation in `(e - 1) / (e + 1)`.
+
+ @param x the values to work on
+ @returns tanh(x)
+ */
+template <Accuracy A = Accuracy::balanced, typename V>
+inline V tanh(V x) {
+  using namespace Detail;
+  V a = min(abs(x), splat<V>(9.0f));
+  V e = exp2<A>(a * 2.8853900817779268f); // 2 / ln(2)
+  V big = (e - 1.0f) / (e + 1.0f);
+  V a2 = a * a;
+  V small = a + a * a2 * (-0.33333333333f + a2 * (0.13333333333f + a2 * -0.053968253968f));
+  V r = select<V>(a < 0.125f, small, big);
+  return floats<V>(bits(r) | (bits(x) & INT32_MIN));
+}
+
+/**
+ Apply a unary vector function to an array of values. The last partial vector is padded with `pad` values.
+
+ @param in the values to process
+ @param out storage for the results (may be the same as `in`)
+ @param count the number of values to process
+ @param proc the vector function to apply
+ @param pad the value to use to fill out a partial vector
+ */
+template <typename V = Native, typename Proc>
+inline void transform(float const* in, float* out, size_t count, Proc proc, float pad = 1.0f) {
+  constexpr size_t width = Traits<V>::width;
+  size_t index = 0;
+  for (; index + width <= count; index += width) store(out + index, proc(load<V>(in + index)));
+  if (index < count) {
+    float tmp[width];
+    for (size_t lane = 0; lane < width; ++lane) tmp[lane] = index + lane < count ? in[index + lane] : pad;
+    store(tmp, proc(load<V>(tmp)));
+    for (size_t lane = 0; index + lane < count; ++lane) out[index + lane] = tmp[lane];
+  }
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void sin(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return sin<A>(v); });
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void cos(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return cos<A>(v); });
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void exp2(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return exp2<A>(v); });
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void log2(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return log2<A>(v); });
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void log10(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return log10<A>(v); });
+}
+
+template <Accuracy A = Accuracy::balanced>
+inline void tanh(float const* in, float* out, size_t count) {
+  transform(in, out, count, [](Native v) { return tanh<A>(v); }, 0.0f);
+}
+
+/**
+ Scalar convenience versions that evaluate the same polynomials as the vector functions so that scalar and vector code
+ paths produce identical results.
+ */
+template <Accuracy A = Accuracy::balanced> inline float sin(float x) { return sin<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float cos(float x) { return cos<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float exp2(float x) { return exp2<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float log2(float x) { return log2<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float log10(float x) { return log10<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float tanh(float x) { return tanh<A>(splat<Float4>(x))[0]; }
+template <Accuracy A = Accuracy::balanced> inline float pow(float x, float y) {
+  return pow<A>(splat<Float4>(x), splat<Float4>(y))[0];
+}
+
+} // namespace SIMDMath
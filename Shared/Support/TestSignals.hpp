@@ -0,0 +1,276 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "SIMDMath.hpp"
+
+/**
+ Header-only generators of the input signals used by tests and benchmarks: sines, multi-tone, logarithmic sweeps,
+ white and pink noise, impulses, and decays that pass through the denormal range into silence. Everything is built on
+ the `SIMDMath` vector types so that filling large buffers costs little next to the code being measured.
+
+ Every generator is deterministic. For a given vector type, each sample depends only on the arguments and its index,
+ where `start` is the index of the first sample written, so a signal made in chunks is identical to one made in a single
+ call. Phases are computed in double precision per vector and are never accumulated, so long signals do not drift.
+ */
+namespace TestSignals {
+
+using namespace SIMDMath;
+
+namespace Detail {
+
+template <typename V> struct Unsigned;
+template <> struct Unsigned<Float4> { using Type = uint32_t __attribute__((vector_size(16))); };
+template <> struct Unsigned<Float8> { using Type = uint32_t __attribute__((vector_size(32))); };
+
+/// @returns vector holding 0, 1, 2, ... in its lanes
+template <typename V> inline V ramp() {
+  V v = {};
+  for (size_t lane = 0; lane < Traits<V>::width; ++lane) v[lane] = float(lane);
+  return v;
+}
+
+/// @returns the fractional part of a value
+inline double fraction(double value) { return value - std::floor(value); }
+
+/**
+ Visit a buffer a vector at a time. Vectors always hold the samples of an aligned range of indices, so a sample's value
+ does not depend on where a call starts. The visitor is given the index of the first sample of the vector and its
+ current contents, and returns the new samples. Vectors that only partly overlap the buffer go through a temporary.
+ */
+template <typename V, typename Proc>
+inline void generate(float* out, size_t count, size_t start, Proc proc) {
+  constexpr size_t width = Traits<V>::width;
+  size_t index = 0;
+  while (index < count) {
+    size_t skip = (start + index) % width;
+    size_t take = std::min(width - skip, count - index);
+    size_t first = start + index - skip;
+    if (take == width) {
+      store(out + index, proc(first, load<V>(out + index)));
+    }
+    else {
+      float tmp[width] = {};
+      memcpy(tmp + skip, out + index, take * sizeof(float));
+      store(tmp, proc(first, load<V>(tmp)));
+      memcpy(out + index, tmp + skip, take * sizeof(float));
+    }
+    index += take;
+  }
+}
+
+/// Map sample indices to uniformly distributed values in [-1, 1) with a stateless integer hash
+template <typename V> inline V hashNoise(typename Unsigned<V>::Type x, uint32_t seed) {
+  x = x * 0x9E3779B9u + seed;
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  auto value = __builtin_convertvector(__builtin_convertvector(x >> 8, SIMDMath::Detail::IntOf<V>), V);
+  return value * (2.0f / 16777216.0f) - 1.0f;
+}
+
+template <typename V>
+inline void sine(float* out, size_t count, double frequency, double sampleRate, float amplitude, size_t start,
+                 bool accumulate) {
+  double increment = frequency / sampleRate;
+  V offsets = ramp<V>() * float(increment);
+  generate<V>(out, count, start, [&](size_t first, V current) {
+    V phase = float(fraction(double(first) * increment)) + offsets;
+    V value = amplitude * SIMDMath::sin<Accuracy::precise>(phase * float(2.0 * M_PI));
+    return accumulate ? current + value : value;
+  });
+}
+
+} // namespace Detail
+
+/**
+ A frequency and amplitude for `multiTone`.
+ */
+struct Tone {
+  double frequency;
+  float amplitude;
+};
+
+/**
+ Generate a sine wave that starts at phase 0 on sample 0.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param frequency the frequency of the wave in Hz
+ @param sampleRate the sample rate in Hz
+ @param amplitude the peak value
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void sine(float* out, size_t count, double frequency, double sampleRate, float amplitude = 1.0f,
+                 size_t start = 0) {
+  Detail::sine<V>(out, count, frequency, sampleRate, amplitude, start, false);
+}
+
+/**
+ Generate the sum of several sine waves.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param tones the frequencies and amplitudes of the waves
+ @param sampleRate the sample rate in Hz
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void multiTone(float* out, size_t count, std::vector<Tone> const& tones, double sampleRate, size_t start = 0) {
+  memset(out, 0, count * sizeof(float));
+  for (auto const& tone : tones) Detail::sine<V>(out, count, tone.frequency, sampleRate, tone.amplitude, start, true);
+}
+
+/**
+ Generate an exponential (logarithmic) sine sweep from `startFrequency` at sample 0 to `endFrequency` at sample
+ `length`, the usual excitation for measuring impulse responses. Samples past `length` keep rising in frequency.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param startFrequency the frequency at sample 0 in Hz
+ @param endFrequency the frequency at sample `length` in Hz
+ @param length the number of samples in the sweep
+ @param sampleRate the sample rate in Hz
+ @param amplitude the peak value
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void logSweep(float* out, size_t count, double startFrequency, double endFrequency, size_t length,
+                     double sampleRate, float amplitude = 1.0f, size_t start = 0) {
+  // Phase in cycles is f0 * K * (exp(t / K) - 1) with K = T / ln(f1 / f0). Within a vector, the phase advance of lane k
+  // is f0 * K * exp(t / K) * expm1(k / (K * sampleRate)), where only the first factor changes between vectors.
+  double scale = double(length) / sampleRate / std::log(endFrequency / startFrequency);
+  double cycles = startFrequency * scale;
+  V growth;
+  for (size_t lane = 0; lane < Traits<V>::width; ++lane) growth[lane] = float(std::expm1(lane / (scale * sampleRate)));
+  Detail::generate<V>(out, count, start, [&](size_t first, V) {
+    double rate = cycles * std::exp(double(first) / sampleRate / scale);
+    V phase = float(Detail::fraction(rate - cycles)) + float(rate) * growth;
+    return amplitude * SIMDMath::sin<Accuracy::precise>(phase * float(2.0 * M_PI));
+  });
+}
+
+/**
+ Generate white noise uniformly distributed in [-amplitude, amplitude). Samples come from a hash of the seed and the
+ sample index, so any range of the sequence can be made without making what comes before it.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param seed the sequence to generate
+ @param amplitude the peak value
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void whiteNoise(float* out, size_t count, uint32_t seed, float amplitude = 1.0f, size_t start = 0) {
+  using U = typename Detail::Unsigned<V>::Type;
+  U offsets = __builtin_convertvector(Detail::ramp<V>(), U);
+  Detail::generate<V>(out, count, start, [&](size_t first, V) {
+    return amplitude * Detail::hashNoise<V>(offsets + uint32_t(first), seed);
+  });
+}
+
+/**
+ Generate independent white noise in several channels. Channel `n` uses the sequence `seed + n`.
+
+ @param outs storage for the samples of each channel
+ @param count the number of samples to generate per channel
+ @param seed the sequence of the first channel
+ @param amplitude the peak value
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void whiteNoise(std::vector<float*> const& outs, size_t count, uint32_t seed, float amplitude = 1.0f,
+                       size_t start = 0) {
+  for (size_t channel = 0; channel < outs.size(); ++channel) {
+    whiteNoise<V>(outs[channel], count, seed + uint32_t(channel), amplitude, start);
+  }
+}
+
+/**
+ Generator of pink (1/f) noise: the white noise of `whiteNoise` shaped by Paul Kellet's three-pole filter, which is
+ within 0.5 dB of -3 dB/octave above about 10 Hz at 44.1 kHz. The filter carries state from one call to the next, so
+ the sequence must be made in order.
+ */
+class PinkNoise {
+public:
+
+  /**
+   Construct new instance.
+
+   @param seed the sequence of the underlying white noise
+   @param amplitude scaling applied to the output, which peaks just under 1 (RMS about 0.19) when this is 1
+   */
+  explicit PinkNoise(uint32_t seed, float amplitude = 1.0f) : seed_{seed}, amplitude_{amplitude} {}
+
+  /**
+   Generate the next samples of the sequence.
+
+   @param out storage for the samples
+   @param count the number of samples to generate
+   */
+  void generate(float* out, size_t count) {
+    whiteNoise(out, count, seed_, 1.0f, index_);
+    index_ += count;
+    for (size_t index = 0; index < count; ++index) {
+      float white = out[index];
+      b0_ = 0.99765f * b0_ + white * 0.0990460f;
+      b1_ = 0.96300f * b1_ + white * 0.2965164f;
+      b2_ = 0.57000f * b2_ + white * 1.0526913f;
+      out[index] = (b0_ + b1_ + b2_ + white * 0.1848f) * amplitude_ * 0.11f;
+    }
+  }
+
+private:
+  uint32_t seed_;
+  float amplitude_;
+  size_t index_ = 0;
+  float b0_ = 0.0f;
+  float b1_ = 0.0f;
+  float b2_ = 0.0f;
+};
+
+/**
+ Generate silence with a single non-zero sample.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param position the index of the impulse
+ @param amplitude the value of the impulse
+ @param start the index of the first sample
+ */
+inline void impulse(float* out, size_t count, size_t position, float amplitude = 1.0f, size_t start = 0) {
+  memset(out, 0, count * sizeof(float));
+  if (position >= start && position - start < count) out[position - start] = amplitude;
+}
+
+/**
+ Generate an exponential decay that halves every `halfLife` samples. It falls through the denormal range (below about
+ 1.2e-38) before becoming exact silence, which is what a filter's tail does after its input stops and is where CPUs
+ without flush-to-zero slow down.
+
+ @param out storage for the samples
+ @param count the number of samples to generate
+ @param amplitude the value of sample 0
+ @param halfLife the number of samples over which the value halves
+ @param start the index of the first sample
+ */
+template <typename V = Native>
+inline void denormalTail(float* out, size_t count, float amplitude, double halfLife, size_t start = 0) {
+  V offsets = Detail::ramp<V>() * float(-1.0 / halfLife);
+  Detail::generate<V>(out, count, start, [&](size_t first, V) {
+    float exponent = float(std::max(-double(first) / halfLife, -256.0));
+    return amplitude * SIMDMath::exp2<Accuracy::precise>(exponent + offsets);
+  });
+}
+
+} // namespace TestSignals
@@ -0,0 +1,261 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+/**
+ Fixed workloads for counting the instructions and simulated cache misses of the filtering hot loops, and a gate that
+ compares such counts against a baseline. Timings on shared CI runners wander by 20% or more; instruction counts under
+ valgrind's cachegrind do not, so a regression of a few percent in a hot loop shows up reliably. Tools/lpfbench.sh
+ runs every workload under cachegrind and checks the results against Tools/lpfbench-baseline.txt.
+
+ Build with:
+
+   c++ -std=gnu++14 -O2 -IShared/Kernel -IShared/Support Tools/lpfbench.cpp Shared/Kernel/BiquadFilter.cpp \
+     Shared/Kernel/BiquadCascade.cpp Shared/Kernel/BiquadTopologyFilter.cpp Shared/Kernel/HumRemover.cpp \
+     Shared/Kernel/SampleRateConverter.cpp Shared/Kernel/Vocoder.cpp -o lpfbench
+
+ Usage:
+
+   lpfbench list
+   lpfbench run WORKLOAD FRAMES
+   lpfbench check BASELINE RESULTS [-t PERCENT]
+
+ `list` prints the workload names. `run` processes FRAMES frames of noise in blocks of 512 and prints nothing, so that
+ counting the whole process twice with different FRAMES and taking the difference leaves only the cost of the frames.
+ `check` reads lines of `WORKLOAD EVENT COUNT-PER-FRAME` from both files and fails if any count in RESULTS is more
+ than PERCENT (default 2) above its baseline, or has no baseline at all. Counts that are nearly zero get an allowance
+ of 0.01 per frame instead.
+
+ Not covered: `processAndRender` and the Accelerate engine, which need Apple frameworks that cachegrind cannot run.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "BiquadCascade.h"
+#include "BiquadFilter.h"
+#include "HumRemover.h"
+#include "SampleRateConverter.h"
+#include "TestSignals.hpp"
+#include "Vocoder.h"
+
+namespace {
+
+constexpr size_t blockSize = 512;
+constexpr double sampleRate = 48000.0;
+
+/**
+ Input and output buffers for a workload. The input is generated once for a block and reused, so that generating it
+ costs nothing per frame.
+ */
+struct Buffers {
+  Buffers(size_t numChannels, size_t outputSize = blockSize)
+  : inputs(numChannels, std::vector<float>(blockSize)), outputs(numChannels, std::vector<float>(outputSize))
+  {
+    for (size_t channel = 0; channel < numChannels; ++channel) {
+      TestSignals::whiteNoise(inputs[channel].data(), blockSize, uint32_t(channel + 1), 0.5f);
+      ins.push_back(inputs[channel].data());
+      outs.push_back(outputs[channel].data());
+    }
+  }
+
+  std::vector<std::vector<float>> inputs;
+  std::vector<std::vector<float>> outputs;
+  std::vector<float const*> ins;
+  std::vector<float*> outs;
+};
+
+/**
+ Run `block` once for each block of `frames` frames, passing the size of the block.
+ */
+template <typename Block>
+void blocks(size_t frames, Block block)
+{
+  for (size_t offset = 0; offset < frames; offset += blockSize) block(std::min(blockSize, frames - offset));
+}
+
+/**
+ Filter with a BiquadFilter engine, moving the cutoff every block as automation would.
+ */
+void biquad(BiquadFilter::Engine engine, size_t numChannels, bool linked, size_t frames)
+{
+  Buffers buffers(numChannels);
+  if (linked) buffers.inputs[1] = buffers.inputs[0];
+  BiquadFilter filter;
+  filter.setEngine(engine);
+  float const nyquistPeriod = float(2.0 / sampleRate);
+  size_t count = 0;
+  blocks(frames, [&](size_t frameCount) {
+    filter.calculateParams(1000.0f + 10.0f * (count++ % 64), 6.0f, nyquistPeriod, numChannels);
+    if (linked) filter.applyLinked(buffers.ins[0], buffers.outs[0], 1, frameCount);
+    else filter.apply(buffers.ins, buffers.outs, frameCount);
+  });
+}
+
+void cascade(size_t numSections, size_t numChannels, size_t frames)
+{
+  Buffers buffers(numChannels);
+  float const nyquistPeriod = float(2.0 / sampleRate);
+  std::vector<BiquadFilter::Coefficients> sections;
+  for (size_t index = 0; index < numSections; ++index) {
+    sections.push_back(BiquadFilter::notch(100.0f * (index + 1), 10.0f, nyquistPeriod));
+  }
+  BiquadCascade filter;
+  filter.setSections(sections, numChannels);
+  blocks(frames, [&](size_t frameCount) { filter.apply(buffers.ins, buffers.outs, frameCount); });
+}
+
+void humRemover(size_t frames)
+{
+  Buffers buffers(2);
+  HumRemover remover;
+  remover.configure(2, sampleRate, HumRemover::Mains::fifty);
+  blocks(frames, [&](size_t frameCount) { remover.process(buffers.ins, buffers.outs, frameCount); });
+}
+
+void vocoder(size_t frames)
+{
+  Buffers modulators(2);
+  Buffers carriers(2);
+  Vocoder vocoder;
+  vocoder.configure(2, 16, 100.0f, 8000.0f, sampleRate);
+  blocks(frames, [&](size_t frameCount) {
+    vocoder.process(modulators.ins, carriers.ins, carriers.outs, frameCount);
+  });
+}
+
+void sampleRateConverter(size_t frames)
+{
+  SampleRateConverter converter;
+  converter.configure(44100.0, sampleRate, 2);
+  Buffers buffers(2, converter.outputFrameCount(blockSize) + 1);
+  blocks(frames, [&](size_t frameCount) { converter.process(buffers.ins, buffers.outs, frameCount); });
+}
+
+using Workload = void (*)(size_t);
+
+std::vector<std::pair<char const*, Workload>> const workloads = {
+  {"biquad-portable-stereo", [](size_t frames) { biquad(BiquadFilter::Engine::portable, 2, false, frames); }},
+  {"biquad-portable-linked", [](size_t frames) { biquad(BiquadFilter::Engine::portable, 2, true, frames); }},
+  {"biquad-deterministic-stereo", [](size_t frames) {
+    biquad(BiquadFilter::Engine::deterministic, 2, false, frames);
+  }},
+  {"cascade-8-mono", [](size_t frames) { cascade(8, 1, frames); }},
+  {"cascade-4-stereo", [](size_t frames) { cascade(4, 2, frames); }},
+  {"hum-remover-stereo", humRemover},
+  {"vocoder-16-stereo", vocoder},
+  {"src-44-48-stereo", sampleRateConverter},
+};
+
+using Counts = std::map<std::pair<std::string, std::string>, double>;
+
+bool read(char const* path, Counts& counts)
+{
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string workload, event;
+    double count;
+    if (!(fields >> workload >> event >> count)) {
+      fprintf(stderr, "%s: bad line '%s'\n", path, line.c_str());
+      return false;
+    }
+    counts[{workload, event}] = count;
+  }
+  return true;
+}
+
+int check(char const* baselinePath, char const* resultsPath, double tolerance)
+{
+  Counts baseline, results;
+  if (!read(baselinePath, baseline) || !read(resultsPath, results)) return 2;
+
+  int failures = 0;
+  printf("%-28s %-6s %12s %12s %8s\n", "WORKLOAD", "EVENT", "BASELINE", "RESULT", "CHANGE");
+  for (auto const& entry : baseline) {
+    auto const& workload = entry.first.first;
+    auto const& event = entry.first.second;
+    auto found = results.find(entry.first);
+    if (found == results.end()) {
+      printf("%-28s %-6s %12.3f %12s %8s  MISSING\n", workload.c_str(), event.c_str(), entry.second, "-", "-");
+      ++failures;
+      continue;
+    }
+
+    double allowance = std::max(entry.second * tolerance, 0.01);
+    double change = entry.second > 0.0 ? 100.0 * (found->second - entry.second) / entry.second : 0.0;
+    char const* verdict = "";
+    if (found->second > entry.second + allowance) {
+      verdict = "  REGRESSION";
+      ++failures;
+    }
+    else if (found->second < entry.second - allowance) {
+      verdict = "  improved -- update the baseline";
+    }
+    printf("%-28s %-6s %12.3f %12.3f %+7.2f%%%s\n", workload.c_str(), event.c_str(), entry.second, found->second,
+           change, verdict);
+  }
+
+  // A count without a baseline is not being checked at all, so it is a failure until it is recorded.
+  for (auto const& entry : results) {
+    if (baseline.find(entry.first) == baseline.end()) {
+      printf("%-28s %-6s %12s %12.3f %8s  NOT IN BASELINE\n", entry.first.first.c_str(), entry.first.second.c_str(),
+             "-", entry.second, "-");
+      ++failures;
+    }
+  }
+
+  if (failures > 0) {
+    printf("\n%d count(s) missing from the baseline or over it by more than %g%%\n", failures, tolerance * 100.0);
+  }
+  return failures > 0 ? 1 : 0;
+}
+
+void usage(char const* program)
+{
+  fprintf(stderr, "usage: %s list | run WORKLOAD FRAMES | check BASELINE RESULTS [-t PERCENT]\n", program);
+  exit(2);
+}
+
+} // end namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) usage(argv[0]);
+
+  if (strcmp(argv[1], "list") == 0) {
+    for (auto const& workload : workloads) printf("%s\n", workload.first);
+    return 0;
+  }
+
+  if (strcmp(argv[1], "run") == 0 && argc == 4) {
+    for (auto const& workload : workloads) {
+      if (strcmp(argv[2], workload.first) == 0) {
+        workload.second(size_t(atol(argv[3])));
+        return 0;
+      }
+    }
+    fprintf(stderr, "unknown workload %s\n", argv[2]);
+    return 2;
+  }
+
+  if (strcmp(argv[1], "check") == 0 && (argc == 4 || (argc == 6 && strcmp(argv[4], "-t") == 0))) {
+    return check(argv[2], argv[3], argc == 6 ? atof(argv[5]) / 100.0 : 0.02);
+  }
+
+  usage(argv[0]);
+  return 2;
+}
@@ -0,0 +1,80 @@
+#!/bin/bash
+# Copyright © 2021 Brad Howes. All rights reserved.
+#
+# Count the instructions and simulated cache misses per frame of each lpfbench workload under valgrind's cachegrind and
+# check them against Tools/lpfbench-baseline.txt (see Tools/lpfbench.cpp).
+#
+# Usage: Tools/lpfbench.sh [--update] [-t PERCENT]
+#
+# Each workload runs twice, with FRAMES and 2 * FRAMES frames, and the difference is divided by FRAMES so that process
+# start-up and setup drop out. The simulated caches are fixed rather than taken from the host so that results do not
+# depend on the runner. Counts also depend on the compiler and valgrind, so the check fails if their versions differ
+# from the ones named in the baseline. `--update` rewrites the baseline with the new counts, naming the image given by
+# LPFBENCH_IMAGE, if any. The baseline is recorded by .github/workflows/lpfbench-baseline.yml, and the CI check in
+# .github/workflows/swift.yml runs in the image that the baseline names.
+
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+baseline=Tools/lpfbench-baseline.txt
+frames=24576
+tolerance=2
+update=0
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --update) update=1 ;;
+    -t) tolerance="$2"; shift ;;
+    *) echo "usage: $0 [--update] [-t PERCENT]" >&2; exit 2 ;;
+  esac
+  shift
+done
+
+# The compiler's own version, which unlike `c++ --version` does not change with the distribution's package revision
+toolchain="$(echo __VERSION__ | c++ -E -P -x c++ - | tr -d '"'), $(valgrind --version), $(uname -m)"
+if [ "$update" = 0 ]; then
+  if [ ! -f "$baseline" ]; then
+    echo "no $baseline -- record one with .github/workflows/lpfbench-baseline.yml" >&2
+    exit 1
+  fi
+  recorded=$(sed -n 's/^# Toolchain: //p' "$baseline")
+  if [ "$recorded" != "$toolchain" ]; then
+    echo "$baseline was recorded with $recorded, not $toolchain" >&2
+    exit 1
+  fi
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+c++ -std=gnu++14 -O2 -g -IShared/Kernel -IShared/Support Tools/lpfbench.cpp Shared/Kernel/BiquadFilter.cpp \
+  Shared/Kernel/BiquadCascade.cpp Shared/Kernel/BiquadTopologyFilter.cpp Shared/Kernel/HumRemover.cpp \
+  Shared/Kernel/SampleRateConverter.cpp Shared/Kernel/Vocoder.cpp -o "$work/lpfbench"
+
+# Print the `events:` and `summary:` counts of a cachegrind output file as "EVENT COUNT" lines
+summary() {
+  awk '/^events:/ { for (i = 2; i <= NF; ++i) name[i] = $i }
+       /^summary:/ { for (i = 2; i <= NF; ++i) print name[i], $i }' "$1"
+}
+
+for workload in $("$work/lpfbench" list); do
+  for run in 1 2; do
+    valgrind --tool=cachegrind --cache-sim=yes --I1=32768,8,64 --D1=32768,8,64 --LL=8388608,16,64 \
+      --cachegrind-out-file="$work/$workload.$run" "$work/lpfbench" run "$workload" $((run * frames)) 2>/dev/null
+    summary "$work/$workload.$run" > "$work/$workload.$run.txt"
+  done
+  paste -d ' ' "$work/$workload.1.txt" "$work/$workload.2.txt" |
+    awk -v workload="$workload" -v frames="$frames" '{ printf "%s %s %.4f\n", workload, $1, ($4 - $2) / frames }'
+done > "$work/results.txt"
+
+if [ "$update" = 1 ]; then
+  {
+    echo "# Counts per frame from Tools/lpfbench.sh"
+    echo "# Toolchain: $toolchain"
+    if [ -n "${LPFBENCH_IMAGE:-}" ]; then echo "# Image: $LPFBENCH_IMAGE"; fi
+    cat "$work/results.txt"
+  } > "$baseline"
+  cat "$baseline"
+else
+  "$work/lpfbench" check "$baseline" "$work/results.txt" -t "$tolerance"
+fi
@@ -0,0 +1,86 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+/**
+ Watch the health of the filter kernels in another process, in the manner of `top`. Reads the statistics that
+ KernelTelemetry publishes in shared memory.
+
+ Build with:
+
+   c++ -std=gnu++14 -O2 -IShared/Kernel -IShared/Support Tools/lpftop.cpp Shared/Kernel/KernelTelemetry.cpp -o lpftop
+
+ Usage:
+
+   lpftop PID [-i SECONDS] [-n COUNT] [--text]
+
+ `-i` sets the refresh interval (default 1), `-n` stops after COUNT refreshes, and `--text` prints the statistics once
+ in the Prometheus text exposition format for scraping.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "KernelTelemetry.h"
+
+static void usage(char const* program)
+{
+  fprintf(stderr, "usage: %s PID [-i SECONDS] [-n COUNT] [--text]\n", program);
+  exit(2);
+}
+
+static void show(pid_t pid, std::vector<KernelTelemetry::Snapshot> const& snapshots, uint64_t dropped)
+{
+  printf("\x1b[H\x1b[2J");
+  printf("LPF kernels in process %d\n\n", int(pid));
+  printf("%-24s %-11s %9s %10s %8s %8s %8s %8s %7s %6s %5s %6s %8s\n", "KERNEL", "ENGINE", "RATE", "RENDERS",
+         "P50 us", "P90 us", "P99 us", "MAX us", "MISSED", "EV/BLK", "NaN", "NOBUF", "MEM KB");
+  for (auto const& snapshot : snapshots) {
+    printf("%-24.24s %-11.11s %9.0f %10llu %8.1f %8.1f %8.1f %8.1f %7llu %6llu %5llu %6llu %8.1f\n",
+           snapshot.name.c_str(), snapshot.engine.c_str(), snapshot.sampleRate,
+           (unsigned long long)snapshot.renders, snapshot.p50Microseconds, snapshot.p90Microseconds,
+           snapshot.p99Microseconds, snapshot.maxMicroseconds, (unsigned long long)snapshot.deadlineMisses,
+           (unsigned long long)snapshot.lastEventsPerBlock, (unsigned long long)snapshot.nanResets,
+           (unsigned long long)snapshot.reserveExhausted, snapshot.memoryBytes / 1024.0);
+  }
+  if (snapshots.empty()) printf("(no kernels publishing)\n");
+  if (dropped > 0) printf("(%llu more kernels found no free slot)\n", (unsigned long long)dropped);
+  fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) usage(argv[0]);
+  pid_t pid = pid_t(atoi(argv[1]));
+  double interval = 1.0;
+  long count = -1;
+  bool text = false;
+
+  for (int index = 2; index < argc; ++index) {
+    if (strcmp(argv[index], "--text") == 0) text = true;
+    else if (strcmp(argv[index], "-i") == 0 && index + 1 < argc) interval = atof(argv[++index]);
+    else if (strcmp(argv[index], "-n") == 0 && index + 1 < argc) count = atol(argv[++index]);
+    else usage(argv[0]);
+  }
+
+  std::vector<KernelTelemetry::Snapshot> snapshots;
+  uint64_t dropped = 0;
+  for (long iteration = 0; count < 0 || iteration < count; ++iteration) {
+    if (!KernelTelemetry::read(pid, snapshots, &dropped)) {
+      fprintf(stderr, "no telemetry for process %d (%s)\n", int(pid), KernelTelemetry::segmentName(pid).c_str());
+      return 1;
+    }
+
+    if (text) {
+      fputs(KernelTelemetry::exposition(pid, snapshots, dropped).c_str(), stdout);
+      return 0;
+    }
+
+    show(pid, snapshots, dropped);
+    usleep(useconds_t(interval * 1.0e6));
+  }
+
+  return 0;
+}
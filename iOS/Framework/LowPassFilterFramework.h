@@ -7,6 +7,7 @@ FOUNDATION_EXPORT double LowPassFilterFramework_iOSVersionNumber;
 FOUNDATION_EXPORT const unsigned char LowPassFilterFramework_iOSVersionString[];
 
 #import <LowPassFilterFramework/SimplyLowPassKernelAdapter.h>
+#import <LowPassFilterFramework/BiquadFilterAPI.h>
 
 @class FilterAudioUnit;
 @class FilterViewController;
@@ -7,6 +7,7 @@ FOUNDATION_EXPORT double LowPassFilterFramework_macOSVersionNumber;
 FOUNDATION_EXPORT const unsigned char LowPassFilterFramework_macOSVersionString[];
 
 #import "LowPassFilterFramework/SimplyLowPassKernelAdapter.h"
+#import "LowPassFilterFramework/BiquadFilterAPI.h"
 
 @class FilterAudioUnit;
 @class FilterViewController;
@@ -0,0 +1,156 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstdio>
+#import <string>
+#import <unistd.h>
+#import <vector>
+
+#import "AutomationFile.h"
+
+@interface AutomationFileTests : XCTestCase
+@end
+
+static std::string tempPath(char const* name) {
+  return std::string(NSTemporaryDirectory().UTF8String) + "/" + name;
+}
+
+static std::vector<AutomationFile::Lane> makeLanes() {
+  return {
+    {0, {{0, 1000.0, 0}, {100, 2000.0, 64}, {700, 3000.0, 0}}},
+    {1, {{50, 3.0, 0}, {100, 6.0, 0}, {1000, 9.0, 32}}}
+  };
+}
+
+static std::vector<AURenderEvent> collect(AURenderEvent const* event) {
+  std::vector<AURenderEvent> events;
+  for (; event != nullptr; event = event->head.next) events.push_back(*event);
+  return events;
+}
+
+@implementation AutomationFileTests
+
+- (void)testRoundTrip {
+  auto path = tempPath("automation-roundtrip.lpfa");
+  XCTAssertTrue(AutomationFile::write(path, 48000.0, makeLanes()));
+
+  AutomationFile file;
+  XCTAssertTrue(file.open(path));
+  XCTAssertEqual(file.sampleRate(), 48000.0);
+  XCTAssertEqual(file.laneCount(), size_t(2));
+  XCTAssertEqual(file.pointCount(), size_t(6));
+
+  auto events = collect(file.next(0, 2048));
+  XCTAssertEqual(events.size(), size_t(6));
+  XCTAssertEqual(file.pointCount(), size_t(0));
+
+  // Merged in time order across lanes
+  AUEventSampleTime when[] = {0, 50, 100, 100, 700, 1000};
+  for (size_t index = 0; index < events.size(); ++index) {
+    XCTAssertEqual(events[index].parameter.eventSampleTime, when[index]);
+    if (index > 0) XCTAssertLessThanOrEqual(events[index - 1].parameter.eventSampleTime,
+                                            events[index].parameter.eventSampleTime);
+  }
+
+  XCTAssertEqual(events[0].parameter.parameterAddress, AUParameterAddress(0));
+  XCTAssertEqual(events[0].head.eventType, AURenderEventParameter);
+  XCTAssertEqual(events[0].parameter.value, 1000.0f);
+
+  XCTAssertEqual(events[2].parameter.parameterAddress, AUParameterAddress(0));
+  XCTAssertEqual(events[2].head.eventType, AURenderEventParameterRamp);
+  XCTAssertEqual(events[2].parameter.rampDurationSampleFrames, AUAudioFrameCount(64));
+
+  XCTAssertEqual(events[5].parameter.parameterAddress, AUParameterAddress(1));
+  XCTAssertEqual(events[5].parameter.value, 9.0f);
+
+  remove(path.c_str());
+}
+
+- (void)testChunks {
+  auto path = tempPath("automation-chunks.lpfa");
+  XCTAssertTrue(AutomationFile::write(path, 44100.0, makeLanes()));
+
+  AutomationFile file;
+  XCTAssertTrue(file.open(path));
+
+  // Every point shows up exactly once, in the chunk that contains it
+  size_t total = 0;
+  for (AUEventSampleTime start = 0; start < 1024; start += 128) {
+    auto events = collect(file.next(start, 128));
+    for (auto const& event : events) {
+      XCTAssertGreaterThanOrEqual(event.parameter.eventSampleTime, start);
+      XCTAssertLessThan(event.parameter.eventSampleTime, start + 128);
+    }
+    total += events.size();
+  }
+
+  XCTAssertEqual(total, size_t(6));
+  XCTAssertTrue(file.next(1024, 128) == nullptr);
+
+  remove(path.c_str());
+}
+
+- (void)testLatePointsAreNotLost {
+  auto path = tempPath("automation-late.lpfa");
+  XCTAssertTrue(AutomationFile::write(path, 44100.0, makeLanes()));
+
+  AutomationFile file;
+  XCTAssertTrue(file.open(path));
+
+  // Starting past some points delivers them at the start of the chunk
+  auto events = collect(file.next(200, 64));
+  XCTAssertEqual(events.size(), size_t(4));
+  for (auto const& event : events) XCTAssertEqual(event.parameter.eventSampleTime, AUEventSampleTime(200));
+
+  remove(path.c_str());
+}
+
+- (void)testSeek {
+  auto path = tempPath("automation-seek.lpfa");
+  XCTAssertTrue(AutomationFile::write(path, 44100.0, makeLanes()));
+
+  AutomationFile file;
+  XCTAssertTrue(file.open(path));
+
+  file.seek(100);
+  XCTAssertEqual(file.pointCount(), size_t(4));
+  auto events = collect(file.next(100, 1));
+  XCTAssertEqual(events.size(), size_t(2));
+
+  file.seek(701);
+  XCTAssertEqual(file.pointCount(), size_t(1));
+  events = collect(file.next(701, 512));
+  XCTAssertEqual(events.size(), size_t(1));
+  XCTAssertEqual(events[0].parameter.eventSampleTime, AUEventSampleTime(1000));
+
+  file.seek(0);
+  XCTAssertEqual(file.pointCount(), size_t(6));
+
+  remove(path.c_str());
+}
+
+- (void)testRejectsBadFiles {
+  AutomationFile file;
+  XCTAssertFalse(file.open(tempPath("automation-missing.lpfa")));
+
+  // Unsorted lanes are not written
+  std::vector<AutomationFile::Lane> unsorted{{0, {{10, 1.0, 0}, {5, 2.0, 0}}}};
+  XCTAssertFalse(AutomationFile::write(tempPath("automation-unsorted.lpfa"), 44100.0, unsorted));
+
+  // Truncated file whose lane table claims more points than there are
+  auto path = tempPath("automation-truncated.lpfa");
+  XCTAssertTrue(AutomationFile::write(path, 44100.0, makeLanes()));
+  XCTAssertEqual(truncate(path.c_str(), 24 + 2 * 24 + 3 * 16), 0);
+  XCTAssertFalse(file.open(path));
+  XCTAssertEqual(file.laneCount(), size_t(0));
+
+  // Wrong magic
+  FILE* garbage = fopen(path.c_str(), "wb");
+  fputs("not an automation file at all", garbage);
+  fclose(garbage);
+  XCTAssertFalse(file.open(path));
+
+  remove(path.c_str());
+}
+
+@end
@@ -0,0 +1,299 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "BiquadFilterAPI.h"
+
+@interface BiquadFilterAPITests : XCTestCase
+@end
+
+static std::vector<float> makeSignal(size_t frameCount, double frequency) {
+  std::vector<float> samples;
+  for (size_t index = 0; index < frameCount; ++index) {
+    samples.push_back(cos(index * 2.0 * M_PI * frequency / 44100.0) + cos(index * 2.0 * M_PI * 100.0 / 44100.0));
+  }
+  return samples;
+}
+
+@implementation BiquadFilterAPITests
+
+- (void)testCreateAndConfigure {
+  XCTAssertEqual(LPFBiquadAPIVersion(), LPF_BIQUAD_API_VERSION);
+  XCTAssertTrue(LPFBiquadCreate(0) == nullptr);
+
+  LPFBiquad* filter = LPFBiquadCreate(2);
+  XCTAssertTrue(filter != nullptr);
+  XCTAssertEqual(LPFBiquadNumChannels(filter), size_t(2));
+
+  float sample = 1.0;
+  float const* ins[] = {&sample, &sample};
+  float* outs[] = {&sample, &sample};
+  XCTAssertEqual(LPFBiquadProcess(filter, ins, outs, 1, 1), LPFBiquadStatusNotConfigured);
+
+  XCTAssertEqual(LPFBiquadConfigure(filter, 0.0, 0.0, 44100.0), LPFBiquadStatusInvalidArgument);
+  XCTAssertEqual(LPFBiquadConfigure(filter, 30000.0, 0.0, 44100.0), LPFBiquadStatusInvalidArgument);
+  XCTAssertEqual(LPFBiquadConfigure(filter, 1000.0, 0.0, 0.0), LPFBiquadStatusInvalidArgument);
+  XCTAssertEqual(LPFBiquadConfigure(filter, 1000.0, 0.0, 44100.0), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadProcess(filter, ins, outs, 0, 1), LPFBiquadStatusInvalidArgument);
+
+  LPFBiquadDestroy(filter);
+  LPFBiquadDestroy(nullptr);
+}
+
+- (void)testSampleRateChange {
+  LPFBiquad* filter = LPFBiquadCreate(1);
+  LPFBiquad* expected = LPFBiquadCreate(1);
+  float frequencies[] = {1000.0, 4000.0, 12000.0};
+  float magnitudes[3];
+  float expectedMagnitudes[3];
+
+  // Only the sample rate changes, and the response must follow it
+  LPFBiquadConfigure(filter, 2000.0, 6.0, 44100.0);
+  LPFBiquadConfigure(filter, 2000.0, 6.0, 96000.0);
+  LPFBiquadConfigure(expected, 2000.0, 6.0, 96000.0);
+  LPFBiquadMagnitudes(filter, frequencies, 3, magnitudes);
+  LPFBiquadMagnitudes(expected, frequencies, 3, expectedMagnitudes);
+  for (size_t index = 0; index < 3; ++index) XCTAssertEqual(magnitudes[index], expectedMagnitudes[index]);
+
+  LPFBiquadDestroy(filter);
+  LPFBiquadDestroy(expected);
+}
+
+- (void)testPlanarMatchesInterleaved {
+  size_t frameCount = 512;
+  auto left = makeSignal(frameCount, 8000.0);
+  auto right = makeSignal(frameCount, 12000.0);
+
+  std::vector<float> interleaved;
+  for (size_t index = 0; index < frameCount; ++index) {
+    interleaved.push_back(left[index]);
+    interleaved.push_back(right[index]);
+  }
+
+  LPFBiquad* planar = LPFBiquadCreate(2);
+  LPFBiquad* strided = LPFBiquadCreate(2);
+  LPFBiquadConfigure(planar, 2000.0, 6.0, 44100.0);
+  LPFBiquadConfigure(strided, 2000.0, 6.0, 44100.0);
+
+  float const* ins[] = {left.data(), right.data()};
+  float* outs[] = {left.data(), right.data()};
+  XCTAssertEqual(LPFBiquadProcess(planar, ins, outs, 1, frameCount), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadProcessInterleaved(strided, interleaved.data(), interleaved.data(), frameCount),
+                 LPFBiquadStatusOK);
+
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqual(left[index], interleaved[index * 2]);
+    XCTAssertEqual(right[index], interleaved[index * 2 + 1]);
+  }
+
+  LPFBiquadDestroy(planar);
+  LPFBiquadDestroy(strided);
+}
+
+- (void)testBatch {
+  size_t frameCount = 256;
+  auto first = makeSignal(frameCount, 8000.0);
+  auto second = makeSignal(frameCount, 12000.0);
+  auto expected = first;
+
+  LPFBiquad* reference = LPFBiquadCreate(1);
+  LPFBiquadConfigure(reference, 2000.0, 0.0, 44100.0);
+  float const* refIns[] = {expected.data()};
+  float* refOuts[] = {expected.data()};
+  LPFBiquadProcess(reference, refIns, refOuts, 1, frameCount);
+
+  LPFBiquad* filter = LPFBiquadCreate(1);
+  LPFBiquad* unconfigured = LPFBiquadCreate(1);
+  LPFBiquadConfigure(filter, 2000.0, 0.0, 44100.0);
+
+  float const* ins1[] = {first.data()};
+  float* outs1[] = {first.data()};
+  float const* ins2[] = {second.data()};
+  float* outs2[] = {second.data()};
+  LPFBiquadJob jobs[] = {
+    {filter, ins1, outs1, 1, frameCount, 0},
+    {unconfigured, ins2, outs2, 1, frameCount, 0},
+  };
+
+  XCTAssertEqual(LPFBiquadProcessBatch(jobs, 2), LPFBiquadStatusNotConfigured);
+  XCTAssertEqual(LPFBiquadStatus(jobs[0].status), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadStatus(jobs[1].status), LPFBiquadStatusNotConfigured);
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqual(first[index], expected[index]);
+  }
+
+  LPFBiquadDestroy(reference);
+  LPFBiquadDestroy(filter);
+  LPFBiquadDestroy(unconfigured);
+}
+
+- (void)testResetAndCopyState {
+  size_t frameCount = 128;
+  auto signal = makeSignal(frameCount * 2, 8000.0);
+
+  LPFBiquad* source = LPFBiquadCreate(1);
+  LPFBiquad* destination = LPFBiquadCreate(1);
+  LPFBiquad* stereo = LPFBiquadCreate(2);
+  LPFBiquadConfigure(source, 2000.0, 0.0, 44100.0);
+  LPFBiquadConfigure(destination, 2000.0, 0.0, 44100.0);
+  LPFBiquadConfigure(stereo, 2000.0, 0.0, 44100.0);
+
+  std::vector<float> a(frameCount);
+  std::vector<float> b(frameCount);
+  float const* in1[] = {signal.data()};
+  float* out1[] = {a.data()};
+  LPFBiquadProcess(source, in1, out1, 1, frameCount);
+
+  XCTAssertEqual(LPFBiquadCopyState(destination, source), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadCopyState(stereo, source), LPFBiquadStatusChannelMismatch);
+
+  float const* in2[] = {signal.data() + frameCount};
+  float* outA[] = {a.data()};
+  float* outB[] = {b.data()};
+  LPFBiquadProcess(source, in2, outA, 1, frameCount);
+  LPFBiquadProcess(destination, in2, outB, 1, frameCount);
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqual(a[index], b[index]);
+  }
+
+  LPFBiquadResetState(source);
+  LPFBiquad* fresh = LPFBiquadCreate(1);
+  LPFBiquadConfigure(fresh, 2000.0, 0.0, 44100.0);
+  LPFBiquadProcess(source, in1, outA, 1, frameCount);
+  LPFBiquadProcess(fresh, in1, outB, 1, frameCount);
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqual(a[index], b[index]);
+  }
+
+  LPFBiquadDestroy(source);
+  LPFBiquadDestroy(destination);
+  LPFBiquadDestroy(stereo);
+  LPFBiquadDestroy(fresh);
+}
+
+- (void)testGetAndSetState {
+  size_t frameCount = 128;
+  auto signal = makeSignal(frameCount * 2, 8000.0);
+
+  LPFBiquad* source = LPFBiquadCreate(1);
+  LPFBiquad* destination = LPFBiquadCreate(1);
+  LPFBiquadConfigure(source, 2000.0, 0.0, 44100.0);
+  LPFBiquadConfigure(destination, 2000.0, 0.0, 44100.0);
+
+  std::vector<float> a(frameCount);
+  std::vector<float> b(frameCount);
+  float const* in1[] = {signal.data()};
+  float const* in2[] = {signal.data() + frameCount};
+  float* outA[] = {a.data()};
+  float* outB[] = {b.data()};
+  LPFBiquadProcess(source, in1, outA, 1, frameCount);
+
+  float state[4];
+  XCTAssertEqual(LPFBiquadGetState(source, 1, state), LPFBiquadStatusInvalidArgument);
+  XCTAssertEqual(LPFBiquadGetState(source, 0, state), LPFBiquadStatusOK);
+  XCTAssertEqual(state[0], signal[frameCount - 1]);
+  XCTAssertEqual(state[1], signal[frameCount - 2]);
+  XCTAssertEqual(state[2], a[frameCount - 1]);
+  XCTAssertEqual(state[3], a[frameCount - 2]);
+  XCTAssertEqual(LPFBiquadSetState(destination, 0, state), LPFBiquadStatusOK);
+
+  LPFBiquadProcess(source, in2, outA, 1, frameCount);
+  LPFBiquadProcess(destination, in2, outB, 1, frameCount);
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqualWithAccuracy(a[index], b[index], 1e-5);
+  }
+
+  std::vector<float> dc(frameCount, 0.5);
+  float const* dcIns[] = {dc.data()};
+  float* dcOuts[] = {dc.data()};
+  XCTAssertEqual(LPFBiquadSettleToDC(destination, 0, 0.5), LPFBiquadStatusOK);
+  LPFBiquadProcess(destination, dcIns, dcOuts, 1, frameCount);
+  for (size_t index = 0; index < frameCount; ++index) {
+    XCTAssertEqualWithAccuracy(dc[index], 0.5, 1e-5);
+  }
+
+  LPFBiquadDestroy(source);
+  LPFBiquadDestroy(destination);
+}
+
+- (void)testMagnitudes {
+  LPFBiquad* filter = LPFBiquadCreate(1);
+  float frequencies[] = {100.0, 1000.0, 10000.0};
+  float magnitudes[3];
+  XCTAssertEqual(LPFBiquadMagnitudes(filter, frequencies, 3, magnitudes), LPFBiquadStatusNotConfigured);
+
+  LPFBiquadConfigure(filter, 5500.0, 0.707, 41500.0);
+  XCTAssertEqual(LPFBiquadMagnitudes(filter, frequencies, 3, magnitudes), LPFBiquadStatusOK);
+  XCTAssertEqualWithAccuracy(magnitudes[0], 0.0014,   0.0001);
+  XCTAssertEqualWithAccuracy(magnitudes[1], 0.1456,   0.0001);
+  XCTAssertEqualWithAccuracy(magnitudes[2], -12.1972, 0.0001);
+  LPFBiquadDestroy(filter);
+}
+
+- (void)testDeterministic {
+  XCTAssertEqual(LPFBiquadSetDeterministic(nullptr, 1), LPFBiquadStatusInvalidArgument);
+
+  // Processing interleaved or in two halves gives the same bytes as one planar pass
+  LPFBiquad* planar = LPFBiquadCreate(2);
+  LPFBiquad* interleaved = LPFBiquadCreate(2);
+  XCTAssertEqual(LPFBiquadSetDeterministic(planar, 1), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadSetDeterministic(interleaved, 1), LPFBiquadStatusOK);
+  LPFBiquadConfigure(planar, 3000.0, 6.0, 48000.0);
+  LPFBiquadConfigure(interleaved, 3000.0, 6.0, 48000.0);
+
+  std::vector<float> left(256);
+  std::vector<float> right(256);
+  std::vector<float> frames(512);
+  for (size_t index = 0; index < left.size(); ++index) {
+    left[index] = frames[index * 2] = std::sin(index * 0.1f);
+    right[index] = frames[index * 2 + 1] = std::cos(index * 0.37f);
+  }
+
+  float const* ins[] = {left.data(), right.data()};
+  float* outs[] = {left.data(), right.data()};
+  XCTAssertEqual(LPFBiquadProcess(planar, ins, outs, 1, left.size()), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadProcessInterleaved(interleaved, frames.data(), frames.data(), 100), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadProcessInterleaved(interleaved, frames.data() + 200, frames.data() + 200, 156),
+                 LPFBiquadStatusOK);
+  for (size_t index = 0; index < left.size(); ++index) {
+    XCTAssertEqual(frames[index * 2], left[index]);
+    XCTAssertEqual(frames[index * 2 + 1], right[index]);
+  }
+
+  XCTAssertEqual(LPFBiquadSetDeterministic(planar, 0), LPFBiquadStatusOK);
+  LPFBiquadDestroy(planar);
+  LPFBiquadDestroy(interleaved);
+}
+
+- (void)testDeterministicRestoresEngine {
+  LPFBiquad* toggled = LPFBiquadCreate(1);
+  LPFBiquad* plain = LPFBiquadCreate(1);
+  LPFBiquadConfigure(toggled, 3000.0, 6.0, 48000.0);
+  LPFBiquadConfigure(plain, 3000.0, 6.0, 48000.0);
+
+  std::vector<float> first(512);
+  for (size_t index = 0; index < first.size(); ++index) first[index] = std::sin(index * 0.1f);
+  auto second = first;
+
+  // Turning deterministic processing on and off again in mid-stream leaves the filter as it was
+  float const* ins[] = {first.data()};
+  float* outs[] = {first.data()};
+  XCTAssertEqual(LPFBiquadSetDeterministic(toggled, 0), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadProcess(toggled, ins, outs, 1, 256), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadSetDeterministic(toggled, 1), LPFBiquadStatusOK);
+  XCTAssertEqual(LPFBiquadSetDeterministic(toggled, 0), LPFBiquadStatusOK);
+  ins[0] += 256;
+  outs[0] += 256;
+  XCTAssertEqual(LPFBiquadProcess(toggled, ins, outs, 1, 256), LPFBiquadStatusOK);
+
+  ins[0] = outs[0] = second.data();
+  XCTAssertEqual(LPFBiquadProcess(plain, ins, outs, 1, second.size()), LPFBiquadStatusOK);
+  for (size_t index = 0; index < first.size(); ++index) XCTAssertEqualWithAccuracy(first[index], second[index], 1e-5);
+
+  LPFBiquadDestroy(toggled);
+  LPFBiquadDestroy(plain);
+}
+
+@end
@@ -1,14 +1,57 @@
 // Copyright © 2020 Apple. All rights reserved.
 
 #import <XCTest/XCTest.h>
+#import <cstring>
 #import <vector>
 
 #import "BiquadFilter.h"
+#import "TestSignals.hpp"
 
 @interface BiquadFilterTests : XCTestCase
 
 @end
 
+/// @returns FNV-1a hash of the bytes of some samples
+static uint64_t hashSamples(std::vector<float> const& samples) {
+  uint64_t hash = 14695981039346656037ull;
+  for (auto sample : samples) {
+    uint32_t bits;
+    memcpy(&bits, &sample, sizeof(bits));
+    for (int shift = 0; shift < 32; shift += 8) hash = (hash ^ ((bits >> shift) & 0xFF)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/**
+ Filter noise, a cutoff change, and a tail that decays through the denormal range with the deterministic engine,
+ splitting the work into segments of at most the given size, each done by a fresh filter that takes over the previous
+ state. Segments also break where the cutoff changes.
+ */
+static std::vector<float> renderDeterministic(size_t segmentSize) {
+  std::vector<float> samples(8192);
+  TestSignals::whiteNoise(samples.data(), 6144, 1);
+  // Not TestSignals::denormalTail, whose polynomial may be evaluated with or without FMA
+  float tail = 0.5f;
+  for (size_t index = 6144; index < samples.size(); ++index, tail *= 0.9f) samples[index] = tail;
+
+  float nyquistPeriod = 2.0 / 48000.0;
+  BiquadFilter::State state;
+  size_t change = 3000;
+  for (size_t start = 0; start < samples.size();) {
+    size_t end = std::min(start + segmentSize, start < change ? change : samples.size());
+    BiquadFilter filter;
+    filter.setEngine(BiquadFilter::Engine::deterministic);
+    filter.calculateParams(start < change ? 1200.0 : 5000.0, 12.0, nyquistPeriod, 1);
+    filter.setState(0, state);
+    std::vector<const float*> ins{samples.data() + start};
+    std::vector<float*> outs{samples.data() + start};
+    filter.apply(ins, outs, end - start);
+    state = filter.getState(0);
+    start = end;
+  }
+  return samples;
+}
+
 @implementation BiquadFilterTests
 
 - (void)setUp {
@@ -60,4 +103,276 @@
   XCTAssertEqualWithAccuracy(magnitudes[2], -12.1972, 0.0001);
 }
 
+- (void)testEnginesAgree {
+  BiquadFilter accelerate;
+  BiquadFilter portable;
+  float nyquistPeriod = 2.0 / 44100.0;
+  accelerate.calculateParams(2000.0, 6.0, nyquistPeriod, 1);
+  portable.calculateParams(2000.0, 6.0, nyquistPeriod, 1);
+  portable.setEngine(BiquadFilter::Engine::portable);
+  XCTAssertTrue(portable.engine() == BiquadFilter::Engine::portable);
+
+  std::vector<float> a;
+  for (int index = 0; index < 512; ++index) {
+    a.push_back(cos(index * 2.0 * M_PI / 10.0) + cos(index * 2.0 * M_PI / 100.0));
+  }
+  std::vector<float> b(a);
+
+  std::vector<const float*> insA{a.data()};
+  std::vector<float*> outsA{a.data()};
+  std::vector<const float*> insB{b.data()};
+  std::vector<float*> outsB{b.data()};
+  accelerate.apply(insA, outsA, a.size());
+  portable.apply(insB, outsB, b.size());
+
+  for (size_t index = 0; index < a.size(); ++index) {
+    XCTAssertEqualWithAccuracy(a[index], b[index], 1e-5);
+  }
+}
+
+- (void)testStateSnapshotAndRestore {
+  BiquadFilter filter;
+  float nyquistPeriod = 2.0 / 44100.0;
+  filter.calculateParams(1000.0, 10.0, nyquistPeriod, 2);
+
+  std::vector<float> input;
+  for (int index = 0; index < 256; ++index) input.push_back(cos(index * 2.0 * M_PI / 30.0));
+  std::vector<float> left(input);
+  std::vector<float> right(input.size(), 0.0);
+
+  // Filter the first half, remember where the filter is, and then filter the second half.
+  std::vector<const float*> ins{left.data(), right.data()};
+  std::vector<float*> outs{left.data(), right.data()};
+  filter.apply(ins, outs, 128);
+  auto leftState = filter.getState(0);
+  auto rightState = filter.getState(1);
+  XCTAssertEqual(leftState.x1, input[127]);
+  XCTAssertEqual(leftState.x2, input[126]);
+  XCTAssertEqual(leftState.y1, left[127]);
+  XCTAssertEqual(rightState.y1, 0.0f);
+
+  std::vector<float> expected(input.begin() + 128, input.end());
+  std::vector<float> silence(128, 0.0);
+  std::vector<const float*> ins2{expected.data(), silence.data()};
+  std::vector<float*> outs2{expected.data(), silence.data()};
+  filter.apply(ins2, outs2, 128);
+
+  // Rewind to the saved state and filter the second half again.
+  std::vector<float> again(input.begin() + 128, input.end());
+  std::vector<float> silence2(128, 0.0);
+  filter.setState(0, leftState);
+  filter.setState(1, rightState);
+  std::vector<const float*> ins3{again.data(), silence2.data()};
+  std::vector<float*> outs3{again.data(), silence2.data()};
+  filter.apply(ins3, outs3, 128);
+
+  for (size_t index = 0; index < again.size(); ++index) {
+    XCTAssertEqualWithAccuracy(again[index], expected[index], 1e-5);
+    XCTAssertEqual(silence2[index], 0.0f);
+  }
+
+  BiquadFilter copy;
+  copy.calculateParams(1000.0, 10.0, nyquistPeriod, 2);
+  XCTAssertTrue(copy.copyStateFrom(filter));
+  XCTAssertEqual(copy.getState(0).y1, filter.getState(0).y1);
+
+  BiquadFilter mono;
+  mono.calculateParams(1000.0, 10.0, nyquistPeriod, 1);
+  XCTAssertFalse(mono.copyStateFrom(filter));
+
+#if LPF_HAVE_ACCELERATE
+  // Accelerate hands over to the portable engine until the next reset, but stays selected
+  BiquadFilter accelerate;
+  accelerate.calculateParams(1000.0, 10.0, nyquistPeriod, 2);
+  accelerate.setState(0, leftState);
+  XCTAssertTrue(accelerate.engine() == BiquadFilter::Engine::accelerate);
+  XCTAssertTrue(accelerate.activeEngine() == BiquadFilter::Engine::portable);
+  accelerate.resetState();
+  XCTAssertTrue(accelerate.activeEngine() == BiquadFilter::Engine::accelerate);
+#endif
+}
+
+- (void)testSettleToDCAndReset {
+  BiquadFilter filter;
+  float nyquistPeriod = 2.0 / 44100.0;
+  filter.calculateParams(500.0, 12.0, nyquistPeriod, 1);
+  filter.settleToDC(0, 0.25);
+
+  std::vector<float> samples(64, 0.25);
+  std::vector<const float*> ins{samples.data()};
+  std::vector<float*> outs{samples.data()};
+  filter.apply(ins, outs, samples.size());
+  for (auto sample : samples) {
+    XCTAssertEqualWithAccuracy(sample, 0.25, 1e-5);
+  }
+
+  filter.resetState();
+  auto state = filter.getState(0);
+  XCTAssertEqual(state.x1, 0.0f);
+  XCTAssertEqual(state.y2, 0.0f);
+
+  std::vector<float> zeros(64, 0.0);
+  std::vector<const float*> zeroIns{zeros.data()};
+  std::vector<float*> zeroOuts{zeros.data()};
+  filter.apply(zeroIns, zeroOuts, zeros.size());
+  for (auto sample : zeros) {
+    XCTAssertEqual(sample, 0.0f);
+  }
+}
+
+- (void)testApplyLinked {
+  BiquadFilter linked;
+  BiquadFilter stereo;
+  XCTAssertFalse(linked.canLink());
+  float nyquistPeriod = 2.0 / 44100.0;
+  linked.calculateParams(2000.0, 6.0, nyquistPeriod, 2);
+  stereo.calculateParams(2000.0, 6.0, nyquistPeriod, 2);
+  linked.setEngine(BiquadFilter::Engine::portable);
+  stereo.setEngine(BiquadFilter::Engine::portable);
+
+  std::vector<float> input;
+  for (int index = 0; index < 256; ++index) {
+    input.push_back(cos(index * 2.0 * M_PI / 10.0) + cos(index * 2.0 * M_PI / 100.0));
+  }
+
+  // Filtering one channel on behalf of both must match filtering both
+  std::vector<float> left(input.size());
+  std::vector<float> right(input.size());
+  std::vector<const float*> ins{input.data(), input.data()};
+  std::vector<float*> outs{left.data(), right.data()};
+  stereo.apply(ins, outs, input.size());
+
+  std::vector<float> linkedOut(input.size());
+  XCTAssertTrue(linked.canLink());
+  XCTAssertTrue(linked.applyLinked(input.data(), linkedOut.data(), 1, input.size()));
+  XCTAssertTrue(linkedOut == left);
+  XCTAssertTrue(linked.getState(1).y1 == stereo.getState(1).y1);
+
+  // Once the channels diverge they can no longer be linked
+  auto state = linked.getState(1);
+  state.y1 += 1.0;
+  linked.setState(1, state);
+  XCTAssertFalse(linked.canLink());
+  XCTAssertFalse(linked.applyLinked(input.data(), linkedOut.data(), 1, input.size()));
+
+  linked.resetState();
+  XCTAssertTrue(linked.applyLinked(input.data(), linkedOut.data(), 1, input.size()));
+
+#if LPF_HAVE_ACCELERATE
+  // Accelerate links too, with the portable engine standing in for it
+  BiquadFilter accelerate;
+  accelerate.calculateParams(2000.0, 6.0, nyquistPeriod, 2);
+  XCTAssertTrue(accelerate.canLink());
+  XCTAssertTrue(accelerate.applyLinked(input.data(), linkedOut.data(), 1, input.size()));
+  XCTAssertTrue(accelerate.engine() == BiquadFilter::Engine::accelerate);
+  XCTAssertTrue(accelerate.activeEngine() == BiquadFilter::Engine::portable);
+  for (size_t index = 0; index < input.size(); ++index) XCTAssertEqualWithAccuracy(linkedOut[index], left[index], 1e-5);
+#endif
+}
+
+- (void)testLowCutoffUsesCoupledForm {
+  // Start at 1 kHz, drop to 30 Hz and come back, against the same changes in double precision
+  double sampleRate = 96000.0;
+  std::vector<float> input(96000);
+  TestSignals::multiTone(input.data(), input.size(), {{15.0, 0.5f}, {440.0, 0.3f}, {5000.0, 0.2f}}, sampleRate, 0);
+  float const cutoffs[] = {1000.0, 30.0, 1000.0};
+  size_t const starts[] = {0, 1000, 90000, input.size()};
+
+  std::vector<double> expected;
+  double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+  for (size_t segment = 0; segment < 3; ++segment) {
+    const double frequencyRads = M_PI * cutoffs[segment] * 2.0 / sampleRate;
+    const double k = 0.5 * std::sin(frequencyRads);
+    const double c1 = (1.0 - k) / (1.0 + k);
+    const double c2 = (1.0 + c1) * std::cos(frequencyRads);
+    const double c3 = (1.0 + c1 - c2) * 0.25;
+    for (size_t index = starts[segment]; index < starts[segment + 1]; ++index) {
+      double y = c3 * input[index] + 2.0 * c3 * x1 + c3 * x2 + c2 * y1 - c1 * y2;
+      x2 = x1;
+      x1 = input[index];
+      y2 = y1;
+      y1 = y;
+      expected.push_back(y);
+    }
+  }
+
+  BiquadFilter filter;
+  filter.setEngine(BiquadFilter::Engine::portable);
+  BiquadFilter::Engine const active[] = {
+    BiquadFilter::Engine::portable, BiquadFilter::Engine::coupled, BiquadFilter::Engine::portable
+  };
+  std::vector<float> output(input.size());
+  for (size_t segment = 0; segment < 3; ++segment) {
+    filter.calculateParams(cutoffs[segment], 0.0, 2.0 / sampleRate, 1);
+    XCTAssertTrue(filter.engine() == BiquadFilter::Engine::portable);
+    XCTAssertTrue(filter.activeEngine() == active[segment]);
+    float const* in = input.data() + starts[segment];
+    float* out = output.data() + starts[segment];
+    filter.apply(&in, &out, 1, starts[segment + 1] - starts[segment]);
+  }
+
+  // The direct form alone is off by about -50 dB at 30 Hz here, and a switch that dropped the state would click.
+  double signal = 0.0, error = 0.0;
+  for (size_t index = 0; index < output.size(); ++index) {
+    signal += expected[index] * expected[index];
+    error += (output[index] - expected[index]) * (output[index] - expected[index]);
+  }
+  XCTAssertLessThan(10.0 * log10(error / signal), -90.0);
+
+  // The state is still there for the taking while in the coupled form, and a cutoff just above the switching point
+  // keeps it there
+  filter.calculateParams(30.0, 0.0, 2.0 / sampleRate, 1);
+  filter.calculateParams(BiquadFilter::lowCutoff * 1.1f * sampleRate / 2.0f, 0.0, 2.0 / sampleRate, 1);
+  XCTAssertTrue(filter.activeEngine() == BiquadFilter::Engine::coupled);
+  auto state = filter.getState(0);
+  XCTAssertEqual(state.x1, input.back());
+  XCTAssertEqual(state.y1, output.back());
+
+  // The deterministic engine never switches
+  filter.setEngine(BiquadFilter::Engine::deterministic);
+  filter.calculateParams(30.0, 0.0, 2.0 / sampleRate, 1);
+  XCTAssertTrue(filter.activeEngine() == BiquadFilter::Engine::deterministic);
+}
+
+- (void)testDeterministicCoefficients {
+  float nyquistPeriod = 2.0 / 44100.0;
+  for (float frequency : {12.0f, 440.0f, 5500.0f, 20000.0f}) {
+    for (float resonance : {-20.0f, 0.0f, 0.707f, 40.0f}) {
+      auto expected = BiquadFilter::lowPass(frequency, resonance, nyquistPeriod);
+      auto found = BiquadFilter::lowPassDeterministic(frequency, resonance, nyquistPeriod);
+      XCTAssertEqualWithAccuracy(found.b0, expected.b0, 1e-6 + 1e-5 * std::fabs(expected.b0));
+      XCTAssertEqualWithAccuracy(found.a1, expected.a1, 1e-6);
+      XCTAssertEqualWithAccuracy(found.a2, expected.a2, 1e-6);
+    }
+  }
+
+  // Switching engines recalculates the coefficients of a configured filter
+  BiquadFilter filter;
+  filter.calculateParams(440.0, 6.0, nyquistPeriod, 1);
+  filter.setEngine(BiquadFilter::Engine::deterministic);
+  XCTAssertTrue(filter.engine() == BiquadFilter::Engine::deterministic);
+  XCTAssertEqual(filter.coefficients().a1, BiquadFilter::lowPassDeterministic(440.0, 6.0, nyquistPeriod).a1);
+  filter.setState(0, BiquadFilter::State());
+  XCTAssertTrue(filter.engine() == BiquadFilter::Engine::deterministic);
+}
+
+- (void)testDeterministicSegmentsMatch {
+  auto whole = renderDeterministic(8192);
+  for (size_t segmentSize : {1, 7, 256, 1000}) {
+    XCTAssertTrue(renderDeterministic(segmentSize) == whole);
+  }
+
+  // The tail ends in exact silence rather than denormals
+  for (size_t index = 6144; index < whole.size(); ++index) {
+    XCTAssertTrue(whole[index] == 0.0f || std::fabs(whole[index]) >= 1.17549435e-38f);
+  }
+  XCTAssertEqual(whole.back(), 0.0f);
+}
+
+- (void)testDeterministicGolden {
+  // Every machine, compiler and optimization level must produce these exact bytes. A change here breaks reproducibility
+  // of renders made with earlier versions, so it must be deliberate.
+  XCTAssertEqual(hashSamples(renderDeterministic(512)), 0x57dd34044787692eull);
+}
+
 @end
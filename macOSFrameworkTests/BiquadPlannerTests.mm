@@ -0,0 +1,193 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstdio>
+#import <fstream>
+#import <sstream>
+#import <string>
+
+#import "BiquadPlanner.h"
+
+@interface BiquadPlannerTests : XCTestCase
+@end
+
+static std::string makeWisdomPath(char const* name) {
+  std::string path = std::string(NSTemporaryDirectory().UTF8String) + "/" + name;
+  std::remove(path.c_str());
+  return path;
+}
+
+@implementation BiquadPlannerTests
+
+- (void)testBlockSizeBucket {
+  XCTAssertEqual(BiquadPlanner::blockSizeBucket(0), size_t(1));
+  XCTAssertEqual(BiquadPlanner::blockSizeBucket(1), size_t(1));
+  XCTAssertEqual(BiquadPlanner::blockSizeBucket(300), size_t(512));
+  XCTAssertEqual(BiquadPlanner::blockSizeBucket(512), size_t(512));
+  XCTAssertEqual(BiquadPlanner::blockSizeBucket(513), size_t(1024));
+}
+
+- (void)testRememberAndLookup {
+  BiquadPlanner planner("test cpu");
+  BiquadPlanner::Engine engine;
+  XCTAssertFalse(planner.lookup(2, 512, engine));
+
+  planner.remember(2, 512, BiquadPlanner::Engine::portable);
+  XCTAssertTrue(planner.lookup(2, 512, engine));
+  XCTAssertTrue(engine == BiquadPlanner::Engine::portable);
+
+  // Block sizes in the same bucket share wisdom, but channel counts do not
+  XCTAssertTrue(planner.lookup(2, 300, engine));
+  XCTAssertFalse(planner.lookup(1, 512, engine));
+  XCTAssertFalse(planner.lookup(2, 1024, engine));
+}
+
+- (void)testSaveAndLoad {
+  auto path = makeWisdomPath("BiquadPlannerTests.txt");
+
+  BiquadPlanner first("test cpu");
+  first.remember(2, 512, BiquadPlanner::Engine::portable);
+  XCTAssertTrue(first.save(path));
+
+  BiquadPlanner second("test cpu");
+  XCTAssertTrue(second.load(path));
+  BiquadPlanner::Engine engine;
+  XCTAssertTrue(second.lookup(2, 512, engine));
+  XCTAssertTrue(engine == BiquadPlanner::Engine::portable);
+
+  // Wisdom from another CPU is kept but not used
+  BiquadPlanner other("other cpu");
+  XCTAssertTrue(other.load(path));
+  XCTAssertFalse(other.lookup(2, 512, engine));
+
+  std::ofstream(path) << "garbage\n";
+  BiquadPlanner third("test cpu");
+  XCTAssertFalse(third.load(path));
+  XCTAssertFalse(third.load(path + ".missing"));
+
+  std::remove(path.c_str());
+}
+
+- (void)testLoadSkipsBadLines {
+  auto path = makeWisdomPath("BiquadPlannerCorruptTests.txt");
+  std::ofstream(path) << "# BiquadPlanner wisdom 2\n"
+  << "test cpu\tx\t512\tportable\t1.5\n"
+  << "test cpu\t2\t\tportable\t1.5\n"
+  << "test cpu\t-2\t512\tportable\t1.5\n"
+  << "test cpu\t2\t512x\tportable\t1.5\n"
+  << "test cpu\t99999999999999999999999\t512\tportable\t1.5\n"
+  << "test cpu\t2\t1024\tportable\tfast\n"
+  << "test cpu\t2\t1024\tportable\t-1\n"
+  << "test cpu\t2\t1024\tportable\tnan\n"
+  << "test cpu\t2\t1024\tportable\t1e999\n"
+  << "test cpu\t2\n"
+  << "test cpu\t1\t256\tportable\t2.5\n";
+
+  // Only the last line is good, and it must still be loaded
+  BiquadPlanner planner("test cpu");
+  XCTAssertTrue(planner.load(path));
+  BiquadPlanner::Engine engine;
+  XCTAssertFalse(planner.lookup(2, 512, engine));
+  XCTAssertFalse(planner.lookup(2, 1024, engine));
+  XCTAssertTrue(planner.lookup(1, 256, engine));
+  XCTAssertTrue(engine == BiquadPlanner::Engine::portable);
+  XCTAssertEqual(planner.predict(1, 256), 2.5);
+
+  // The same goes for the path given at startup
+  BiquadPlanner configured("test cpu");
+  configured.setWisdomPath(path);
+  XCTAssertTrue(configured.lookup(1, 256, engine));
+
+  std::remove(path.c_str());
+}
+
+- (void)testPlan {
+  auto path = makeWisdomPath("BiquadPlannerPlanTests.txt");
+
+  BiquadPlanner planner("test cpu");
+  planner.setWisdomPath(path);
+  auto engine = planner.plan(2, 256);
+  XCTAssertTrue(engine == BiquadPlanner::Engine::accelerate || engine == BiquadPlanner::Engine::portable ||
+                engine == BiquadPlanner::Engine::coupled);
+#if !LPF_HAVE_ACCELERATE
+  XCTAssertTrue(engine != BiquadPlanner::Engine::accelerate);
+#endif
+
+  // The result was recorded and written out
+  BiquadPlanner::Engine found;
+  XCTAssertTrue(planner.lookup(2, 256, found));
+  XCTAssertTrue(found == engine);
+
+  BiquadPlanner reloaded("test cpu");
+  reloaded.setWisdomPath(path);
+  XCTAssertTrue(reloaded.lookup(2, 256, found));
+  XCTAssertTrue(found == engine);
+
+  XCTAssertGreaterThan(BiquadPlanner::measure(BiquadPlanner::Engine::portable, 2, 64), 0.0);
+  XCTAssertFalse(BiquadPlanner::cpuIdentifier().empty());
+
+  std::remove(path.c_str());
+}
+
+- (void)testPredict {
+  auto path = makeWisdomPath("BiquadPlannerPredictTests.txt");
+
+  BiquadPlanner planner("test cpu");
+  planner.setWisdomPath(path);
+  auto cost = planner.predict(2, 256);
+  XCTAssertGreaterThan(cost, 0.0);
+
+  // Predictions come from wisdom once measured, here and in later launches
+  XCTAssertEqual(planner.predict(2, 200), cost);
+  BiquadPlanner reloaded("test cpu");
+  reloaded.setWisdomPath(path);
+  XCTAssertEqualWithAccuracy(reloaded.predict(2, 256), cost, cost * 1e-5);
+
+  // Wisdom without costs still provides the engine, and the cost is measured when asked for
+  std::ofstream(path) << "# BiquadPlanner wisdom 1\ntest cpu\t1\t512\tportable\n";
+  BiquadPlanner old("test cpu");
+  XCTAssertTrue(old.load(path));
+  BiquadPlanner::Engine engine;
+  XCTAssertTrue(old.lookup(1, 512, engine));
+  XCTAssertTrue(engine == BiquadPlanner::Engine::portable);
+  XCTAssertGreaterThan(old.predict(1, 512), 0.0);
+
+  std::remove(path.c_str());
+}
+
+- (void)testPredictEngine {
+  BiquadPlanner planner("test cpu");
+  planner.remember(1, 256, BiquadPlanner::Engine::portable, 2.5);
+  XCTAssertEqual(planner.predict(BiquadPlanner::Engine::portable, 1, 256), 2.5);
+
+  // Engines that were not planned are measured and the cost kept for next time
+  auto cost = planner.predict(BiquadPlanner::Engine::deterministic, 1, 256);
+  XCTAssertGreaterThan(cost, 0.0);
+  XCTAssertEqual(planner.predict(BiquadPlanner::Engine::deterministic, 1, 200), cost);
+  XCTAssertEqual(planner.predict(1, 256), 2.5);
+}
+
+- (void)testProfile {
+  auto result = BiquadPlanner::profile(BiquadPlanner::Engine::portable, 2, 256);
+  XCTAssertGreaterThan(result.nanosecondsPerSample, 0.0);
+
+  // Counters may be missing (non-Linux, or forbidden by the kernel) but must make sense when present
+  PerfCounters counters;
+  if (result.perSample.valid[PerfCounters::instructions]) {
+    XCTAssertTrue(counters.available(PerfCounters::instructions));
+    XCTAssertGreaterThan(result.perSample.counts[PerfCounters::instructions], 1.0);
+  }
+  else {
+    XCTAssertEqual(result.perSample.ipc(), 0.0);
+  }
+
+  std::ostringstream os;
+  BiquadPlanner::writeProfiles(os, {2}, {64});
+  auto report = os.str();
+  XCTAssertTrue(report.find("portable\t2\t64\t") != std::string::npos);
+  XCTAssertTrue(report.find("deterministic\t2\t64\t") != std::string::npos);
+  XCTAssertTrue(report.find("coupled\t2\t64\t") != std::string::npos);
+  XCTAssertTrue(report.find("IPC") != std::string::npos);
+}
+
+@end
@@ -0,0 +1,187 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <string>
+#import <vector>
+
+#import "BiquadTopologyFilter.h"
+#import "TestSignals.hpp"
+
+@interface BiquadTopologyFilterTests : XCTestCase
+@end
+
+using Topology = BiquadTopologyFilter::Topology;
+
+static Topology const allTopologies[] = {
+  Topology::directForm1, Topology::transposedDirectForm2, Topology::coupledForm, Topology::normalizedLattice
+};
+
+static std::vector<float> makeSignal(size_t frameCount, double sampleRate, size_t seed) {
+  std::vector<float> samples(frameCount);
+  TestSignals::multiTone(samples.data(), frameCount, {{15.0, 0.5f}, {440.0, 0.3f}, {5000.0, 0.2f}}, sampleRate, seed);
+  return samples;
+}
+
+/// Run the same low-pass design in direct form I with double precision throughout.
+static std::vector<double> reference(std::vector<float> const& samples, double frequency, double resonance,
+                                     double sampleRate) {
+  const double frequencyRads = M_PI * frequency * 2.0 / sampleRate;
+  const double r = std::pow(10.0, 0.05 * -resonance);
+  const double k  = 0.5 * r * std::sin(frequencyRads);
+  const double c1 = (1.0 - k) / (1.0 + k);
+  const double c2 = (1.0 + c1) * std::cos(frequencyRads);
+  const double c3 = (1.0 + c1 - c2) * 0.25;
+
+  std::vector<double> output;
+  double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+  for (auto x : samples) {
+    double y = c3 * x + 2.0 * c3 * x1 + c3 * x2 + c2 * y1 - c1 * y2;
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    output.push_back(y);
+  }
+  return output;
+}
+
+/// @returns error power relative to signal power in dB
+static double errorLevel(std::vector<float> const& output, std::vector<double> const& expected) {
+  double signal = 0.0, error = 0.0;
+  for (size_t index = 0; index < output.size(); ++index) {
+    signal += expected[index] * expected[index];
+    error += (output[index] - expected[index]) * (output[index] - expected[index]);
+  }
+  return 10.0 * log10(error / signal);
+}
+
+@implementation BiquadTopologyFilterTests
+
+- (void)testStructuresAgree {
+  double sampleRate = 44100.0;
+  for (float resonance : {-6.0f, 0.0f, 12.0f}) {
+    auto input = makeSignal(2000, sampleRate, 0);
+    auto expected = reference(input, 1000.0, resonance, sampleRate);
+    for (auto topology : allTopologies) {
+      BiquadTopologyFilter filter(topology);
+      filter.calculateParams(1000.0, resonance, 2.0 / sampleRate, 1);
+      std::vector<float> output(input.size());
+      std::vector<float const*> ins{input.data()};
+      std::vector<float*> outs{output.data()};
+      filter.apply(ins, outs, input.size());
+      XCTAssertLessThan(errorLevel(output, expected), -100.0);
+    }
+  }
+}
+
+- (void)testInterleavedChannels {
+  // 5 channels covers a full vector of channels plus a partial one
+  size_t numChannels = 5;
+  double sampleRate = 48000.0;
+  std::vector<std::vector<float>> inputs;
+  for (size_t channel = 0; channel < numChannels; ++channel) inputs.push_back(makeSignal(500, sampleRate, channel * 7));
+
+  std::vector<float> interleaved;
+  for (size_t frame = 0; frame < 500; ++frame) {
+    for (auto const& input : inputs) interleaved.push_back(input[frame]);
+  }
+
+  BiquadTopologyFilter filter(Topology::normalizedLattice);
+  filter.calculateParams(3000.0, 3.0, 2.0 / sampleRate, numChannels);
+  std::vector<float const*> ins;
+  std::vector<float*> outs;
+  for (size_t channel = 0; channel < numChannels; ++channel) {
+    ins.push_back(interleaved.data() + channel);
+    outs.push_back(interleaved.data() + channel);
+  }
+
+  // Two blocks to show that state carries over
+  filter.apply(ins.data(), outs.data(), long(numChannels), 200);
+  for (auto& ptr : ins) ptr += 200 * numChannels;
+  for (auto& ptr : outs) ptr += 200 * numChannels;
+  filter.apply(ins.data(), outs.data(), long(numChannels), 300);
+
+  for (size_t channel = 0; channel < numChannels; ++channel) {
+    auto expected = reference(inputs[channel], 3000.0, 3.0, sampleRate);
+    for (size_t frame = 0; frame < 500; ++frame) {
+      XCTAssertEqualWithAccuracy(interleaved[frame * numChannels + channel], expected[frame], 1e-5);
+    }
+  }
+}
+
+- (void)testLowCutoffNoise {
+  // A 20 Hz low-pass at 192 kHz puts the poles right next to z = 1
+  double sampleRate = 192000.0;
+  auto input = makeSignal(192000, sampleRate, 0);
+  auto expected = reference(input, 20.0, 0.0, sampleRate);
+
+  double levels[4];
+  for (size_t index = 0; index < 4; ++index) {
+    BiquadTopologyFilter filter(allTopologies[index]);
+    filter.calculateParams(20.0, 0.0, 2.0 / sampleRate, 1);
+    XCTAssertTrue(filter.activeTopology() == allTopologies[index]);
+    std::vector<float> output(input.size());
+    float const* in = input.data();
+    float* out = output.data();
+    filter.apply(&in, &out, 1, input.size());
+    levels[index] = errorLevel(output, expected);
+  }
+
+  // The direct forms cannot place the poles; the coupled form and the lattice can.
+  XCTAssertGreaterThan(levels[0], -40.0);
+  XCTAssertGreaterThan(levels[1], -40.0);
+  XCTAssertLessThan(levels[2], -80.0);
+  XCTAssertLessThan(levels[3], -70.0);
+}
+
+- (void)testLoadDirectFormState {
+  // Every structure carries on from the history of a direct form I filter as if it had done the filtering itself
+  double sampleRate = 48000.0;
+  auto input = makeSignal(2000, sampleRate, 3);
+  auto expected = reference(input, 800.0, 6.0, sampleRate);
+  auto split = input.size() / 2;
+  for (auto topology : allTopologies) {
+    BiquadTopologyFilter filter(topology);
+    filter.calculateParams(800.0, 6.0, 2.0 / sampleRate, 2);
+    filter.loadDirectFormState(1, input[split - 1], input[split - 2], float(expected[split - 1]),
+                               float(expected[split - 2]));
+    std::vector<float> silence(input.size() - split);
+    std::vector<float> output(input.size() - split);
+    float const* ins[] = {silence.data(), input.data() + split};
+    float* outs[] = {silence.data(), output.data()};
+    filter.apply(ins, outs, 1, output.size());
+
+    std::vector<double> tail(expected.begin() + split, expected.end());
+    XCTAssertLessThan(errorLevel(output, tail), -100.0);
+    for (auto sample : silence) XCTAssertEqual(sample, 0.0f);
+  }
+}
+
+- (void)testFallbackAndReset {
+  // Strong negative resonance gives real poles, which the coupled form cannot handle
+  BiquadTopologyFilter filter(Topology::coupledForm);
+  filter.calculateParams(1000.0, -20.0, 2.0 / 44100.0, 1);
+  XCTAssertTrue(filter.topology() == Topology::coupledForm);
+  XCTAssertTrue(filter.activeTopology() == Topology::transposedDirectForm2);
+
+  filter.calculateParams(1000.0, 0.0, 2.0 / 44100.0, 1);
+  XCTAssertTrue(filter.activeTopology() == Topology::coupledForm);
+
+  auto input = makeSignal(100, 44100.0, 0);
+  std::vector<float> first(input.size());
+  std::vector<float> second(input.size());
+  float const* in = input.data();
+  float* out = first.data();
+  filter.apply(&in, &out, 1, input.size());
+
+  filter.setTopology(Topology::normalizedLattice);
+  filter.setTopology(Topology::coupledForm);
+  out = second.data();
+  filter.apply(&in, &out, 1, input.size());
+  XCTAssertTrue(first == second);
+
+  XCTAssertEqual(std::string(BiquadTopologyFilter::topologyName(Topology::coupledForm)), std::string("coupled form"));
+}
+
+@end
@@ -0,0 +1,143 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <iostream>
+#import <set>
+#import <vector>
+
+#import "HostScenario.h"
+#import "HostScenarioRunner.h"
+#import "SimplyLowPassKernel.h"
+
+@interface HostScenarioTests : XCTestCase
+@end
+
+static HostScenario::Options findScenario(char const* name) {
+  for (auto const& options : HostScenario::standard()) if (options.name == name) return options;
+  return HostScenario::Options();
+}
+
+@implementation HostScenarioTests
+
+- (void)testRepeatable {
+  auto options = findScenario("everything");
+  HostScenario first(options, 7);
+  HostScenario second(options, 7);
+  HostScenario::Render a, b;
+  while (first.next(a)) {
+    XCTAssertTrue(second.next(b));
+    XCTAssertEqual(a.sampleTime, b.sampleTime);
+    XCTAssertEqual(a.frameCount, b.frameCount);
+    XCTAssertEqual(a.eventCount, b.eventCount);
+  }
+  XCTAssertFalse(second.next(b));
+}
+
+- (void)testOddFrameCounts {
+  auto options = findScenario("odd frame counts");
+  HostScenario scenario(options);
+  HostScenario::Render render;
+  std::set<AUAudioFrameCount> seen;
+  size_t count = 0;
+  while (scenario.next(render)) {
+    XCTAssertGreaterThanOrEqual(render.frameCount, options.minFrameCount);
+    XCTAssertLessThanOrEqual(render.frameCount, options.maxFrameCount);
+    XCTAssertEqual(render.restart, count == 0);
+    seen.insert(render.frameCount);
+    ++count;
+  }
+  XCTAssertEqual(count, options.renderCount);
+  XCTAssertGreaterThan(seen.size(), size_t(100));
+}
+
+- (void)testEventsAreOrderedAndInRange {
+  auto options = findScenario("everything");
+  HostScenario scenario(options);
+  HostScenario::Render render;
+  size_t parameters = 0, ramps = 0, midi = 0, late = 0;
+  while (scenario.next(render)) {
+    size_t count = 0;
+    AUEventSampleTime previous = render.sampleTime - AUEventSampleTime(options.maxLateness);
+    for (auto event = render.events; event != nullptr; event = event->head.next) {
+      XCTAssertGreaterThanOrEqual(event->head.eventSampleTime, previous);
+      XCTAssertLessThan(event->head.eventSampleTime, render.sampleTime + AUEventSampleTime(render.frameCount));
+      previous = event->head.eventSampleTime;
+      if (event->head.eventSampleTime < render.sampleTime) ++late;
+      switch (event->head.eventType) {
+        case AURenderEventParameter: ++parameters; break;
+        case AURenderEventParameterRamp:
+          ++ramps;
+          XCTAssertGreaterThan(event->parameter.rampDurationSampleFrames, AUAudioFrameCount(0));
+          break;
+        case AURenderEventMIDI: ++midi; break;
+        default: XCTAssertTrue(false);
+      }
+      ++count;
+    }
+    XCTAssertEqual(count, render.eventCount);
+  }
+
+  XCTAssertGreaterThan(parameters, size_t(0));
+  XCTAssertGreaterThan(ramps, size_t(0));
+  XCTAssertGreaterThan(late, size_t(0));
+  XCTAssertEqual(midi, options.renderCount * options.midiEventsPerRender);
+}
+
+- (void)testFormatChanges {
+  auto options = findScenario("format changes");
+  HostScenario scenario(options);
+  HostScenario::Render render;
+  std::set<uint32_t> channelCounts;
+  std::set<double> sampleRates;
+  size_t restarts = 0;
+  while (scenario.next(render)) {
+    if (render.restart) {
+      ++restarts;
+      XCTAssertEqual(render.sampleTime, AUEventSampleTime(0));
+    }
+    channelCounts.insert(render.channelCount);
+    sampleRates.insert(render.sampleRate);
+  }
+  XCTAssertEqual(restarts, options.renderCount / options.renderCountPerFormat);
+  XCTAssertEqual(channelCounts.size(), options.channelCounts.size());
+  XCTAssertEqual(sampleRates.size(), options.sampleRates.size());
+}
+
+- (void)testCosts {
+  HostScenario::Costs costs;
+  HostScenario::Render render;
+  render.eventCount = 2;
+  for (uint64_t index = 1; index <= 100; ++index) {
+    render.frameCount = index == 100 ? 10 : 100;
+    costs.record(index * 1000, render);
+  }
+
+  auto report = costs.report("test");
+  XCTAssertEqual(report.renders, size_t(100));
+  XCTAssertEqual(report.frames, uint64_t(99 * 100 + 10));
+  XCTAssertEqual(report.events, uint64_t(200));
+  XCTAssertEqualWithAccuracy(report.p50Microseconds, 51.0, 1e-9);
+  XCTAssertEqualWithAccuracy(report.p99Microseconds, 100.0, 1e-9);
+  XCTAssertEqualWithAccuracy(report.worstMicroseconds, 100.0, 1e-9);
+  XCTAssertEqualWithAccuracy(report.worstNanosecondsPerFrame, 10000.0, 1e-9);
+  XCTAssertEqualWithAccuracy(report.meanNanosecondsPerFrame, 5050000.0 / 9910.0, 1e-9);
+}
+
+- (void)testRunKernel {
+  std::vector<HostScenario::Report> reports;
+  for (auto options : HostScenario::standard()) {
+    options.renderCount = 200;
+    HostScenario scenario(options);
+    SimplyLowPassKernel kernel("HostScenarioTests");
+    auto report = runHostScenario(kernel, scenario);
+    XCTAssertEqual(report.renders, options.renderCount);
+    XCTAssertGreaterThan(report.worstMicroseconds, 0.0);
+    XCTAssertLessThanOrEqual(report.p50Microseconds, report.worstMicroseconds);
+    XCTAssertTrue(std::isfinite(kernel.cutoff()));
+    reports.push_back(report);
+  }
+
+  HostScenario::writeReports(std::cout, reports);
+}
+
+@end
@@ -0,0 +1,148 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <complex>
+#import <vector>
+
+#import "BiquadFilter.h"
+#import "HumRemover.h"
+#import "TestSignals.hpp"
+
+@interface HumRemoverTests : XCTestCase
+@end
+
+static constexpr double sampleRate = 48000.0;
+
+/// Add hum with the given fundamental and 6 harmonics of falling level, starting at sample `start`
+static void addHum(std::vector<float>& samples, double fundamental, size_t start = 0) {
+  std::vector<TestSignals::Tone> tones;
+  for (int harmonic = 1; harmonic <= 6; ++harmonic) tones.push_back({fundamental * harmonic, 0.2f / harmonic});
+  std::vector<float> hum(samples.size());
+  TestSignals::multiTone(hum.data(), hum.size(), tones, sampleRate);
+  for (size_t index = start; index < samples.size(); ++index) samples[index] += hum[index];
+}
+
+/// @returns the amplitude of a sinusoid of the given frequency in a range of samples, found with a Hann-windowed DFT
+static double amplitude(std::vector<float> const& samples, size_t begin, size_t end, double frequency) {
+  std::complex<double> sum;
+  size_t count = end - begin;
+  for (size_t index = 0; index < count; ++index) {
+    double window = 1.0 - std::cos(2.0 * M_PI * index / count);
+    sum += window * double(samples[begin + index]) * std::polar(1.0, -2.0 * M_PI * frequency * index / sampleRate);
+  }
+  return 2.0 * std::abs(sum) / count;
+}
+
+/// Process one channel in blocks of the given size
+static void process(HumRemover& remover, std::vector<float>& samples, size_t blockSize) {
+  for (size_t offset = 0; offset < samples.size(); offset += blockSize) {
+    std::vector<float const*> ins{samples.data() + offset};
+    std::vector<float*> outs{samples.data() + offset};
+    remover.process(ins, outs, std::min(blockSize, samples.size() - offset));
+  }
+}
+
+@implementation HumRemoverTests
+
+- (void)testNotch {
+  float nyquistPeriod = 2.0 / sampleRate;
+  auto c = BiquadFilter::notch(100.0, 30.0, nyquistPeriod);
+  auto gain = [&](double frequency) {
+    auto z1 = std::polar(1.0, -M_PI * frequency * nyquistPeriod);
+    auto z2 = z1 * z1;
+    return std::abs((double(c.b0) + double(c.b1) * z1 + double(c.b2) * z2) /
+                    (1.0 + double(c.a1) * z1 + double(c.a2) * z2));
+  };
+  XCTAssertLessThan(gain(100.0), 1e-3);
+  XCTAssertEqualWithAccuracy(gain(10.0), 1.0, 1e-3);
+  XCTAssertEqualWithAccuracy(gain(1000.0), 1.0, 1e-3);
+  XCTAssertEqualWithAccuracy(gain(110.0), 1.0, 0.05);
+}
+
+- (void)testTracksAndRemovesHum {
+  std::vector<float> music(sampleRate * 4);
+  TestSignals::multiTone(music.data(), music.size(), {{1000.0, 0.3f}, {2500.0, 0.2f}}, sampleRate);
+  std::vector<float> samples(music);
+  addHum(samples, 50.3);
+
+  HumRemover remover;
+  remover.configure(1, sampleRate, HumRemover::Mains::fifty);
+  XCTAssertTrue(remover.locked());
+  XCTAssertEqual(remover.numNotches(), size_t(8));
+  process(remover, samples, 512);
+  XCTAssertEqualWithAccuracy(remover.fundamental(), 50.3, 0.02);
+
+  // In the last second every harmonic is down by more than 50 dB. The music is untouched.
+  size_t lastSecond = samples.size() - size_t(sampleRate);
+  for (int harmonic = 1; harmonic <= 6; ++harmonic) {
+    XCTAssertLessThan(amplitude(samples, lastSecond, samples.size(), 50.3 * harmonic), 0.003 * 0.2 / harmonic);
+  }
+  XCTAssertEqualWithAccuracy(amplitude(samples, lastSecond, samples.size(), 1000.0), 0.3, 0.003);
+  XCTAssertEqualWithAccuracy(amplitude(samples, lastSecond, samples.size(), 2500.0), 0.2, 0.002);
+}
+
+- (void)testAutomaticMains {
+  std::vector<float> samples(sampleRate * 2);
+  TestSignals::whiteNoise(samples.data(), samples.size(), 9, 0.01f);
+  addHum(samples, 59.8);
+
+  HumRemover remover;
+  remover.configure(1, sampleRate);
+  XCTAssertFalse(remover.locked());
+  XCTAssertEqual(remover.fundamental(), 0.0f);
+  process(remover, samples, 256);
+  XCTAssertTrue(remover.locked());
+  XCTAssertEqualWithAccuracy(remover.fundamental(), 59.8, 0.05);
+
+  // Silence does not lock
+  std::vector<float> silence(sampleRate);
+  remover.resetState();
+  process(remover, silence, 256);
+  XCTAssertFalse(remover.locked());
+}
+
+- (void)testFollowsDrift {
+  std::vector<float> samples(sampleRate * 6);
+  std::vector<float> first(samples.size());
+  addHum(first, 49.9);
+  std::vector<float> second(samples.size());
+  addHum(second, 50.25);
+  for (size_t index = 0; index < samples.size(); ++index) samples[index] = index < sampleRate * 3 ? first[index] : second[index];
+
+  HumRemover remover;
+  remover.configure(1, sampleRate, HumRemover::Mains::fifty);
+  std::vector<float> head(samples.begin(), samples.begin() + sampleRate * 3);
+  process(remover, head, 1024);
+  XCTAssertEqualWithAccuracy(remover.fundamental(), 49.9, 0.02);
+
+  process(remover, samples, 1024);
+  XCTAssertEqualWithAccuracy(remover.fundamental(), 50.25, 0.02);
+}
+
+- (void)testBlocksMatchWhole {
+  std::vector<float> left(30000);
+  std::vector<float> right(left.size());
+  TestSignals::whiteNoise({left.data(), right.data()}, left.size(), 4, 0.1f);
+  addHum(left, 60.1);
+  addHum(right, 60.1);
+
+  HumRemover remover;
+  remover.configure(2, sampleRate, HumRemover::Mains::sixty);
+  std::vector<float> wholeLeft(left.size());
+  std::vector<float> wholeRight(left.size());
+  std::vector<float const*> ins{left.data(), right.data()};
+  std::vector<float*> outs{wholeLeft.data(), wholeRight.data()};
+  remover.process(ins, outs, left.size());
+
+  remover.resetState();
+  for (size_t offset = 0; offset < left.size(); offset += 333) {
+    std::vector<float const*> blockIns{left.data() + offset, right.data() + offset};
+    std::vector<float*> blockOuts{left.data() + offset, right.data() + offset};
+    remover.process(blockIns, blockOuts, std::min<size_t>(333, left.size() - offset));
+  }
+  XCTAssertTrue(left == wholeLeft);
+  XCTAssertTrue(right == wholeRight);
+}
+
+@end
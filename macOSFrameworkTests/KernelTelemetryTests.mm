@@ -0,0 +1,134 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <string>
+#import <unistd.h>
+#import <vector>
+
+#import "KernelTelemetry.h"
+
+@interface KernelTelemetryTests : XCTestCase
+@end
+
+static KernelTelemetry::Snapshot const* find(std::vector<KernelTelemetry::Snapshot> const& snapshots,
+                                             std::string const& name) {
+  for (auto const& snapshot : snapshots) if (snapshot.name == name) return &snapshot;
+  return nullptr;
+}
+
+@implementation KernelTelemetryTests
+
+- (void)testBuckets {
+  XCTAssertEqual(KernelTelemetry::bucket(0), size_t(0));
+  XCTAssertEqual(KernelTelemetry::bucket(3), size_t(3));
+  XCTAssertEqual(KernelTelemetry::bucket(4), size_t(4));
+  XCTAssertEqual(KernelTelemetry::bucket(8), size_t(8));
+  XCTAssertEqual(KernelTelemetry::bucket(~uint64_t(0)), KernelTelemetry::histogramSize - 1);
+
+  // Every duration is at most the limit of its bucket and more than the limit of the one before
+  for (uint64_t nanoseconds : {5, 100, 999, 1000, 12345, 1000000, 25000000}) {
+    auto index = KernelTelemetry::bucket(nanoseconds);
+    XCTAssertLessThanOrEqual(double(nanoseconds), KernelTelemetry::bucketLimit(index));
+    XCTAssertGreaterThan(double(nanoseconds), KernelTelemetry::bucketLimit(index - 1));
+  }
+}
+
+- (void)testPublishAndRead {
+  KernelTelemetry telemetry;
+  XCTAssertTrue(telemetry.attach("telemetry test"));
+  telemetry.setSampleRate(48000.0);
+  telemetry.setEngine("portable");
+  telemetry.setMemoryFootprint(8192);
+
+  // 512 frames at 48 kHz gives a budget of about 10.7 ms
+  for (int count = 0; count < 98; ++count) telemetry.recordRender(100000, 512, 1);
+  telemetry.recordRender(2000000, 512, 7);
+  telemetry.recordRender(20000000, 512, 0);
+  telemetry.recordNaNReset();
+  telemetry.recordReserveExhausted();
+  telemetry.recordReserveExhausted();
+  telemetry.recordEventOverflow(300);
+
+  std::vector<KernelTelemetry::Snapshot> snapshots;
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots));
+  auto snapshot = find(snapshots, "telemetry test");
+  XCTAssertTrue(snapshot != nullptr);
+  if (snapshot == nullptr) return;
+
+  XCTAssertEqual(snapshot->engine, std::string("portable"));
+  XCTAssertEqual(snapshot->renders, uint64_t(100));
+  XCTAssertEqual(snapshot->frames, uint64_t(51200));
+  XCTAssertEqual(snapshot->events, uint64_t(105));
+  XCTAssertEqual(snapshot->lastEventsPerBlock, uint64_t(0));
+  XCTAssertEqual(snapshot->maxEventsPerBlock, uint64_t(7));
+  XCTAssertEqual(snapshot->deadlineMisses, uint64_t(1));
+  XCTAssertEqual(snapshot->nanResets, uint64_t(1));
+  XCTAssertEqual(snapshot->reserveExhausted, uint64_t(2));
+  XCTAssertEqual(snapshot->overflowEvents, uint64_t(300));
+  XCTAssertEqual(snapshot->memoryBytes, uint64_t(8192));
+  XCTAssertEqualWithAccuracy(snapshot->maxMicroseconds, 20000.0, 0.001);
+
+  // Percentiles are reported as bucket limits, which are within a quarter octave
+  XCTAssertGreaterThanOrEqual(snapshot->p50Microseconds, 100.0);
+  XCTAssertLessThan(snapshot->p50Microseconds, 125.0);
+  XCTAssertGreaterThanOrEqual(snapshot->p99Microseconds, 2000.0);
+  XCTAssertLessThan(snapshot->p99Microseconds, 2500.0);
+
+  auto text = KernelTelemetry::exposition(getpid(), snapshots);
+  XCTAssertTrue(text.find("# TYPE lpf_renders_total counter") != std::string::npos);
+  XCTAssertTrue(text.find("kernel=\"telemetry test\",engine=\"portable\"} 100\n") != std::string::npos);
+  XCTAssertTrue(text.find("lpf_reserve_exhausted_total{pid=") != std::string::npos);
+
+  telemetry.detach();
+  XCTAssertFalse(telemetry.attached());
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots));
+  XCTAssertTrue(find(snapshots, "telemetry test") == nullptr);
+
+  // Recording without a slot is harmless
+  telemetry.recordRender(1, 1, 1);
+}
+
+
+- (void)testEngineChanges {
+  KernelTelemetry telemetry;
+  XCTAssertTrue(telemetry.attach("engine test"));
+  std::vector<KernelTelemetry::Snapshot> snapshots;
+
+  // Names are cut to 15 characters, and a shorter name replaces all of a longer one
+  telemetry.setEngine("a-very-long-engine-name");
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots));
+  auto snapshot = find(snapshots, "engine test");
+  XCTAssertTrue(snapshot != nullptr);
+  if (snapshot != nullptr) XCTAssertEqual(snapshot->engine, std::string("a-very-long-eng"));
+
+  telemetry.setEngine("coupled");
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots));
+  snapshot = find(snapshots, "engine test");
+  XCTAssertTrue(snapshot != nullptr);
+  if (snapshot != nullptr) XCTAssertEqual(snapshot->engine, std::string("coupled"));
+}
+- (void)testSlotsAreLimited {
+  // Fill a segment of our own so that the process segment is left alone for other tests
+  auto segment = KernelTelemetry::segmentName(getpid()) + "-limits";
+  std::vector<KernelTelemetry> telemetries(KernelTelemetry::slotCount + 2);
+  size_t attached = 0;
+  for (auto& telemetry : telemetries) attached += telemetry.attach("many", segment) ? 1 : 0;
+  XCTAssertEqual(attached, KernelTelemetry::slotCount);
+
+  // The kernels without a slot are counted until they go away
+  std::vector<KernelTelemetry::Snapshot> snapshots;
+  uint64_t dropped = 0;
+  XCTAssertTrue(KernelTelemetry::read(segment, snapshots, &dropped));
+  XCTAssertEqual(snapshots.size(), KernelTelemetry::slotCount);
+  XCTAssertEqual(dropped, uint64_t(2));
+  auto text = KernelTelemetry::exposition(getpid(), snapshots, dropped);
+  XCTAssertTrue(text.find("lpf_dropped_kernels{pid=\"" + std::to_string(getpid()) + "\"} 2\n") != std::string::npos);
+
+  telemetries.back().detach();
+  XCTAssertTrue(KernelTelemetry::read(segment, snapshots, &dropped));
+  XCTAssertEqual(dropped, uint64_t(1));
+
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots) == false || find(snapshots, "many") == nullptr);
+}
+
+@end
@@ -0,0 +1,224 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <chrono>
+#import <thread>
+
+#import "BufferPool.h"
+#import "ReclaimableBuffer.h"
+
+@interface ReclaimableBufferTests : XCTestCase
+@end
+
+using Holding = ReclaimableBuffer::Holding;
+
+@implementation ReclaimableBufferTests
+
+- (void)setUp {
+  // The tests drive maintenance themselves, so keep the background thread out of the way.
+  ReclaimableBuffer::setMaintenanceInterval(std::chrono::hours(1));
+}
+
+- (void)tearDown {
+  ReclaimableBuffer::setMaintenanceInterval(std::chrono::milliseconds(100));
+}
+
+- (void)testPoolReusesAndTrims {
+  BufferPool pool(1, 256, 1000);
+  float* a = pool.acquire(600);
+  float* b = pool.acquire(300);
+  XCTAssertEqual(pool.inUse(), size_t(900));
+
+  // Released blocks are kept up to the limit and handed out again for requests that fit
+  pool.release(b);
+  XCTAssertEqual(pool.retained(), size_t(300));
+  XCTAssertEqual(pool.acquire(200), b);
+  XCTAssertEqual(pool.inUse(), size_t(900));
+  XCTAssertEqual(pool.retained(), size_t(0));
+
+  // Going over the limit frees the largest blocks
+  pool.release(a);
+  pool.release(b);
+  XCTAssertEqual(pool.inUse(), size_t(0));
+  XCTAssertEqual(pool.retained(), size_t(900));
+  pool.setRetainLimit(500);
+  XCTAssertEqual(pool.retained(), size_t(300));
+  pool.setRetainLimit(0);
+  XCTAssertEqual(pool.retained(), size_t(0));
+}
+
+- (void)testReserve {
+  BufferPool pool(2, 256, 0);
+  XCTAssertEqual(pool.acquireReserve(257), nullptr);
+  float* a = pool.acquireReserve(256);
+  float* b = pool.acquireReserve(100);
+  XCTAssertNotEqual(a, nullptr);
+  XCTAssertNotEqual(b, nullptr);
+  XCTAssertNotEqual(a, b);
+  XCTAssertTrue(pool.isReserve(a));
+  XCTAssertEqual(pool.reserveAvailable(), size_t(0));
+  XCTAssertEqual(pool.acquireReserve(100), nullptr);
+  pool.releaseReserve(a);
+  XCTAssertEqual(pool.reserveAvailable(), size_t(1));
+  XCTAssertEqual(pool.acquireReserve(100), a);
+  pool.releaseReserve(a);
+  pool.releaseReserve(b);
+  XCTAssertEqual(pool.inUse(), size_t(0));
+}
+
+- (void)testReserveGrows {
+  BufferPool pool(2, 256, 0);
+  float* small = pool.acquireReserve(256);
+  pool.reserveFor(1024);
+
+  // The free block grew, but the taken one keeps its size until it is free at the next call
+  float* large = pool.acquireReserve(1024);
+  XCTAssertNotEqual(large, nullptr);
+  XCTAssertTrue(pool.isReserve(large));
+  pool.releaseReserve(small);
+  XCTAssertEqual(pool.acquireReserve(1024), nullptr);
+  pool.reserveFor(1024);
+  XCTAssertNotEqual(pool.acquireReserve(1024), nullptr);
+  XCTAssertEqual(pool.reserveAvailable(), size_t(0));
+
+  // Buffers grow the reserve to their size so that they can always borrow from it
+  BufferPool other(1, 256, 0);
+  ReclaimableBuffer buffer(other);
+  buffer.configure(4096, 10);
+  buffer.beginRender();
+  buffer.endRender(10, true);
+  buffer.maintain();
+  XCTAssertEqual(buffer.holding(), Holding::none);
+  XCTAssertTrue(other.isReserve(buffer.beginRender()));
+  buffer.endRender(10, true);
+}
+
+- (void)testReleasesWhenIdleAndComesBack {
+  BufferPool pool(2, 1024, 0);
+  ReclaimableBuffer buffer(pool);
+  buffer.configure(1024, 1000);
+  XCTAssertEqual(buffer.holding(), Holding::own);
+  float* own = buffer.beginRender();
+  XCTAssertNotEqual(own, nullptr);
+  XCTAssertFalse(pool.isReserve(own));
+  buffer.endRender(512, false);
+  XCTAssertEqual(buffer.holding(), Holding::own);
+
+  // Not yet idle for long enough
+  XCTAssertEqual(buffer.beginRender(), own);
+  buffer.endRender(512, true);
+  XCTAssertEqual(buffer.beginRender(), own);
+  buffer.endRender(487, true);
+  XCTAssertEqual(buffer.holding(), Holding::own);
+
+  // Now idle: the storage is retired and freed by maintenance, and each idle render borrows from the reserve
+  XCTAssertEqual(buffer.beginRender(), own);
+  buffer.endRender(512, true);
+  XCTAssertEqual(buffer.holding(), Holding::none);
+  buffer.maintain();
+  XCTAssertEqual(pool.inUse(), size_t(0));
+  float* borrowed = buffer.beginRender();
+  XCTAssertTrue(pool.isReserve(borrowed));
+  buffer.endRender(512, true);
+  XCTAssertEqual(buffer.holding(), Holding::none);
+  XCTAssertEqual(pool.reserveAvailable(), size_t(2));
+  buffer.maintain();
+  XCTAssertEqual(pool.inUse(), size_t(0));
+
+  // Sound returns: keep the reserve block until maintenance delivers new storage at the next render
+  borrowed = buffer.beginRender();
+  XCTAssertTrue(pool.isReserve(borrowed));
+  buffer.endRender(512, false);
+  XCTAssertEqual(buffer.holding(), Holding::reserve);
+  XCTAssertEqual(buffer.beginRender(), borrowed);
+  buffer.endRender(512, false);
+  buffer.maintain();
+  XCTAssertEqual(pool.inUse(), size_t(1024));
+  float* restored = buffer.beginRender();
+  XCTAssertNotEqual(restored, nullptr);
+  XCTAssertFalse(pool.isReserve(restored));
+  buffer.endRender(512, false);
+  XCTAssertEqual(buffer.holding(), Holding::own);
+  XCTAssertEqual(pool.reserveAvailable(), size_t(2));
+
+  buffer.configure(0, 0);
+  XCTAssertEqual(buffer.holding(), Holding::none);
+  XCTAssertEqual(pool.inUse(), size_t(0));
+}
+
+- (void)testPrimeAheadOfNeed {
+  BufferPool pool(1, 1024, 0);
+  ReclaimableBuffer buffer(pool);
+  buffer.configure(1024, 100);
+  buffer.beginRender();
+  buffer.endRender(100, true);
+  buffer.maintain();
+  XCTAssertEqual(buffer.holding(), Holding::none);
+
+  // Storage is waiting for the first render after priming, and is not given back right away even if the input is
+  // still silent.
+  buffer.prime();
+  buffer.maintain();
+  float* storage = buffer.beginRender();
+  XCTAssertFalse(pool.isReserve(storage));
+  buffer.endRender(50, true);
+  XCTAssertEqual(buffer.holding(), Holding::own);
+
+  // Priming while holding storage does nothing
+  buffer.prime();
+  buffer.maintain();
+  XCTAssertEqual(pool.inUse(), size_t(1024));
+}
+
+- (void)testReserveExhausted {
+  BufferPool pool(1, 1024, 0);
+  ReclaimableBuffer first(pool);
+  ReclaimableBuffer second(pool);
+  first.configure(1024, 10);
+  second.configure(1024, 10);
+  for (auto buffer : {&first, &second}) {
+    buffer->beginRender();
+    buffer->endRender(10, true);
+    buffer->maintain();
+  }
+
+  // Both wake up at once; the second has to do without until maintenance catches up
+  XCTAssertNotEqual(first.beginRender(), nullptr);
+  XCTAssertEqual(second.beginRender(), nullptr);
+  first.endRender(10, false);
+  second.endRender(10, false);
+  first.maintain();
+  second.maintain();
+  XCTAssertNotEqual(first.beginRender(), nullptr);
+  XCTAssertNotEqual(second.beginRender(), nullptr);
+  first.endRender(10, false);
+  second.endRender(10, false);
+  XCTAssertEqual(first.holding(), Holding::own);
+  XCTAssertEqual(second.holding(), Holding::own);
+  XCTAssertEqual(pool.reserveAvailable(), size_t(1));
+}
+
+- (void)testMaintenanceThread {
+  ReclaimableBuffer::setMaintenanceInterval(std::chrono::milliseconds(1));
+  BufferPool pool(1, 1024, 0);
+  ReclaimableBuffer buffer(pool);
+  buffer.configure(1024, 10);
+  buffer.beginRender();
+  buffer.endRender(10, true);
+
+  auto waitFor = [&](size_t inUse) {
+    for (int attempt = 0; attempt < 1000 && pool.inUse() != inUse; ++attempt) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pool.inUse() == inUse;
+  };
+  XCTAssertTrue(waitFor(0));
+
+  buffer.beginRender();
+  buffer.endRender(10, false);
+  XCTAssertTrue(waitFor(1024));
+  XCTAssertFalse(pool.isReserve(buffer.beginRender()));
+  buffer.endRender(10, false);
+}
+
+@end
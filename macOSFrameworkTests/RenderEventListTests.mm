@@ -0,0 +1,171 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstring>
+#import <vector>
+
+#import "RenderEventList.h"
+
+@interface RenderEventListTests : XCTestCase
+@end
+
+/**
+ Render events linked in the order they were added, as a host would send them.
+ */
+struct Events {
+  Events(size_t capacity) : events(capacity) {}
+
+  void parameter(AUEventSampleTime time, AUParameterAddress address, AUValue value) {
+    auto& event = add(time, AURenderEventParameter);
+    event.parameter.parameterAddress = address;
+    event.parameter.value = value;
+  }
+
+  void midi(AUEventSampleTime time, uint8_t note) {
+    auto& event = add(time, AURenderEventMIDI);
+    event.MIDI.length = 3;
+    event.MIDI.data[0] = 0x90;
+    event.MIDI.data[1] = note;
+  }
+
+  AURenderEvent const* head() const { return count > 0 ? &events[0] : nullptr; }
+
+  std::vector<AURenderEvent> events;
+  size_t count = 0;
+
+private:
+  AURenderEvent& add(AUEventSampleTime time, AURenderEventType type) {
+    auto& event = events[count];
+    memset(&event, 0, sizeof(event));
+    event.head.eventSampleTime = time;
+    event.head.eventType = type;
+    if (count > 0) events[count - 1].head.next = &event;
+    ++count;
+    return event;
+  }
+};
+
+@implementation RenderEventListTests
+
+- (void)testSortedListIsUnchanged {
+  Events events(4);
+  events.parameter(1000, 1, 100.0);
+  events.parameter(1010, 2, 3.0);
+  events.midi(1010, 60);
+  events.parameter(1200, 1, 200.0);
+
+  RenderEventList list;
+  list.allocate();
+  list.assign(events.head(), 1000, 512);
+  XCTAssertEqual(list.size(), size_t(4));
+  for (size_t index = 0; index < 4; ++index) {
+    XCTAssertEqual(list[index].event, &events.events[index]);
+    XCTAssertEqual(list[index].time, events.events[index].head.eventSampleTime);
+  }
+  XCTAssertEqual(list.clamped(), size_t(0));
+  XCTAssertEqual(list.superseded(), size_t(0));
+  XCTAssertEqual(list.overflow(), nullptr);
+
+  list.assign(nullptr, 1512, 512);
+  XCTAssertEqual(list.size(), size_t(0));
+}
+
+- (void)testSortKeepsHostOrderForEqualTimes {
+  Events events(5);
+  events.parameter(1300, 1, 1.0);
+  events.midi(1100, 60);
+  events.parameter(1100, 2, 2.0);
+  events.midi(1100, 61);
+  events.parameter(1050, 1, 3.0);
+
+  RenderEventList list;
+  list.allocate();
+  list.assign(events.head(), 1000, 512);
+  XCTAssertEqual(list.size(), size_t(5));
+  AURenderEvent const* expected[] = {&events.events[4], &events.events[1], &events.events[2], &events.events[3],
+    &events.events[0]};
+  for (size_t index = 0; index < 5; ++index) XCTAssertEqual(list[index].event, expected[index]);
+  for (size_t index = 1; index < 5; ++index) XCTAssertLessThanOrEqual(list[index - 1].time, list[index].time);
+}
+
+- (void)testClampsToRender {
+  Events events(4);
+  events.parameter(100, 1, 1.0);
+  events.parameter(1100, 2, 2.0);
+  events.parameter(5000, 2, 3.0);
+  events.parameter(1512, 1, 4.0);
+
+  RenderEventList list;
+  list.allocate();
+  list.assign(events.head(), 1000, 512);
+  XCTAssertEqual(list.size(), size_t(4));
+  XCTAssertEqual(list.clamped(), size_t(2));
+  XCTAssertEqual(list[0].time, AUEventSampleTime(1000));
+  XCTAssertEqual(list[0].event, &events.events[0]);
+  XCTAssertEqual(list[1].time, AUEventSampleTime(1100));
+  XCTAssertEqual(list[2].time, AUEventSampleTime(1512));
+  XCTAssertEqual(list[2].event, &events.events[2]);
+  XCTAssertEqual(list[3].time, AUEventSampleTime(1512));
+  XCTAssertEqual(list[3].event, &events.events[3]);
+}
+
+- (void)testDropsSupersededChanges {
+  Events events(8);
+  events.parameter(1100, 1, 1.0);
+  events.parameter(1100, 2, 2.0);
+  events.midi(1100, 60);
+  events.parameter(1100, 1, 3.0);
+  events.midi(1100, 60);
+  events.parameter(1200, 1, 4.0);
+  // Late changes all land at the start of the render, where the last one wins
+  events.parameter(900, 2, 5.0);
+  events.parameter(990, 2, 6.0);
+
+  RenderEventList list;
+  list.allocate();
+  list.assign(events.head(), 1000, 512);
+  XCTAssertEqual(list.superseded(), size_t(2));
+  XCTAssertEqual(list.size(), size_t(6));
+  AURenderEvent const* expected[] = {&events.events[7], &events.events[1], &events.events[2], &events.events[3],
+    &events.events[4], &events.events[5]};
+  for (size_t index = 0; index < 6; ++index) XCTAssertEqual(list[index].event, expected[index]);
+  XCTAssertEqual(list[0].event->parameter.value, 6.0f);
+  XCTAssertEqual(list[3].event->parameter.value, 3.0f);
+}
+
+- (void)testOverflow {
+  Events events(5);
+  for (int index = 0; index < 5; ++index) events.parameter(1400 - index * 100, 1, float(index));
+
+  RenderEventList list;
+  list.allocate(3);
+  list.assign(events.head(), 1000, 512);
+  XCTAssertEqual(list.size(), size_t(3));
+  XCTAssertEqual(list.overflow(), &events.events[3]);
+  XCTAssertEqual(list[0].time, AUEventSampleTime(1200));
+  XCTAssertEqual(list[2].time, AUEventSampleTime(1400));
+
+  // Overflowing changes that are older than one in the list would undo it, unlike late ones and other events
+  XCTAssertTrue(list.overridden(&events.events[3]));
+  XCTAssertTrue(list.overridden(&events.events[4]));
+  Events late(5);
+  late.parameter(1150, 1, 1.0);
+  late.parameter(1200, 2, 2.0);
+  late.parameter(1100, 1, 3.0);
+  late.parameter(1200, 1, 4.0);
+  late.midi(1000, 60);
+  list.allocate(2);
+  list.assign(late.head(), 1000, 512);
+  XCTAssertEqual(list.overflow(), &late.events[2]);
+  XCTAssertTrue(list.overridden(&late.events[2]));
+  XCTAssertFalse(list.overridden(&late.events[3]));
+  XCTAssertFalse(list.overridden(&late.events[4]));
+
+  // Without room nothing is kept
+  RenderEventList empty;
+  empty.assign(events.head(), 1000, 512);
+  XCTAssertEqual(empty.size(), size_t(0));
+  XCTAssertEqual(empty.overflow(), events.head());
+}
+
+@end
@@ -0,0 +1,94 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "SIMDMath.hpp"
+
+using namespace SIMDMath;
+
+@interface SIMDMathTests : XCTestCase
+@end
+
+@implementation SIMDMathTests
+
+- (void)testSinCos {
+  for (int index = -20000; index <= 20000; ++index) {
+    float x = index * 0.005;
+    Native s, c;
+    sincos<Accuracy::precise>(splat<Native>(x), s, c);
+    XCTAssertEqualWithAccuracy(s[0], std::sin(double(x)), 2e-7);
+    XCTAssertEqualWithAccuracy(c[0], std::cos(double(x)), 2e-7);
+    XCTAssertEqualWithAccuracy(SIMDMath::sin<Accuracy::balanced>(x), std::sin(double(x)), 2e-6);
+    XCTAssertEqualWithAccuracy(SIMDMath::cos<Accuracy::fast>(x), std::cos(double(x)), 5e-4);
+  }
+}
+
+- (void)testExp2 {
+  for (int index = -10000; index <= 10000; ++index) {
+    float x = index * 0.01;
+    double expected = std::exp2(double(x));
+    XCTAssertEqualWithAccuracy(SIMDMath::exp2<Accuracy::precise>(x), expected, expected * 2e-7);
+    XCTAssertEqualWithAccuracy(SIMDMath::exp2<Accuracy::balanced>(x), expected, expected * 4e-6);
+    XCTAssertEqualWithAccuracy(SIMDMath::exp2<Accuracy::fast>(x), expected, expected * 2e-4);
+  }
+
+  XCTAssertEqual(SIMDMath::exp2(200.0f), INFINITY);
+  XCTAssertEqual(SIMDMath::exp2(-200.0f), 0.0f);
+}
+
+- (void)testLog2 {
+  for (int index = -10000; index <= 10000; ++index) {
+    float x = std::exp(index * 0.005);
+    double expected = std::log2(double(x));
+    double accuracy = 1e-6 + std::fabs(expected) * 2e-7;
+    XCTAssertEqualWithAccuracy(SIMDMath::log2<Accuracy::precise>(x), expected, accuracy);
+    XCTAssertEqualWithAccuracy(SIMDMath::log10<Accuracy::precise>(x), std::log10(double(x)), accuracy);
+    XCTAssertEqualWithAccuracy(SIMDMath::log2<Accuracy::fast>(x), expected, accuracy + 2e-5);
+  }
+
+  XCTAssertEqual(SIMDMath::log2(0.0f), -INFINITY);
+  XCTAssertEqual(SIMDMath::log2(INFINITY), INFINITY);
+  XCTAssertTrue(std::isnan(SIMDMath::log2(-1.0f)));
+}
+
+- (void)testPow {
+  for (int index = 1; index <= 1000; ++index) {
+    float x = index * 0.01;
+    double expected = std::pow(double(x), 1.7);
+    XCTAssertEqualWithAccuracy(SIMDMath::pow<Accuracy::precise>(x, 1.7f), expected, expected * 1e-6);
+  }
+
+  XCTAssertEqual(SIMDMath::pow(0.0f, 2.0f), 0.0f);
+  XCTAssertEqual(SIMDMath::pow(2.0f, 0.0f), 1.0f);
+}
+
+- (void)testTanh {
+  for (int index = -10000; index <= 10000; ++index) {
+    float x = index * 0.001;
+    XCTAssertEqualWithAccuracy(SIMDMath::tanh<Accuracy::precise>(x), std::tanh(double(x)), 2e-7);
+    XCTAssertEqualWithAccuracy(SIMDMath::tanh<Accuracy::fast>(x), std::tanh(double(x)), 1e-4);
+  }
+
+  XCTAssertEqual(SIMDMath::tanh(100.0f), 1.0f);
+  XCTAssertEqual(SIMDMath::tanh(-100.0f), -1.0f);
+}
+
+- (void)testArrays {
+  std::vector<float> input;
+  for (int index = 0; index < 13; ++index) input.push_back(index * 0.3);
+  std::vector<float> output(input.size(), 0.0);
+
+  SIMDMath::sin(input.data(), output.data(), input.size());
+  for (size_t index = 0; index < input.size(); ++index) {
+    XCTAssertEqualWithAccuracy(output[index], std::sin(input[index]), 2e-6);
+  }
+
+  SIMDMath::exp2(input.data(), output.data(), input.size());
+  for (size_t index = 0; index < input.size(); ++index) {
+    XCTAssertEqualWithAccuracy(output[index], std::exp2(input[index]), output[index] * 4e-6);
+  }
+}
+
+@end
@@ -0,0 +1,155 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "SampleRateConverter.h"
+#import "TestSignals.hpp"
+
+@interface SampleRateConverterTests : XCTestCase
+@end
+
+/**
+ Convert a mono signal in blocks of the given size.
+
+ @returns the converted samples
+ */
+static std::vector<float> convert(SampleRateConverter& converter, std::vector<float> const& input, size_t blockSize) {
+  std::vector<float> output;
+  for (size_t offset = 0; offset < input.size(); offset += blockSize) {
+    size_t count = std::min(blockSize, input.size() - offset);
+    size_t start = output.size();
+    output.resize(start + converter.outputFrameCount(count));
+    float const* ins[] = {input.data() + offset};
+    float* outs[] = {output.data() + start};
+    size_t produced = converter.process(ins, outs, count);
+    if (produced != output.size() - start) return {};
+  }
+  return output;
+}
+
+/// @returns the RMS value of samples in a range
+static double rms(std::vector<float> const& samples, size_t begin, size_t end) {
+  double sum = 0.0;
+  for (size_t index = begin; index < end; ++index) sum += double(samples[index]) * samples[index];
+  return std::sqrt(sum / (end - begin));
+}
+
+@implementation SampleRateConverterTests
+
+- (void)testConfigure {
+  SampleRateConverter converter;
+  XCTAssertTrue(converter.configure(44100.0, 48000.0, 2));
+  XCTAssertEqual(converter.upFactor(), size_t(160));
+  XCTAssertEqual(converter.downFactor(), size_t(147));
+  XCTAssertEqual(converter.numChannels(), size_t(2));
+
+  XCTAssertTrue(converter.configure(48000.0, 192000.0, 1));
+  XCTAssertEqual(converter.upFactor(), size_t(4));
+  XCTAssertEqual(converter.downFactor(), size_t(1));
+
+  XCTAssertTrue(converter.configure(96000.0, 48000.0, 1));
+  XCTAssertEqual(converter.upFactor(), size_t(1));
+  XCTAssertEqual(converter.downFactor(), size_t(2));
+
+  XCTAssertFalse(converter.configure(44100.5, 48000.0, 1));
+  XCTAssertFalse(converter.configure(0.0, 48000.0, 1));
+  XCTAssertFalse(converter.configure(44100.0, 48000.0, 0));
+  XCTAssertFalse(converter.configure(44101.0, 48000.0, 1));
+}
+
+- (void)testFrameCounts {
+  SampleRateConverter converter;
+  converter.configure(44100.0, 48000.0, 1);
+  std::vector<float> input(44100, 0.0f);
+  for (size_t blockSize : {1, 64, 441, 4096}) {
+    converter.resetState();
+    XCTAssertEqual(convert(converter, input, blockSize).size(), size_t(48000));
+  }
+
+  converter.configure(192000.0, 48000.0, 1);
+  XCTAssertEqual(converter.outputFrameCount(5), size_t(2));
+  XCTAssertEqual(convert(converter, std::vector<float>(1000), 7).size(), size_t(250));
+}
+
+- (void)testBlocksMatchWhole {
+  std::vector<float> input(20000);
+  TestSignals::whiteNoise(input.data(), input.size(), 3);
+  for (auto rates : std::vector<std::pair<double, double>>{{44100.0, 48000.0}, {48000.0, 44100.0}, {48000.0, 96000.0},
+                                                          {192000.0, 48000.0}}) {
+    SampleRateConverter converter;
+    converter.configure(rates.first, rates.second, 1);
+    auto whole = convert(converter, input, input.size());
+    for (size_t blockSize : {1, 13, 512, 1500}) {
+      converter.resetState();
+      XCTAssertTrue(convert(converter, input, blockSize) == whole);
+    }
+  }
+}
+
+- (void)testSinePassesWithLatency {
+  double frequency = 1000.0;
+  for (auto rates : std::vector<std::pair<double, double>>{{44100.0, 48000.0}, {48000.0, 44100.0}, {48000.0, 192000.0},
+                                                          {192000.0, 48000.0}}) {
+    double inputRate = rates.first;
+    double outputRate = rates.second;
+    std::vector<float> input(size_t(inputRate / 4));
+    TestSignals::sine(input.data(), input.size(), frequency, inputRate);
+
+    SampleRateConverter converter;
+    converter.configure(inputRate, outputRate, 1);
+    auto output = convert(converter, input, 480);
+    double delay = converter.latency() / inputRate;
+    for (size_t index = output.size() / 2; index < output.size(); ++index) {
+      double expected = std::sin(2.0 * M_PI * frequency * (index / outputRate - delay));
+      XCTAssertEqualWithAccuracy(output[index], expected, 2e-3);
+    }
+  }
+}
+
+- (void)testRejectsAliases {
+  // A 30 kHz tone at 192 kHz would fold down to 18 kHz at 48 kHz; it must be removed before decimating.
+  std::vector<float> input(96000);
+  TestSignals::sine(input.data(), input.size(), 30000.0, 192000.0);
+  SampleRateConverter converter;
+  converter.configure(192000.0, 48000.0, 1);
+  auto output = convert(converter, input, 1024);
+  XCTAssertLessThan(rms(output, 1000, output.size()), 1e-4 * M_SQRT1_2);
+
+  // Likewise the images of a 10 kHz tone at 44.1 kHz must not appear when upsampling to 88.2 kHz: compare against the
+  // same tone made at the output rate.
+  std::vector<float> tone(44100);
+  TestSignals::sine(tone.data(), tone.size(), 10000.0, 44100.0);
+  converter.configure(44100.0, 88200.0, 1);
+  output = convert(converter, tone, 1024);
+  double delay = converter.latency() / 44100.0;
+  double error = 0.0;
+  for (size_t index = 1000; index < output.size(); ++index) {
+    double expected = std::sin(2.0 * M_PI * 10000.0 * (index / 88200.0 - delay));
+    error = std::max(error, std::fabs(output[index] - expected));
+  }
+  XCTAssertLessThan(error, 2e-3);
+}
+
+- (void)testChannelsAreIndependent {
+  std::vector<float> left(4800);
+  std::vector<float> right(4800);
+  TestSignals::whiteNoise({left.data(), right.data()}, left.size(), 11);
+
+  SampleRateConverter stereo;
+  stereo.configure(48000.0, 44100.0, 2);
+  std::vector<float> outLeft(stereo.outputFrameCount(left.size()));
+  std::vector<float> outRight(outLeft.size());
+  std::vector<float const*> ins{left.data(), right.data()};
+  std::vector<float*> outs{outLeft.data(), outRight.data()};
+  XCTAssertEqual(stereo.process(ins, outs, left.size()), outLeft.size());
+
+  SampleRateConverter mono;
+  mono.configure(48000.0, 44100.0, 1);
+  XCTAssertTrue(convert(mono, left, left.size()) == outLeft);
+  mono.resetState();
+  XCTAssertTrue(convert(mono, right, right.size()) == outRight);
+}
+
+@end
@@ -0,0 +1,118 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <chrono>
+#import <cstddef>
+#import <cstring>
+#import <iostream>
+#import <memory>
+#import <string>
+#import <unistd.h>
+#import <vector>
+
+#import "KernelTelemetry.h"
+#import "SimplyLowPassKernel.h"
+
+@interface SimplyLowPassKernelTests : XCTestCase
+@end
+
+/// Number of instances in a large session
+static constexpr size_t instanceCount = 500;
+
+@implementation SimplyLowPassKernelTests
+
+- (void)testStartProcessingUsesFormat {
+  SimplyLowPassKernel kernel("SimplyLowPassKernelTests");
+  XCTAssertEqualWithAccuracy(kernel.nyquistPeriod(), 1.0 / 22050.0, 1e-12);
+
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:96000.0 channels:2];
+  kernel.startProcessing(format, 512);
+  XCTAssertEqualWithAccuracy(kernel.nyquistPeriod(), 1.0 / 48000.0, 1e-12);
+  kernel.stopProcessing();
+}
+
+- (void)testTelemetryAfterStartProcessing {
+  std::string name("SimplyLowPassKernelTests telemetry");
+  SimplyLowPassKernel kernel(name);
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:48000.0 channels:2];
+  kernel.startProcessing(format, 512);
+
+  // Low enough for the filter to run in the coupled form, which must show up as the engine
+  kernel.setParameterValue(FilterParameterAddressCutoff, 100.0);
+
+  // An upstream node that takes 20 ms to deliver 512 frames, twice the 10.7 ms budget
+  AURenderPullInputBlock pullInput = ^AUAudioUnitStatus(AudioUnitRenderActionFlags* actionFlags,
+                                                        AudioTimeStamp const* timestamp,
+                                                        AUAudioFrameCount frameCount, NSInteger inputBusNumber,
+                                                        AudioBufferList* input) {
+    for (UInt32 channel = 0; channel < input->mNumberBuffers; ++channel) {
+      auto ptr = static_cast<float*>(input->mBuffers[channel].mData);
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) ptr[frame] = 0.25f;
+    }
+    usleep(20000);
+    return noErr;
+  };
+
+  std::vector<std::vector<float>> samples(2, std::vector<float>(512));
+  std::vector<char> outputStorage(offsetof(AudioBufferList, mBuffers) + sizeof(AudioBuffer) * 2, 0);
+  auto output = reinterpret_cast<AudioBufferList*>(outputStorage.data());
+  output->mNumberBuffers = 2;
+  for (UInt32 channel = 0; channel < 2; ++channel) {
+    output->mBuffers[channel].mNumberChannels = 1;
+    output->mBuffers[channel].mDataByteSize = UInt32(512 * sizeof(float));
+    output->mBuffers[channel].mData = samples[channel].data();
+  }
+
+  AudioTimeStamp timestamp;
+  memset(&timestamp, 0, sizeof(timestamp));
+  timestamp.mFlags = kAudioTimeStampSampleTimeValid;
+  XCTAssertEqual(kernel.processAndRender(&timestamp, 512, 0, output, nullptr, pullInput), noErr);
+
+  std::vector<KernelTelemetry::Snapshot> snapshots;
+  XCTAssertTrue(KernelTelemetry::read(getpid(), snapshots));
+  KernelTelemetry::Snapshot const* snapshot = nullptr;
+  for (auto const& entry : snapshots) if (entry.name == name) snapshot = &entry;
+  XCTAssertTrue(snapshot != nullptr);
+  if (snapshot != nullptr) {
+    XCTAssertEqual(snapshot->sampleRate, 48000.0);
+    XCTAssertEqual(snapshot->renders, uint64_t(1));
+    XCTAssertEqual(snapshot->deadlineMisses, uint64_t(1));
+    XCTAssertEqual(snapshot->engine, std::string("coupled"));
+  }
+
+  // Predictions are for the engine doing the filtering as well
+  auto predicted = kernel.predictedNanosecondsPerSample();
+  XCTAssertGreaterThan(predicted, 0.0);
+  XCTAssertEqual(predicted, BiquadPlanner::shared().predict(BiquadPlanner::Engine::coupled, 2, 512));
+
+  kernel.stopProcessing();
+}
+
+- (void)testInstantiationBenchmark {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:48000.0 channels:2];
+
+  // Prime the planner so that engine selection is not part of the measurement
+  SimplyLowPassKernel(std::string("SimplyLowPassKernelTests")).startProcessing(format, 512);
+
+  [self measureBlock:^{
+    std::vector<std::unique_ptr<SimplyLowPassKernel>> kernels;
+    kernels.reserve(instanceCount);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < instanceCount; ++index) {
+      kernels.emplace_back(new SimplyLowPassKernel("SimplyLowPassKernelTests"));
+    }
+
+    auto created = std::chrono::steady_clock::now();
+    for (auto& kernel : kernels) kernel->startProcessing(format, 512);
+
+    auto prepared = std::chrono::steady_clock::now();
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    std::cout << "create: " << Microseconds(created - start).count() / instanceCount << " us/instance, prepare: "
+    << Microseconds(prepared - created).count() / instanceCount << " us/instance\n";
+
+    for (auto& kernel : kernels) kernel->stopProcessing();
+  }];
+}
+
+@end
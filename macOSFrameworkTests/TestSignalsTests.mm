@@ -0,0 +1,163 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "TestSignals.hpp"
+
+@interface TestSignalsTests : XCTestCase
+@end
+
+/// @returns mean square of the first difference, which rises with the high-frequency content of a signal
+static double differenceEnergy(std::vector<float> const& samples) {
+  double sum = 0.0;
+  for (size_t index = 1; index < samples.size(); ++index) {
+    double delta = samples[index] - samples[index - 1];
+    sum += delta * delta;
+  }
+  return sum / (samples.size() - 1);
+}
+
+static double energy(std::vector<float> const& samples) {
+  double sum = 0.0;
+  for (auto sample : samples) sum += double(sample) * sample;
+  return sum / samples.size();
+}
+
+@implementation TestSignalsTests
+
+- (void)testSine {
+  std::vector<float> samples(10001);
+  TestSignals::sine(samples.data(), samples.size(), 1000.0, 48000.0, 0.5f);
+  for (size_t index = 0; index < samples.size(); ++index) {
+    XCTAssertEqualWithAccuracy(samples[index], 0.5 * std::sin(2.0 * M_PI * 1000.0 * index / 48000.0), 2e-6);
+  }
+
+  // Far into a long signal the phase is still exact
+  size_t start = 48000 * 3600;
+  TestSignals::sine(samples.data(), 3, 1000.0, 48000.0, 1.0f, start + 1);
+  XCTAssertEqualWithAccuracy(samples[0], std::sin(2.0 * M_PI * 1000.0 / 48000.0), 2e-6);
+}
+
+- (void)testChunksMatchWhole {
+  std::vector<float> whole(1000);
+  std::vector<float> chunks(1000);
+  std::vector<TestSignals::Tone> tones{{100.0, 0.5f}, {3000.0, 0.25f}};
+
+  TestSignals::multiTone(whole.data(), whole.size(), tones, 44100.0);
+  for (size_t start = 0; start < chunks.size(); start += 333) {
+    TestSignals::multiTone(chunks.data() + start, std::min<size_t>(333, chunks.size() - start), tones, 44100.0, start);
+  }
+  XCTAssertTrue(whole == chunks);
+
+  TestSignals::whiteNoise(whole.data(), whole.size(), 42);
+  for (size_t start = 0; start < chunks.size(); start += 7) {
+    TestSignals::whiteNoise(chunks.data() + start, std::min<size_t>(7, chunks.size() - start), 42, 1.0f, start);
+  }
+  XCTAssertTrue(whole == chunks);
+
+  TestSignals::PinkNoise pink(42);
+  pink.generate(whole.data(), whole.size());
+  TestSignals::PinkNoise pinkChunks(42);
+  pinkChunks.generate(chunks.data(), 501);
+  pinkChunks.generate(chunks.data() + 501, chunks.size() - 501);
+  XCTAssertTrue(whole == chunks);
+}
+
+- (void)testMultiTone {
+  std::vector<float> samples(4096);
+  TestSignals::multiTone(samples.data(), samples.size(), {{440.0, 0.5f}, {1760.0, 0.25f}}, 44100.0);
+  for (size_t index = 0; index < samples.size(); ++index) {
+    double expected = 0.5 * std::sin(2.0 * M_PI * 440.0 * index / 44100.0) +
+    0.25 * std::sin(2.0 * M_PI * 1760.0 * index / 44100.0);
+    XCTAssertEqualWithAccuracy(samples[index], expected, 3e-6);
+  }
+}
+
+- (void)testLogSweep {
+  double sampleRate = 48000.0;
+  size_t length = 48000;
+  std::vector<float> samples(length);
+  TestSignals::logSweep(samples.data(), length, 20.0, 20000.0, length, sampleRate);
+
+  double scale = length / sampleRate / std::log(1000.0);
+  for (size_t index = 0; index < length; index += 97) {
+    double phase = 2.0 * M_PI * 20.0 * scale * (std::exp(index / sampleRate / scale) - 1.0);
+    XCTAssertEqualWithAccuracy(samples[index], std::sin(phase), 2e-4);
+  }
+
+  // Frequency rises a decade every third of the sweep, so the last tenth crosses zero far more often than the first
+  auto crossings = [&](size_t begin, size_t end) {
+    size_t count = 0;
+    for (size_t index = begin + 1; index < end; ++index) count += (samples[index - 1] < 0) != (samples[index] < 0);
+    return count;
+  };
+  XCTAssertGreaterThan(crossings(length * 9 / 10, length), 100 * crossings(0, length / 10));
+}
+
+- (void)testWhiteNoise {
+  std::vector<float> a(100000);
+  std::vector<float> b(100000);
+  TestSignals::whiteNoise(a.data(), a.size(), 1);
+  TestSignals::whiteNoise(b.data(), b.size(), 2);
+  XCTAssertTrue(a != b);
+
+  double sum = 0.0;
+  for (auto sample : a) {
+    XCTAssertGreaterThanOrEqual(sample, -1.0f);
+    XCTAssertLessThan(sample, 1.0f);
+    sum += sample;
+  }
+  XCTAssertEqualWithAccuracy(sum / a.size(), 0.0, 0.01);
+  XCTAssertEqualWithAccuracy(energy(a), 1.0 / 3.0, 0.01);
+
+  // Uncorrelated samples: the difference has twice the energy of the signal
+  XCTAssertEqualWithAccuracy(differenceEnergy(a) / energy(a), 2.0, 0.05);
+
+  std::vector<float> c(1000);
+  std::vector<float> d(1000);
+  TestSignals::whiteNoise({c.data(), d.data()}, c.size(), 1);
+  XCTAssertTrue(std::equal(c.begin(), c.end(), a.begin()));
+  XCTAssertTrue(std::equal(d.begin(), d.end(), b.begin()));
+}
+
+- (void)testPinkNoise {
+  std::vector<float> samples(1 << 18);
+  TestSignals::PinkNoise pink(7);
+  pink.generate(samples.data(), samples.size());
+
+  float peak = 0.0f;
+  for (auto sample : samples) peak = std::max(peak, std::fabs(sample));
+  XCTAssertLessThan(peak, 1.0f);
+  XCTAssertGreaterThan(peak, 0.25f);
+
+  // Most of the energy of pink noise is at low frequencies, unlike white noise
+  XCTAssertLessThan(differenceEnergy(samples) / energy(samples), 0.5);
+}
+
+- (void)testImpulse {
+  std::vector<float> samples(64, 3.0f);
+  TestSignals::impulse(samples.data(), samples.size(), 10, 0.5f);
+  for (size_t index = 0; index < samples.size(); ++index) XCTAssertEqual(samples[index], index == 10 ? 0.5f : 0.0f);
+
+  TestSignals::impulse(samples.data(), samples.size(), 10, 0.5f, 64);
+  for (auto sample : samples) XCTAssertEqual(sample, 0.0f);
+}
+
+- (void)testDenormalTail {
+  std::vector<float> samples(200 * 16);
+  TestSignals::denormalTail(samples.data(), samples.size(), 1.0f, 16.0);
+  XCTAssertEqual(samples[0], 1.0f);
+  XCTAssertEqualWithAccuracy(samples[16], 0.5f, 1e-6);
+
+  size_t denormals = 0;
+  for (size_t index = 1; index < samples.size(); ++index) {
+    XCTAssertLessThanOrEqual(samples[index], samples[index - 1]);
+    if (samples[index] > 0.0f && samples[index] < 1.17549435e-38f) ++denormals;
+  }
+  XCTAssertGreaterThan(denormals, size_t(16 * 20));
+  XCTAssertEqual(samples.back(), 0.0f);
+}
+
+@end
@@ -0,0 +1,139 @@
+// Copyright © 2021 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <complex>
+#import <vector>
+
+#import "BiquadFilter.h"
+#import "TestSignals.hpp"
+#import "Vocoder.h"
+
+@interface VocoderTests : XCTestCase
+@end
+
+static constexpr double sampleRate = 48000.0;
+
+/// @returns the RMS value of samples in a range
+static double rms(std::vector<float> const& samples, size_t begin, size_t end) {
+  double sum = 0.0;
+  for (size_t index = begin; index < end; ++index) sum += double(samples[index]) * samples[index];
+  return std::sqrt(sum / (end - begin));
+}
+
+@implementation VocoderTests
+
+- (void)testBandPass {
+  float nyquistPeriod = 2.0 / sampleRate;
+  auto c = BiquadFilter::bandPass(1000.0, 4.0, nyquistPeriod);
+  auto gain = [&](double frequency) {
+    auto z1 = std::polar(1.0, -M_PI * frequency * nyquistPeriod);
+    auto z2 = z1 * z1;
+    return std::abs((double(c.b0) + double(c.b1) * z1 + double(c.b2) * z2) /
+                    (1.0 + double(c.a1) * z1 + double(c.a2) * z2));
+  };
+
+  XCTAssertEqualWithAccuracy(gain(1000.0), 1.0, 1e-4);
+  // Q is the center frequency over the width between the -3 dB points, which are a geometric pair around the center
+  double half = 1000.0 / 4.0 / 2.0;
+  double upper = half + std::sqrt(half * half + 1000.0 * 1000.0);
+  XCTAssertEqualWithAccuracy(gain(upper), M_SQRT1_2, 0.01);
+  XCTAssertEqualWithAccuracy(gain(1000.0 * 1000.0 / upper), M_SQRT1_2, 0.01);
+  XCTAssertLessThan(gain(50.0), 0.05);
+  XCTAssertLessThan(gain(15000.0), 0.05);
+}
+
+- (void)testBands {
+  Vocoder vocoder;
+  vocoder.configure(2, 20, 100.0, 8000.0, sampleRate);
+  XCTAssertEqual(vocoder.numBands(), size_t(20));
+  XCTAssertEqual(vocoder.numChannels(), size_t(2));
+  XCTAssertEqualWithAccuracy(vocoder.bandFrequency(0), 100.0, 1e-3);
+  XCTAssertEqualWithAccuracy(vocoder.bandFrequency(19), 8000.0, 1e-1);
+  XCTAssertEqualWithAccuracy(vocoder.bandFrequency(1) / vocoder.bandFrequency(0),
+                             vocoder.bandFrequency(19) / vocoder.bandFrequency(18), 1e-4);
+}
+
+- (void)testEnvelopeFollowsModulatorBand {
+  // 20 bands does not fill the last group of lanes, which must stay silent
+  Vocoder vocoder;
+  vocoder.configure(1, 20, 100.0, 8000.0, sampleRate);
+  size_t target = 11;
+  std::vector<float> modulator(9600);
+  std::vector<float> carrier(modulator.size());
+  std::vector<float> output(modulator.size());
+  TestSignals::sine(modulator.data(), modulator.size(), vocoder.bandFrequency(target), sampleRate);
+  TestSignals::whiteNoise(carrier.data(), carrier.size(), 5);
+  std::vector<float const*> modulators{modulator.data()};
+  std::vector<float const*> carriers{carrier.data()};
+  std::vector<float*> outs{output.data()};
+  vocoder.process(modulators, carriers, outs, modulator.size());
+
+  // With a fast attack and a slow release the level of a full-scale sine lies between its rectified average and its
+  // peak. Bands further away see less of it.
+  XCTAssertGreaterThan(vocoder.envelope(0, target), 2.0 / M_PI);
+  XCTAssertLessThan(vocoder.envelope(0, target), 1.0);
+  for (size_t band = 0; band < vocoder.numBands(); ++band) {
+    if (band != target) XCTAssertLessThan(vocoder.envelope(0, band), vocoder.envelope(0, target));
+    if (band + 2 < target || band > target + 2) XCTAssertLessThan(vocoder.envelope(0, band), 0.2);
+  }
+
+  // The output is the carrier noise in the band of the modulator
+  XCTAssertGreaterThan(rms(output, 4800, output.size()), 0.01);
+  XCTAssertLessThan(rms(output, 4800, output.size()), rms(carrier, 4800, carrier.size()));
+}
+
+- (void)testSilence {
+  Vocoder vocoder;
+  vocoder.configure(2, 32, 80.0, 12000.0, sampleRate);
+  std::vector<float> voice(4800);
+  std::vector<float> silence(voice.size(), 0.0f);
+  std::vector<float> synth(voice.size());
+  TestSignals::whiteNoise(voice.data(), voice.size(), 1);
+  TestSignals::whiteNoise(synth.data(), synth.size(), 2);
+
+  // Left has both inputs, right has no modulator, so only left makes sound
+  std::vector<float> left(voice.size());
+  std::vector<float> right(voice.size());
+  std::vector<float const*> modulators{voice.data(), silence.data()};
+  std::vector<float const*> carriers{synth.data(), synth.data()};
+  std::vector<float*> outs{left.data(), right.data()};
+  vocoder.process(modulators, carriers, outs, voice.size());
+  XCTAssertGreaterThan(rms(left, 2400, left.size()), 0.01);
+  for (auto sample : right) XCTAssertEqual(sample, 0.0f);
+
+  // Without a carrier there is nothing to shape
+  vocoder.resetState();
+  modulators = {voice.data(), voice.data()};
+  carriers = {silence.data(), silence.data()};
+  vocoder.process(modulators, carriers, outs, voice.size());
+  for (auto sample : left) XCTAssertEqual(sample, 0.0f);
+  XCTAssertGreaterThan(vocoder.envelope(1, 16), 0.0f);
+}
+
+- (void)testBlocksMatchWhole {
+  std::vector<float> voice(3000);
+  std::vector<float> synth(voice.size());
+  TestSignals::whiteNoise(voice.data(), voice.size(), 3);
+  TestSignals::multiTone(synth.data(), synth.size(), {{110.0, 0.5f}, {220.0, 0.25f}, {330.0, 0.125f}}, sampleRate);
+
+  Vocoder vocoder;
+  vocoder.configure(1, 16, 100.0, 10000.0, sampleRate);
+  std::vector<float> whole(voice.size());
+  std::vector<float const*> modulators{voice.data()};
+  std::vector<float const*> carriers{synth.data()};
+  std::vector<float*> outs{whole.data()};
+  vocoder.process(modulators, carriers, outs, voice.size());
+
+  vocoder.resetState();
+  std::vector<float> pieces(synth);
+  for (size_t offset = 0; offset < voice.size(); offset += 100) {
+    std::vector<float const*> blockModulators{voice.data() + offset};
+    std::vector<float const*> blockCarriers{pieces.data() + offset};
+    std::vector<float*> blockOuts{pieces.data() + offset};
+    vocoder.process(blockModulators, blockCarriers, blockOuts, std::min<size_t>(100, voice.size() - offset));
+  }
+  XCTAssertTrue(pieces == whole);
+}
+
+@end